@@ -125,10 +125,9 @@ void CScanView::onDrawSelf(CDCHandle dc)
     float min_picked_dangle = 100;
 
     for (int pos =0; pos < (int)_scan_data.size(); ++pos) {
-        float distPixel = _scan_data[pos].dist*distScale;
         float rad = (float)(_scan_data[pos].angle*PI/180.0);
-        float endptX = sin(rad)*(distPixel) + centerPt.x;
-        float endptY = centerPt.y - cos(rad)*(distPixel);
+        float endptX = centerPt.x - _scan_data[pos].y*distScale;
+        float endptY = centerPt.y - _scan_data[pos].x*distScale;
 
         float dangle = fabs(rad - _mouse_angle);
 
@@ -152,10 +151,8 @@ void CScanView::onDrawSelf(CDCHandle dc)
     memDC.TextOutA(DEF_MARGIN, DEF_MARGIN + 40, txtBuffer);
 
     if ((int)_scan_data.size() > picked_point) {
-        float distPixel = _scan_data[picked_point].dist*distScale;
-        float rad = (float)(_scan_data[picked_point].angle*PI/180.0);
-        float endptX = sin(rad)*(distPixel) + centerPt.x;
-        float endptY = centerPt.y - cos(rad)*(distPixel);
+        float endptX = centerPt.x - _scan_data[picked_point].y*distScale;
+        float endptY = centerPt.y - _scan_data[picked_point].x*distScale;
 
 
         memDC.SetDCPenColor(RGB(129,10,16));
@@ -254,6 +251,13 @@ void CScanView::setScanData(rplidar_response_measurement_node_hq_t *buffer, size
 {
     _scan_data.clear();
     _is_scanning = true;
+
+    // both skip the invalid nodes, so the points line up with the dots
+    size_t points = 0;
+    _scan_x.resize(count + 1);
+    _scan_y.resize(count + 1);
+    rp::standalone::rplidar::RPlidarDriver::ConvertScanToCartesian(buffer, count, &_scan_x[0], &_scan_y[0], NULL, points);
+
     for (int pos = 0; pos < (int)count; ++pos) {
         scanDot dot;
         if (!buffer[pos].dist_mm_q2) continue;
@@ -261,6 +265,8 @@ void CScanView::setScanData(rplidar_response_measurement_node_hq_t *buffer, size
         dot.quality = buffer[pos].quality;
         dot.angle = buffer[pos].angle_z_q14 * 90.f / 16384.f;
         dot.dist = buffer[pos].dist_mm_q2 /4.0f;
+        dot.x = _scan_x[_scan_data.size()];
+        dot.y = _scan_y[_scan_data.size()];
         _scan_data.push_back(dot);
     }
 
@@ -34,6 +34,8 @@ struct scanDot {
     _u8   quality;
     float angle;
     float dist;
+    float x;     // mm, towards angle 0
+    float y;     // mm, towards angle 270
 };
 
 class CScanView : public CWindowImpl<CScanView>
@@ -77,6 +79,8 @@ protected:
     POINT                _mouse_pt;
     float                _mouse_angle;
     std::vector<scanDot> _scan_data;
+    std::vector<float>   _scan_x;
+    std::vector<float>   _scan_y;
     float                _scan_speed;
     float                _sample_duration;
     float                _current_display_range;
@@ -60,14 +60,148 @@ struct RplidarScanMode {
     char    scan_mode[64];    // name of scan mode, max 63 characters
 };
 
+/// What the driver knows about the connected device, fetched once per connection, see getDeviceProfile.
+struct RplidarDeviceProfile {
+    rplidar_response_device_info_t info;
+    bool                           conf_supported; // firmware 1.24+, the scan modes were reported by the device
+    _u16                           typical_mode;   // id of the typical scan mode
+    std::vector<RplidarScanMode>   modes;          // all supported scan modes
+};
+
+/// When the motor counts as spun up, see waitSpinStable.
+struct RplidarSpinCriterion {
+    float   min_frequency;   // slowest rotation (Hz) accepted
+    float   tolerance;       // largest change of the frequency between two rotations, relative
+    _u32    stable_scans;    // rotations in a row that must meet both
+};
+
+/// Pose of the lidar in the frame cartesian points are wanted in, see grabScanDataCartesian.
+struct RplidarTransform2D {
+    float   x;               // position of the lidar (mm)
+    float   y;
+    float   yaw;             // rotation of the lidar frame (degrees, counter-clockwise)
+};
+
+struct RplidarScanInfo {
+    _u64    seq;             // sequence number of the scan, a gap to the previously grabbed scan means scans were dropped
+    _u64    dropped;         // total number of complete scans dropped so far without being grabbed, see SCAN_OVERFLOW_*
+    _u64    truncated;       // total number of scans so far that outgrew the scan buffers and lost their last samples, see CreateDriver()
+    _u64    first_packet_us; // host monotonic time (us) the packet carrying the first sample of the scan arrived
+    _u64    last_packet_us;  // host monotonic time (us) the packet carrying the last sample of the scan arrived
+    _u64    first_device_ts; // device timestamp of the first HQ capsule of the scan, 0 in other scan modes
+    _u64    last_device_ts;  // device timestamp of the last HQ capsule of the scan, 0 in other scan modes
+};
+
+/// A scan laid out as one array per field, in engineering units, see DRIVER_OPTION_SCAN_ARRAYS.
+/// The arrays hold count entries each and start on a 32 byte boundary.
+struct RplidarScanArrays {
+    const float * angle_rad;      // angle of each sample, radians in [0, 2 pi), growing clockwise
+    const float * range_mm;       // distance of each sample in mm, 0 for invalid samples
+    const _u8 *   quality;
+    const _u8 *   flag;           // RPLIDAR_RESP_MEASUREMENT_SYNCBIT on the first sample of the scan
+    const _u64 *  timestamp_us;   // host monotonic timestamp of each sample, NULL for DRIVER_OPTION_COMPACT_MEMORY drivers
+    size_t        count;
+};
+
+/// A complete 0-360 degree scan shared by the scan subscribers (see subscribeScans).
+/// Scans are immutable once delivered and reference counted: call addRef() to keep a scan
+/// beyond the call it was delivered by, and release() once done with it. Released scans are
+/// recycled by the driver, all of them must be released before the driver is disposed.
+class RplidarScan {
+public:
+    const rplidar_response_measurement_node_hq_t * nodes() const { return _nodes; }
+    const _u64 * timestamps() const { return _timestamps; }     // host monotonic timestamp of each sample, in us, NULL for DRIVER_OPTION_COMPACT_MEMORY drivers
+    size_t count() const { return _count; }
+    const RplidarScanInfo & info() const { return _info; }      // info().dropped is not maintained, look for gaps in info().seq
+    const RplidarScanArrays & arrays() const { return _arrays; } // all NULL unless the driver was created with DRIVER_OPTION_SCAN_ARRAYS
+
+    virtual void addRef() const = 0;
+    virtual void release() const = 0;
+
+protected:
+    RplidarScan() : _nodes(NULL), _timestamps(NULL), _count(0), _arrays() {}
+    virtual ~RplidarScan() {}
+
+    rplidar_response_measurement_node_hq_t * _nodes;
+    _u64 *                                   _timestamps;
+    size_t                                   _count;
+    RplidarScanInfo                          _info;
+    RplidarScanArrays                        _arrays;
+};
+
+/// Called on the subscription's own thread for every scan delivered to it. The scan is only
+/// guaranteed to be alive during the call.
+typedef void (*RplidarScanCallback)(const RplidarScan & scan, void * user_data);
+
+/// Called on a driver thread when a getHealthAsync request completes. scan_gap_us is how long the
+/// scan was interrupted for the query, 0 if no scan was running.
+typedef void (*RplidarHealthCallback)(u_result result, const rplidar_response_device_health_t & health, _u64 scan_gap_us, void * user_data);
+
+struct RplidarScanView {
+    const rplidar_response_measurement_node_hq_t * nodes;        // samples of the scan, owned by the driver
+    const _u64 *                                   timestamp_us; // host monotonic timestamp of each sample, NULL for DRIVER_OPTION_COMPACT_MEMORY drivers
+    size_t                                         count;
+    RplidarScanInfo                                info;
+    RplidarScanArrays                              arrays;       // the same samples as arrays, all NULL unless DRIVER_OPTION_SCAN_ARRAYS
+};
+
 enum {
     DRIVER_TYPE_SERIALPORT = 0x0,
     DRIVER_TYPE_TCP = 0x1,
+    DRIVER_TYPE_REPLAY = 0x2, // plays a file written by startRecording(), connect(path, REPLAY_*)
+};
+
+enum {
+    REPLAY_REAL_TIME = 0x0, // deliver the received bytes at the pace they were recorded
+    REPLAY_FAST      = 0x1, // deliver the received bytes as fast as the driver reads them, scans not grabbed in time are dropped
+};
+
+enum {
+    // Size the scan buffers for a rotation of at least 5 Hz, keep no per-sample timestamps
+    // (grabScanDataHq interpolates them from the packet arrival times), queue two scans
+    // by default and free the idle scan buffers when scanning stops.
+    // Meant for gateways running many drivers on little memory.
+    DRIVER_OPTION_COMPACT_MEMORY = 0x1,
+    // Also lay every complete scan out as RplidarScanArrays, filled by the driver thread
+    // as the scan completes, for consumers that process the samples with SIMD.
+    DRIVER_OPTION_SCAN_ARRAYS = 0x2,
+};
+
+enum {
+    GRID_REDUCE_MIN     = 0x0, // the closest sample of the bin
+    GRID_REDUCE_NEAREST = 0x1, // the sample nearest to the bin center in angle
+    GRID_REDUCE_MEAN    = 0x2, // the mean range and quality of the samples of the bin
+};
+
+enum {
+    // connect() leaves the motor as it finds it instead of stopping it, so reattaching
+    // to a lidar that is already spinning does not wait for it to spin up again.
+    CONNECT_FLAG_KEEP_MOTOR = 0x1,
+};
+
+enum {
+    SCAN_OVERFLOW_KEEP_LATEST = 0x0, // grabbing returns the newest complete scan, the ones not grabbed in time are dropped (default)
+    SCAN_OVERFLOW_DROP_NEWEST = 0x1, // complete scans are queued in order, a full queue drops the newest scan
+};
+
+enum {
+    INTERVAL_OVERFLOW_DROP_NEWEST = 0x0, // a full interval buffer keeps its oldest nodes (default)
+    INTERVAL_OVERFLOW_DROP_OLDEST = 0x1, // a full interval buffer makes room for the newest nodes
 };
 
+class StreamRecorder;
+
 class ChannelDevice
 {
 public:
+    enum {
+        READ_AHEAD_SIZE = 8192,
+        RX_MARKS        = 16,   // reads whose receive time is tracked while their bytes are buffered
+    };
+
+    ChannelDevice() : _readAheadBegin(0), _readAheadEnd(0), _rxMarkCount(0), _consumedRxUs(0), _recorder(NULL) {}
+    virtual ~ChannelDevice() {}
+
     virtual bool bind(const char*, uint32_t ) = 0;
     virtual bool open() {return true;}
     virtual void close() = 0;
@@ -78,6 +212,44 @@ public:
     virtual void setDTR() {return;}
     virtual void clearDTR() {return;}
     virtual void ReleaseRxTx() {return;}
+    virtual void setLowWaterMark(size_t /*bytes*/) {return;}
+
+    /// Wait until at least size bytes are buffered in the read-ahead buffer, and point data at them.
+    /// The buffer is refilled with one recvdata() call taking everything the device has available,
+    /// so packet parsers can frame the bytes in place. data stays valid until the next peek().
+    ///
+    /// \param available      Receives the number of buffered bytes, at least size on success.
+    virtual bool peek(size_t size, const _u8 *& data, size_t & available, _u32 timeout);
+
+    /// Drop size bytes from the front of the read-ahead buffer.
+    virtual void consume(size_t size);
+
+    /// Drop everything buffered, e.g. after flush().
+    virtual void discardBuffered();
+
+    /// Host time (getus()) the last byte consumed so far was received at: the time
+    /// of the recvdata() call that delivered it, not the time it was parsed.
+    _u64 consumedRxUs() const { return _consumedRxUs; }
+
+    /// Log the bytes received into the read-ahead buffer to recorder, see RPlidarDriver::startRecording.
+    void setRecorder(StreamRecorder * recorder) { _recorder = recorder; }
+
+protected:
+    bool _fillReadAhead(size_t minBytes, _u32 timeout);
+
+    // the buffered bytes before end were received at rxUs
+    struct RxMark {
+        size_t end;
+        _u64   rxUs;
+    };
+
+    _u8              _readAheadBuf[READ_AHEAD_SIZE];
+    size_t           _readAheadBegin;
+    size_t           _readAheadEnd;
+    RxMark           _rxMarks[RX_MARKS];    // oldest read first
+    size_t           _rxMarkCount;
+    _u64             _consumedRxUs;
+    StreamRecorder * _recorder;
 };
 
 class RPlidarDriver {
@@ -99,7 +271,16 @@ public:
     /// This interface should be invoked first before any other operations
     ///
     /// \param drivertype the connection type used by the driver. 
-    static RPlidarDriver * CreateDriver(_u32 drivertype = DRIVER_TYPE_SERIALPORT);
+    ///
+    /// \param maxScanNodes the most samples a complete scan can hold. The scan buffers are sized
+    ///                     when a scan starts, for one rotation of the selected scan mode at the
+    ///                     slowest supported rotation rate, and never beyond this limit. Longer
+    ///                     scans (a motor still spinning up) keep their first samples and are
+    ///                     counted in RplidarScanInfo::truncated. The interval buffer of
+    ///                     getScanDataWithIntervalHq() always holds maxScanNodes samples.
+    ///
+    /// \param options      DRIVER_OPTION_* flags, 0 for none
+    static RPlidarDriver * CreateDriver(_u32 drivertype = DRIVER_TYPE_SERIALPORT, size_t maxScanNodes = MAX_SCAN_NODES, _u32 options = 0);
 
     /// Dispose the RPLIDAR Driver Instance specified by the drv parameter
     /// Applications should invoke this interface when the driver instance is no longer used in order to free memory
@@ -115,8 +296,7 @@ public:
     /// \param baudrate      the baudrate used
     ///        For most RPLIDAR models, the baudrate should be set to 115200
     ///
-    /// \param flag          other flags
-    ///        Reserved for future use, always set to Zero
+    /// \param flag          CONNECT_FLAG_* flags, 0 for none
     virtual u_result connect(const char *, _u32, _u32 flag = 0) = 0;
 
 
@@ -140,6 +320,16 @@ public:
     /// Get typical scan mode of lidar
     virtual u_result getTypicalScanMode(_u16& outMode, _u32 timeoutInMs = DEFAULT_TIMEOUT) = 0;
 
+    /// Get the device info and the scan modes of the connected device.
+    /// They are fetched on first use after connect(), with the configuration queries pipelined, and
+    /// cached until the next connection. getAllSupportedScanModes, getTypicalScanMode and the scan
+    /// start functions are served from the same cache.
+    virtual u_result getDeviceProfile(RplidarDeviceProfile & profile, _u32 timeoutInMs = DEFAULT_TIMEOUT) = 0;
+
+    /// Also keep the device profiles in a directory, keyed by serial number and firmware version, so a
+    /// restarted process only asks the device for its info. NULL disables the disk cache (default).
+    virtual u_result setDeviceProfileCacheDir(const char * path) = 0;
+
     /// Start scan
     ///
     /// \param force            Force the core system to output scan data regardless whether the scanning motor is rotating or not.
@@ -162,9 +352,26 @@ public:
     /// \param health        The health status info returned from the RPLIDAR
     ///
     /// \param timeout       The operation timeout value (in millisecond) for the serial port communication     
+    ///
+    /// The device answers no request while it streams a scan. A running scan is stopped for the query
+    /// and restarted in the same mode right after it, see getLastScanGap.
     virtual u_result getHealth(rplidar_response_device_health_t & health, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Retrieve the health status of the RPLIDAR without blocking the caller.
+    /// The query runs on a driver thread and completes through the callback, one request at a time:
+    /// RESULT_ALREADY_DONE is returned while the previous one is pending. Do not call it from the callback.
+    ///
+    /// \param callback      Called with the result, the health status and the scan gap
+    /// \param user_data     Passed to the callback
+    /// \param timeout       The operation timeout value (in millisecond) for the serial port communication
+    virtual u_result getHealthAsync(RplidarHealthCallback callback, void * user_data = NULL, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Get how long the last query that had to interrupt the scan (getHealth, getSampleDuration_uS)
+    /// kept it stopped, from the stop to the restart, in microseconds. 0 if it did not interrupt a scan.
+    virtual u_result getLastScanGap(_u64 & gapUs) = 0;
+
     /// Get the device information of the RPLIDAR include the serial number, firmware version, device model etc.
+    /// While scanning it is answered from the device profile, the scan is not interrupted.
     /// 
     /// \param info          The device information returned from the RPLIDAR
     /// \param timeout       The operation timeout value (in millisecond) for the serial port communication  
@@ -188,8 +395,29 @@ public:
     virtual u_result setLidarSpinSpeed(_u16 rpm, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
     /// Start RPLIDAR's motor when using accessory board
+    /// Blocks for a fixed spin-up delay, see startMotorAsync.
     virtual u_result startMotor() = 0;
 
+    /// Start RPLIDAR's motor and return at once.
+    /// Start scanning and use waitSpinStable to learn when the rotation has settled.
+    virtual u_result startMotorAsync() = 0;
+
+    /// Set when the motor counts as spun up. The default is 3 rotations in a row of at least 2 Hz
+    /// that differ by at most 5%.
+    virtual u_result setSpinCriterion(const RplidarSpinCriterion & criterion) = 0;
+
+    /// Get the rotation frequency measured on the last scan and whether it meets the spin criterion.
+    /// The frequency is 0 until a rotation has been measured since the motor or the scan was started,
+    /// and while the rotation is too slow to fit a scan.
+    virtual u_result getSpinState(bool & stable, float & frequency) = 0;
+
+    /// Wait until the measured rotation meets the spin criterion.
+    /// Fails with RESULT_OPERATION_FAIL when not scanning, the rotation is only measured on the scans.
+    ///
+    /// \param frequency     The rotation frequency (Hz) the motor settled at.
+    /// \param timeout       The timeout value (in millisecond).
+    virtual u_result waitSpinStable(float & frequency, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
     /// Stop RPLIDAR's motor when using accessory board
     virtual u_result stopMotor() = 0;
 
@@ -287,6 +515,139 @@ public:
     /// \The caller application can set the timeout value to Zero(0) to make this interface always returns immediately to achieve non-block operation.
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT) = 0;
 
+    /// Wait and grab a complete 0-360 degree scan together with its sequence information.
+    /// By default this is the newest complete scan, the scans completed since the previous grab are dropped.
+    /// With SCAN_OVERFLOW_DROP_NEWEST (see setScanOverflowPolicy) it is the oldest queued scan instead, and
+    /// a full queue drops the newest scan. Either way a dropped scan skips its sequence number, so the caller
+    /// can detect the loss. Concurrent callers of the grabScanData* interfaces are served one at a time.
+    ///
+    /// \param nodebuffer     Buffer provided by the caller application to store the scan data
+    ///
+    /// \param count          The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_hq_t).
+    ///                       Once the interface returns, this parameter will store the actual received data count.
+    ///
+    /// \param info           Receives the sequence number of the grabbed scan and the total dropped scan count.
+    ///
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Same as above, and also retrieve the host monotonic timestamp of every sample.
+    /// The last sample of each packet is stamped with the packet arrival time, the earlier ones are
+    /// interpolated backwards with the sample duration. Arrival times include the transfer latency.
+    /// In HQ mode the device timestamp of the capsules, converted to host time by an online offset
+    /// and drift model, replaces the arrival time. Compact drivers (DRIVER_OPTION_COMPACT_MEMORY) spread
+    /// the arrival times of the first and the last packet of the scan evenly over its samples instead.
+    ///
+    /// \param timestamp_us   Buffer receiving one timestamp (us) per sample, at least count entries
+    virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamp_us, size_t & count, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Wait and grab a complete 0-360 degree scan resampled onto a fixed grid of equal angular bins,
+    /// bin i covering [i, i + 1) * 360 / bins degrees, e.g. 1440 bins of 0.25 degree. The output size
+    /// does not depend on the scan mode and the scan needs no ascendScanData.
+    ///
+    /// \param ranges         Buffer of bins entries receiving the range of each bin in millimetres, 0 for
+    ///                       the bins no valid sample fell into
+    /// \param qualities      Buffer of bins entries receiving the quality of each bin, 0 for empty bins. May be NULL
+    /// \param bins           The number of bins
+    /// \param reduction      GRID_REDUCE_* how the samples falling into one bin are combined
+    /// \param info           Receives the sequence number of the grabbed scan and the total dropped scan count.
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    virtual u_result grabScanDataGrid(float * ranges, _u8 * qualities, size_t bins, _u32 reduction, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Wait and grab a complete 0-360 degree scan as cartesian points, see ConvertScanToCartesian.
+    ///
+    /// \param x, y           Buffers receiving the coordinates of the points (mm)
+    /// \param quality        Buffer receiving the quality of the points. May be NULL
+    /// \param count          The caller must initialize this parameter to set the max point count of the provided buffers.
+    ///                       Once the interface returns, this parameter will store the actual point count.
+    /// \param info           Receives the sequence number of the grabbed scan and the total dropped scan count.
+    /// \param transform      Pose of the lidar the points are moved by. May be NULL
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    virtual u_result grabScanDataCartesian(float * x, float * y, float * quality, size_t & count, RplidarScanInfo & info, const RplidarTransform2D * transform = NULL, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Wait for a complete scan, the one grabScanDataHq() would return, and lend it to the caller without copying it.
+    /// The view stays valid, and the scan is held for the caller, until releaseScanDataHq() is called;
+    /// meanwhile the grabScanData* interfaces fail with RESULT_OPERATION_FAIL. Lending again before
+    /// releasing returns the same scan.
+    ///
+    /// \param view           Receives the samples, their timestamps and the sequence information of the scan.
+    ///
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    virtual u_result lendScanDataHq(RplidarScanView & view, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Give back the scan lent by lendScanDataHq(). The view must not be used afterwards.
+    virtual u_result releaseScanDataHq() = 0;
+
+    /// Register an additional consumer of the complete scans. Every subscriber gets every scan,
+    /// independently of the other subscribers and of the grabScanData* caller.
+    /// Scans are queued per subscriber; when a subscriber falls more than backlog scans behind,
+    /// its oldest queued scan is dropped, which shows as a gap in RplidarScanInfo::seq.
+    ///
+    /// \param subscription   Receives the id of the new subscription.
+    ///
+    /// \param backlog        Max number of scans queued for this subscriber, at least 1.
+    ///
+    /// \param callback       When given, it is called on a thread owned by the subscription for every scan.
+    ///                       Otherwise the subscriber pulls the scans with waitSubscribedScan().
+    ///
+    /// \param user_data      Passed to the callback.
+    virtual u_result subscribeScans(_u32 & subscription, size_t backlog, RplidarScanCallback callback = NULL, void * user_data = NULL) = 0;
+
+    /// Wait for the oldest scan queued for a subscription registered without callback.
+    /// On success the caller owns a reference on the scan and must release() it.
+    /// Must not be called concurrently with unsubscribeScans() of the same subscription.
+    ///
+    /// \param timeout        Max duration allowed to wait for a complete scan data.
+    virtual u_result waitSubscribedScan(_u32 subscription, const RplidarScan *& scan, _u32 timeout = DEFAULT_TIMEOUT) = 0;
+
+    /// Remove a subscription and drop the scans still queued for it.
+    /// Must not be called from the subscription's own callback.
+    virtual u_result unsubscribeScans(_u32 subscription) = 0;
+
+    /// Set how many complete scans the driver queues for grabScanData/grabScanDataHq with
+    /// SCAN_OVERFLOW_DROP_NEWEST. Can only be changed while the driver is not scanning.
+    ///
+    /// \param depth          Number of queued scans, 1 to 64 (default 4)
+    virtual u_result setScanQueueDepth(size_t depth) = 0;
+
+    /// Choose whether grabScanData/grabScanDataHq return the newest complete scan or queue the
+    /// scans in order, see SCAN_OVERFLOW_*. Can only be changed while the driver is not scanning,
+    /// the scans not grabbed yet are dropped.
+    ///
+    /// \param policy         SCAN_OVERFLOW_KEEP_LATEST (default) or SCAN_OVERFLOW_DROP_NEWEST
+    virtual u_result setScanOverflowPolicy(_u32 policy) = 0;
+
+    /// Set how many bytes the serial port must have buffered before the scan data thread is woken up
+    /// while scanning, e.g. a multiple of the packet size of the scan mode to process packets in batches.
+    /// 0 (default) wakes it up for every complete packet. Takes effect on the next scan start.
+    /// Only the Linux serial port implements it.
+    ///
+    /// \param bytes          The low-water mark in bytes
+    virtual u_result setRxLowWaterMark(size_t bytes) = 0;
+
+    /// Split the scan data processing into an I/O thread and a decode thread.
+    /// The I/O thread only drains the device and queues validated raw packets, the decode thread turns
+    /// them into nodes and scans, so a slow decode cannot let the receive buffer of the device overflow.
+    /// Off by default. Takes effect on the next scan start.
+    ///
+    /// \param enable         true to run the two-stage pipeline, false for the single scan data thread
+    ///
+    /// \param ioCpu          CPU core to pin the I/O thread to, -1 to leave it unpinned
+    ///
+    /// \param decodeCpu      CPU core to pin the decode (or single scan data) thread to, -1 to leave it unpinned
+    virtual u_result setDecodePipeline(bool enable, int ioCpu = -1, int decodeCpu = -1) = 0;
+
+    /// Log every byte received from the device, in chunks stamped with the host monotonic time, and
+    /// every command sent to it, to a file a DRIVER_TYPE_REPLAY driver can play back. Start recording
+    /// before connect() so the replay sees the whole command exchange. A running recording is replaced.
+    /// DRIVER_TYPE_REPLAY drivers return RESULT_OPERATION_NOT_SUPPORT.
+    ///
+    /// \param path           The file to write, truncated
+    virtual u_result startRecording(const char * path) = 0;
+
+    /// Close the file of startRecording().
+    virtual u_result stopRecording() = 0;
+
     /// Ascending the scan data according to the angle value in the scan.
     ///
     /// \param nodebuffer     Buffer provided by the caller application to do the reorder. Should be retrived from the grabScanData
@@ -303,8 +664,43 @@ public:
     /// \param count          The caller must initialize this parameter to set the max data count of the provided buffer (in unit of rplidar_response_measurement_node_t).
     ///                       Once the interface returns, this parameter will store the actual received data count.
     /// The interface will return RESULT_OPERATION_FAIL when all the scan data is invalid. 
+    /// Runs in linear time on a single rotation, as returned by grabScanDataHq.
     virtual u_result ascendScanData(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count) = 0;
 
+    /// Ascending the scan data into a separate buffer, leaving the source untouched.
+    ///
+    /// \param nodebuffer     The scan data, e.g. as lent by lendScanDataHq
+    /// \param outbuffer      Receives the count reordered nodes, may be nodebuffer
+    /// \param count          The number of nodes
+    /// The interface will return RESULT_OPERATION_FAIL when all the scan data is invalid. 
+    virtual u_result ascendScanData(const rplidar_response_measurement_node_hq_t * nodebuffer, rplidar_response_measurement_node_hq_t * outbuffer, size_t count) = 0;
+
+    /// Convert scan data to cartesian points, in mm, in the lidar frame: x towards angle 0 and
+    /// y towards angle 270 (the angles grow clockwise seen from above). Invalid nodes are skipped.
+    ///
+    /// \param nodebuffer     The scan data
+    /// \param count          The number of nodes
+    /// \param x, y           Buffers of at least count entries receiving the coordinates of the points
+    /// \param quality        Buffer of at least count entries receiving the quality of the points. May be NULL
+    /// \param pointCount     Receives the number of points
+    /// \param transform      Pose of the lidar in the frame the points are wanted in. May be NULL
+    static u_result ConvertScanToCartesian(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * x, float * y, float * quality, size_t & pointCount, const RplidarTransform2D * transform = NULL);
+
+    /// Convert scan data to the RplidarScanArrays layout: angle in radians and range in mm as float,
+    /// quality and flag as bytes. The conversion is lossless for distances below 2^24 q2 units, see ConvertArraysToScan.
+    ///
+    /// \param nodebuffer     The scan data
+    /// \param count          The number of nodes
+    /// \param angle_rad, range_mm, quality, flag
+    ///                       Buffers of at least count entries receiving the fields. quality and flag may be NULL
+    static u_result ConvertScanToArrays(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_rad, float * range_mm, _u8 * quality, _u8 * flag);
+
+    /// Convert scan arrays back to scan data, the angles and ranges rounded to the nearest q14 and q2 units.
+    ///
+    /// \param arrays         The scan arrays, e.g. RplidarScan::arrays(). quality and flag may be NULL, giving 0
+    /// \param nodebuffer     Buffer of at least arrays.count nodes receiving the scan data
+    static u_result ConvertArraysToScan(const RplidarScanArrays & arrays, rplidar_response_measurement_node_hq_t * nodebuffer);
+
     /// Return received scan points even if it's not complete scan
     ///
     /// \param nodebuffer     Buffer provided by the caller application to store the scan data
@@ -326,6 +722,19 @@ public:
     /// The interface will return RESULT_REMAINING_DATA to indicate that the given buffer is full, but that there remains data to be read.
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count) = 0;
 
+    /// Same as above, and also retrieve the total number of nodes the interval buffer has dropped so far.
+    /// The buffer holds maxScanNodes samples, see CreateDriver(); what it drops when the
+    /// caller does not keep up is chosen by setIntervalOverflowPolicy().
+    ///
+    /// \param dropped        Receives the number of nodes dropped since the driver was created.
+    virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u64 & dropped) = 0;
+
+    /// Choose which nodes the interval buffer drops when it is full, see INTERVAL_OVERFLOW_*.
+    /// Must be called while not scanning.
+    ///
+    /// \param policy         INTERVAL_OVERFLOW_DROP_NEWEST (default) or INTERVAL_OVERFLOW_DROP_OLDEST
+    virtual u_result setIntervalOverflowPolicy(_u32 policy) = 0;
+
     virtual ~RPlidarDriver() {}
 protected:
     RPlidarDriver(){}
@@ -46,7 +46,8 @@
 #include <time.h>
 #include "hal/types.h"
 #include "arch/linux/net_serial.h"
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <algorithm>
 //__GNUC__
@@ -198,29 +199,37 @@ bool raw_serial::open(const char * portname, uint32_t baudrate, uint32_t flags)
     _is_serial_opened = true;
     _operation_aborted = false;
 
+    if (_low_water_mark) _setRxWakeThreshold(_low_water_mark);
+
     //Clear the DTR bit to let the motor spin
     clearDTR();
-    do {
-        // create self pipeline for wait cancellation
-        if (pipe(_selfpipe) == -1) break;
-
-        int flags = fcntl(_selfpipe[0], F_GETFL);
-        if (flags == -1)
-            break;
 
-        flags |= O_NONBLOCK;                /* Make read end nonblocking */
-        if (fcntl(_selfpipe[0], F_SETFL, flags) == -1)
-            break;
-
-        flags = fcntl(_selfpipe[1], F_GETFL);
-        if (flags == -1)
-            break;
-
-        flags |= O_NONBLOCK;                /* Make write end nonblocking */
-        if (fcntl(_selfpipe[1], F_SETFL, flags) == -1)
-            break;
+    // epoll set watching the port and the eventfd used for wait cancellation
+    _cancel_fd = eventfd(0, EFD_NONBLOCK);
+    _epoll_fd = epoll_create1(0);
+    if (_cancel_fd == -1 || _epoll_fd == -1)
+    {
+        close();
+        return false;
+    }
 
-    } while (0);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    // edge triggered: one wakeup per arrival, a partially filled buffer does not spin the waiter
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = serial_fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, serial_fd, &ev) == -1)
+    {
+        close();
+        return false;
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = _cancel_fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _cancel_fd, &ev) == -1)
+    {
+        close();
+        return false;
+    }
     
     return true;
 }
@@ -231,13 +240,14 @@ void raw_serial::close()
         ::close(serial_fd);
     serial_fd = -1;
     
-    if (_selfpipe[0] != -1)
-        ::close(_selfpipe[0]);
+    if (_epoll_fd != -1)
+        ::close(_epoll_fd);
 
-    if (_selfpipe[1] != -1)
-        ::close(_selfpipe[1]);
+    if (_cancel_fd != -1)
+        ::close(_cancel_fd);
 
-    _selfpipe[0] = _selfpipe[1] = -1;
+    _epoll_fd = _cancel_fd = -1;
+    _rx_wake_threshold = 0;
 
     _operation_aborted = false;
     _is_serial_opened = false;
@@ -303,93 +313,95 @@ int raw_serial::waitfordata(size_t data_count, _u32 timeout, size_t * returned_s
     if (returned_size==NULL) returned_size=(size_t *)&length;
     *returned_size = 0;
 
-    int max_fd;
-    fd_set input_set;
-    struct timeval timeout_val;
-
-    /* Initialize the input set */
-    FD_ZERO(&input_set);
-    FD_SET(serial_fd, &input_set);
+    if ( !isOpened() ) return ANS_DEV_ERR;
 
-    if (_selfpipe[0] != -1)
-        FD_SET(_selfpipe[0], &input_set);
+    // with a low-water mark set, only wake up once that much is buffered
+    size_t target = std::max(data_count, _low_water_mark);
 
-    max_fd =  std::max<int>(serial_fd, _selfpipe[0]) + 1;
+    _u32 startTs = getms();
+    _u32 waitTime;
 
-    /* Initialize the timeout structure */
-    timeout_val.tv_sec = timeout / 1000;
-    timeout_val.tv_usec = (timeout % 1000) * 1000;
-
-    if ( isOpened() )
+    while ( isOpened() )
     {
-        if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
-        if (*returned_size >= data_count)
+        int queued;
+        if ( ioctl(serial_fd, FIONREAD, &queued) == -1) return ANS_DEV_ERR;
+        *returned_size = queued;
+        if (*returned_size >= target)
         {
             return 0;
         }
-    }
 
-    while ( isOpened() )
-    {
-        /* Do the select */
-        int n = ::select(max_fd, &input_set, NULL, NULL, &timeout_val);
+        if ((waitTime = getms() - startTs) >= timeout)
+        {
+            // what is buffered may still be enough for the caller
+            if (*returned_size >= data_count) return 0;
+            *returned_size = 0;
+            return ANS_TIMEOUT;
+        }
+
+        struct epoll_event events[2];
+        _u32 remain = timeout - waitTime;
+        int n = epoll_wait(_epoll_fd, events, 2, (timeout == 0xFFFFFFFF) ? -1 : (int)std::min<_u32>(remain, 0x7FFFFFFF));
 
         if (n < 0)
         {
-            // select error
-            *returned_size =  0;
+            if (errno == EINTR) continue;
+            *returned_size = 0;
             return ANS_DEV_ERR;
         }
-        else if (n == 0)
-        {
-            // time out
-            *returned_size =0;
-            return ANS_TIMEOUT;
-        }
-        else
+
+        for (int pos = 0; pos < n; ++pos)
         {
-            if (FD_ISSET(_selfpipe[0], &input_set)) {   
+            if (events[pos].data.fd == _cancel_fd) {
                 // require aborting the current operation
-                int ch;
-                for (;;) {                    
-                    if (::read(_selfpipe[0], &ch, 1) == -1) {
-                        break;
-                    }
-                    
-                }
+                uint64_t counter;
+                ::read(_cancel_fd, &counter, sizeof(counter));
 
                 // treat as  timeout
                 *returned_size = 0;
                 return ANS_TIMEOUT;
             }
-
-            // data avaliable
-            assert (FD_ISSET(serial_fd, &input_set));
-
-
-            if ( ioctl(serial_fd, FIONREAD, returned_size) == -1) return ANS_DEV_ERR;
-            if (*returned_size >= data_count)
-            {
-                return 0;
-            }
-            else 
-            {
-                int remain_timeout = timeout_val.tv_sec*1000000 + timeout_val.tv_usec;
-                int expect_remain_time = (data_count - *returned_size)*1000000*8/_baudrate;
-                if (remain_timeout > expect_remain_time)
-                    usleep(expect_remain_time);
-            }
         }
-        
     }
 
     return ANS_DEV_ERR;
 }
 
+void raw_serial::setLowWaterMark(size_t bytes)
+{
+    _low_water_mark = bytes;
+    // VMIN follows the mark, not each wait: it is raised once when a scan
+    // stream starts and restored to the open-time 0 when it stops
+    if (isOpened()) _setRxWakeThreshold(bytes);
+}
+
+void raw_serial::_setRxWakeThreshold(size_t bytes)
+{
+    // the tty only reports the port readable once VMIN bytes are queued
+    // (VTIME is 0), which keeps partial packets from waking the waiter.
+    // Above 64 bytes n_tty splits non-blocking reads into 64 byte chunks,
+    // larger thresholds are left to the waiter checking FIONREAD.
+    if (bytes > 64) bytes = 64;
+    if (bytes == _rx_wake_threshold) return;
+
+#if !defined(__GNUC__)
+    struct termios options;
+    if (tcgetattr(serial_fd, &options)) return;
+    options.c_cc[VMIN] = (cc_t)bytes;
+    if (tcsetattr(serial_fd, TCSANOW, &options)) return;
+#else
+    struct termios2 tio;
+    if (ioctl(serial_fd, TCGETS2, &tio) == -1) return;
+    tio.c_cc[VMIN] = (cc_t)bytes;
+    if (ioctl(serial_fd, TCSETS2, &tio) == -1) return;
+#endif
+    _rx_wake_threshold = bytes;
+}
+
 size_t raw_serial::rxqueue_count()
 {
     if  ( !isOpened() ) return 0;
-    size_t remaining;
+    int remaining;
     
     if (::ioctl(serial_fd, FIONREAD, &remaining) == -1) return 0;
     return remaining;
@@ -417,15 +429,18 @@ void raw_serial::_init()
     _portName[0] = 0;
     required_tx_cnt = required_rx_cnt = 0;
     _operation_aborted = false;
-    _selfpipe[0] = _selfpipe[1] = -1;
+    _epoll_fd = _cancel_fd = -1;
+    _low_water_mark = 0;
+    _rx_wake_threshold = 0;
 }
 
 void raw_serial::cancelOperation()
 {
     _operation_aborted = true;
-    if (_selfpipe[1] == -1) return;
+    if (_cancel_fd == -1) return;
 
-    ::write(_selfpipe[1], "x", 1);
+    uint64_t counter = 1;
+    ::write(_cancel_fd, &counter, sizeof(counter));
 }
 
 _u32 raw_serial::getTermBaudBitmap(_u32 baud)
@@ -69,10 +69,12 @@ public:
     _u32 getTermBaudBitmap(_u32 baud);
 
     virtual void cancelOperation();
+    virtual void setLowWaterMark(size_t bytes);
 
 protected:
     bool open(const char * portname, uint32_t baudrate, uint32_t flags = 0);
     void _init();
+    void _setRxWakeThreshold(size_t bytes);
 
     char _portName[200];
     uint32_t _baudrate;
@@ -83,7 +85,10 @@ protected:
     size_t required_tx_cnt;
     size_t required_rx_cnt;
 
-    int    _selfpipe[2];
+    int    _epoll_fd;
+    int    _cancel_fd;          // eventfd signalled by cancelOperation()
+    size_t _low_water_mark;
+    size_t _rx_wake_threshold;  // VMIN currently set on the port
     bool   _operation_aborted;
 };
 
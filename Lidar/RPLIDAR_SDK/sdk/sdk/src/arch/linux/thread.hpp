@@ -126,6 +126,21 @@ Thread::priority_val_t Thread::getPriority()
     return PRIORITY_NORMAL;
 }
 
+u_result Thread::setAffinity(int cpu)
+{
+    if (!this->_handle) return RESULT_OPERATION_FAIL;
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return RESULT_INVALID_DATA;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np((pthread_t)this->_handle, sizeof(cpuset), &cpuset))
+    {
+        return RESULT_OPERATION_FAIL;
+    }
+    return RESULT_OK;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
@@ -11,6 +11,7 @@
 #include "../../hal/socket.h"
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -477,7 +478,6 @@ public:
         }
     }
 
-#if 0
     virtual u_result recvNoWait(void *buf, size_t len, size_t & recv_len)
     {
         size_t ans = ::recv( _socket_fd, buf, len, MSG_DONTWAIT);
@@ -490,13 +490,34 @@ public:
             }
 
 
+        } else if (ans == 0 && len) {
+            // orderly shutdown by the peer
+            recv_len = 0;
+            return RESULT_OPERATION_FAIL;
         } else {
             recv_len = ans;
             return RESULT_OK;
         }
 
     }
-#endif
+
+    virtual u_result getRecvQueueSize(size_t & queued)
+    {
+        queued = 0;
+        int pending = 0;
+        if (::ioctl(_socket_fd, FIONREAD, &pending) == -1) {
+            return RESULT_OPERATION_FAIL;
+        }
+
+        if (!pending && waitforData(0) == RESULT_OK) {
+            // readable with nothing queued: the peer has closed, unless data just arrived
+            if (::ioctl(_socket_fd, FIONREAD, &pending) == -1 || !pending) {
+                return RESULT_OPERATION_FAIL;
+            }
+        }
+        queued = (size_t)pending;
+        return RESULT_OK;
+    }
 
     virtual u_result getPeerAddress(SocketAddress & peerAddr)
     {
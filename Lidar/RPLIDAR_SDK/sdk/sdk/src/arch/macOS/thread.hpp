@@ -68,6 +68,13 @@ Thread::priority_val_t Thread::getPriority()
 	return PRIORITY_NORMAL;
 }
 
+u_result Thread::setAffinity(int cpu)
+{
+	if (!this->_handle) return RESULT_OPERATION_FAIL;
+    // macOS offers affinity hints only, no hard pinning
+	return RESULT_OPERATION_NOT_SUPPORT;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
@@ -547,6 +547,53 @@ public:
         }
     }
 
+    virtual u_result recvNoWait(void *buf, size_t len, size_t & recv_len)
+    {
+        recv_len = 0;
+        u_long pending = 0;
+        if (::ioctlsocket(_socket_fd, FIONREAD, &pending) == SOCKET_ERROR) {
+            return RESULT_OPERATION_FAIL;
+        }
+
+        if (!pending) {
+            // nothing queued: either no data yet, or the peer has closed
+            switch (waitforData(0)) {
+            case RESULT_OPERATION_TIMEOUT:
+                return RESULT_OK;
+            case RESULT_OK:
+                break;
+            default:
+                return RESULT_OPERATION_FAIL;
+            }
+            pending = 1;
+        }
+
+        int ans = ::recv( _socket_fd, (char *)buf, (int)(len < pending ? len : pending), 0);
+        if (ans == SOCKET_ERROR || (ans == 0 && len)) {
+            return RESULT_OPERATION_FAIL;
+        }
+        recv_len = ans;
+        return RESULT_OK;
+    }
+
+    virtual u_result getRecvQueueSize(size_t & queued)
+    {
+        queued = 0;
+        u_long pending = 0;
+        if (::ioctlsocket(_socket_fd, FIONREAD, &pending) == SOCKET_ERROR) {
+            return RESULT_OPERATION_FAIL;
+        }
+
+        if (!pending && waitforData(0) == RESULT_OK) {
+            // readable with nothing queued: the peer has closed, unless data just arrived
+            if (::ioctlsocket(_socket_fd, FIONREAD, &pending) == SOCKET_ERROR || !pending) {
+                return RESULT_OPERATION_FAIL;
+            }
+        }
+        queued = (size_t)pending;
+        return RESULT_OK;
+    }
+
     virtual u_result getPeerAddress(SocketAddress & peerAddr)
     {
         struct sockaddr * addr = reinterpret_cast<struct sockaddr *>(const_cast<void *>(peerAddr.getPlatformData())); //donnot do this at home...
@@ -123,6 +123,18 @@ Thread::priority_val_t Thread::getPriority()
 	return PRIORITY_NORMAL;
 }
 
+u_result Thread::setAffinity(int cpu)
+{
+	if (!this->_handle) return RESULT_OPERATION_FAIL;
+	if (cpu < 0 || cpu >= (int)(sizeof(DWORD_PTR) * 8)) return RESULT_INVALID_DATA;
+
+	if (SetThreadAffinityMask(reinterpret_cast<HANDLE>(this->_handle), ((DWORD_PTR)1) << cpu))
+	{
+		return RESULT_OK;
+	}
+	return RESULT_OPERATION_FAIL;
+}
+
 u_result Thread::join(unsigned long timeout)
 {
     if (!this->_handle) return RESULT_OK;
@@ -73,6 +73,11 @@ public:
     virtual void clearDTR() = 0;
     virtual void cancelOperation() {}
 
+    // Let waitfordata() return only once at least bytes are buffered, even when
+    // less is requested; what is buffered is still returned on timeout if it is
+    // enough for the caller. 0 disables it. Ports may ignore it.
+    virtual void setLowWaterMark(size_t /*bytes*/) {}
+
     virtual bool isOpened()
     {
         return _is_serial_opened;
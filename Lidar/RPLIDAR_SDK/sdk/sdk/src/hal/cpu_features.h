@@ -0,0 +1,124 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+// Runtime detection of the optional instruction set extensions used by the
+// accelerated CRC and capsule decoding paths.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RP_HAL_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#define RP_HAL_CPU_ARM64_LINUX
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace rp{ namespace hal{
+
+#if defined(RP_HAL_CPU_X86)
+
+static inline void cpu_cpuid(unsigned int leaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, (int)leaf, 0);
+    for (int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+#else
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static inline bool cpu_has_pclmul()
+{
+    unsigned int regs[4];
+    cpu_cpuid(1, regs);
+    return (regs[2] & (1u << 1)) && (regs[3] & (1u << 26));
+}
+
+static inline bool cpu_has_sse41()
+{
+    unsigned int regs[4];
+    cpu_cpuid(1, regs);
+    return (regs[2] & (1u << 19)) != 0;
+}
+
+static inline bool cpu_has_avx2()
+{
+    unsigned int regs[4];
+    cpu_cpuid(0, regs);
+    if (regs[0] < 7) return false;
+
+    cpu_cpuid(1, regs);
+    // the OS must save the YMM state (OSXSAVE + XCR0 bits 1 and 2)
+    if (!(regs[2] & (1u << 27)) || !(regs[2] & (1u << 28))) return false;
+#if defined(_MSC_VER)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    unsigned int xlo, xhi;
+    __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    unsigned long long xcr0 = ((unsigned long long)xhi << 32) | xlo;
+#endif
+    if ((xcr0 & 0x6) != 0x6) return false;
+
+    cpu_cpuid(7, regs);
+    return (regs[1] & (1u << 5)) != 0;
+}
+
+#else
+
+static inline bool cpu_has_pclmul() { return false; }
+static inline bool cpu_has_sse41() { return false; }
+static inline bool cpu_has_avx2() { return false; }
+
+#endif
+
+#if defined(RP_HAL_CPU_ARM64_LINUX)
+static inline bool cpu_has_armv8_crc32()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+#else
+static inline bool cpu_has_armv8_crc32() { return false; }
+#endif
+
+}}
@@ -0,0 +1,139 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+// Read-only memory mapping of a whole file.
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rp{ namespace hal{
+
+class MappedFile
+{
+public:
+    MappedFile()
+        : _data(NULL)
+        , _size(0)
+#ifdef _WIN32
+        , _file(INVALID_HANDLE_VALUE)
+        , _mapping(NULL)
+#endif
+    {
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    // fails on empty files, they cannot be mapped
+    bool open(const char * path)
+    {
+        close();
+#ifdef _WIN32
+        _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (_file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > (size_t)-1) {
+            close();
+            return false;
+        }
+        _mapping = CreateFileMapping(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!_mapping) {
+            close();
+            return false;
+        }
+        _data = (const _u8 *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!_data) {
+            close();
+            return false;
+        }
+        _size = (size_t)size.QuadPart;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void * data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) return false;
+
+        // read front to back
+        madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+        _data = (const _u8 *)data;
+        _size = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (_data) UnmapViewOfFile(_data);
+        if (_mapping) CloseHandle(_mapping);
+        if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+        _mapping = NULL;
+        _file = INVALID_HANDLE_VALUE;
+#else
+        if (_data) munmap((void *)_data, _size);
+#endif
+        _data = NULL;
+        _size = 0;
+    }
+
+    const _u8 * data() const { return _data; }
+    size_t size() const { return _size; }
+
+protected:
+    const _u8 * _data;
+    size_t      _size;
+#ifdef _WIN32
+    HANDLE      _file;
+    HANDLE      _mapping;
+#endif
+};
+
+}}
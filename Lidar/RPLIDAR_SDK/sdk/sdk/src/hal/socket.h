@@ -114,6 +114,14 @@ public:
     virtual u_result send(const void * buffer, size_t len) = 0;
     
     virtual u_result recv(void *buf, size_t len, size_t & recv_len) = 0;
+
+    // returns immediately with whatever is pending (possibly nothing);
+    // fails on socket errors and when the peer has closed the connection
+    virtual u_result recvNoWait(void *buf, size_t len, size_t & recv_len) = 0;
+
+    // number of received bytes queued by the OS, without consuming them;
+    // fails on socket errors and when the peer has closed the connection
+    virtual u_result getRecvQueueSize(size_t & queued) = 0;
     
     virtual u_result getPeerAddress(SocketAddress & ) = 0;
 
@@ -74,6 +74,7 @@ public:
     u_result join(unsigned long timeout = -1);
 	u_result setPriority( priority_val_t p);
 	priority_val_t getPriority();
+	u_result setAffinity(int cpu);
 
     bool operator== ( const Thread & right) { return this->_handle == right._handle; }
 protected:
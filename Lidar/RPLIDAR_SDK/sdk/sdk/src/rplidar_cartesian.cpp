@@ -0,0 +1,157 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_cartesian.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RPLIDAR_CARTESIAN_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RPLIDAR_CARTESIAN_NEON
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+namespace {
+
+enum {
+    SIN_TABLE_SIZE = 1 << 16,   // every angle_z_q14 value, a full turn
+    QUARTER_TURN   = 1 << 14,   // cos(a) = sin(a + QUARTER_TURN)
+    CHUNK_SIZE     = 64,        // valid samples gathered before each vector pass
+};
+
+struct SinTable {
+    float value[SIN_TABLE_SIZE];
+
+    SinTable()
+    {
+        for (int angle = 0; angle < SIN_TABLE_SIZE; ++angle) {
+            value[angle] = (float)sin(angle * 3.14159265358979323846 * 2 / SIN_TABLE_SIZE);
+        }
+    }
+};
+
+const float * sin_table()
+{
+    static const SinTable table;
+    return table.value;
+}
+
+// x = dist * (rc * cos + rs * sin) + tx
+// y = dist * (rs * cos - rc * sin) + ty
+// with rc, rs the cos and sin of the transform yaw, the lidar frame y axis
+// pointing at angle 270 folded in.
+void _project(const float * dist, const float * cosv, const float * sinv, size_t count,
+              float rc, float rs, float tx, float ty, float * x, float * y)
+{
+    size_t pos = 0;
+#if defined(RPLIDAR_CARTESIAN_SSE2)
+    const __m128 vrc = _mm_set1_ps(rc);
+    const __m128 vrs = _mm_set1_ps(rs);
+    const __m128 vtx = _mm_set1_ps(tx);
+    const __m128 vty = _mm_set1_ps(ty);
+    for (; pos + 4 <= count; pos += 4) {
+        __m128 d = _mm_loadu_ps(dist + pos);
+        __m128 c = _mm_loadu_ps(cosv + pos);
+        __m128 s = _mm_loadu_ps(sinv + pos);
+        __m128 px = _mm_add_ps(_mm_mul_ps(vrc, c), _mm_mul_ps(vrs, s));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(vrs, c), _mm_mul_ps(vrc, s));
+        _mm_storeu_ps(x + pos, _mm_add_ps(_mm_mul_ps(d, px), vtx));
+        _mm_storeu_ps(y + pos, _mm_add_ps(_mm_mul_ps(d, py), vty));
+    }
+#elif defined(RPLIDAR_CARTESIAN_NEON)
+    const float32x4_t vrc = vdupq_n_f32(rc);
+    const float32x4_t vrs = vdupq_n_f32(rs);
+    const float32x4_t vtx = vdupq_n_f32(tx);
+    const float32x4_t vty = vdupq_n_f32(ty);
+    for (; pos + 4 <= count; pos += 4) {
+        float32x4_t d = vld1q_f32(dist + pos);
+        float32x4_t c = vld1q_f32(cosv + pos);
+        float32x4_t s = vld1q_f32(sinv + pos);
+        float32x4_t px = vmlaq_f32(vmulq_f32(vrc, c), vrs, s);
+        float32x4_t py = vmlsq_f32(vmulq_f32(vrs, c), vrc, s);
+        vst1q_f32(x + pos, vmlaq_f32(vtx, d, px));
+        vst1q_f32(y + pos, vmlaq_f32(vty, d, py));
+    }
+#endif
+    for (; pos < count; ++pos) {
+        x[pos] = dist[pos] * (rc * cosv[pos] + rs * sinv[pos]) + tx;
+        y[pos] = dist[pos] * (rs * cosv[pos] - rc * sinv[pos]) + ty;
+    }
+}
+
+}
+
+size_t scan_to_cartesian(const rplidar_response_measurement_node_hq_t * nodes, size_t count,
+                         const RplidarTransform2D * transform, float * x, float * y, float * quality)
+{
+    const float * table = sin_table();
+
+    float rc = 1, rs = 0, tx = 0, ty = 0;
+    if (transform) {
+        double yaw = transform->yaw * 3.14159265358979323846 / 180;
+        rc = (float)cos(yaw);
+        rs = (float)sin(yaw);
+        tx = transform->x;
+        ty = transform->y;
+    }
+
+    float dist[CHUNK_SIZE], cosv[CHUNK_SIZE], sinv[CHUNK_SIZE];
+    size_t points = 0;
+    size_t pos = 0;
+    while (pos < count) {
+        // gather the valid samples of the chunk, then project them together
+        size_t gathered = 0;
+        for (; pos < count && gathered < CHUNK_SIZE; ++pos) {
+            const rplidar_response_measurement_node_hq_t & node = nodes[pos];
+            if (!node.dist_mm_q2) continue;
+            _u16 angle = node.angle_z_q14;
+            dist[gathered] = node.dist_mm_q2 * 0.25f;
+            sinv[gathered] = table[angle];
+            cosv[gathered] = table[(_u16)(angle + QUARTER_TURN)];
+            if (quality) quality[points + gathered] = node.quality;
+            ++gathered;
+        }
+        _project(dist, cosv, sinv, gathered, rc, rs, tx, ty, x + points, y + points);
+        points += gathered;
+    }
+    return points;
+}
+
+}}}
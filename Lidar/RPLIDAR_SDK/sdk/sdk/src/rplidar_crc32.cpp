@@ -0,0 +1,290 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/cpu_features.h"
+#include "rplidar_crc32.h"
+
+#if defined(RP_HAL_CPU_X86)
+#define RPLIDAR_CRC32_CLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+#if defined(RP_HAL_CPU_ARM64_LINUX)
+#define RPLIDAR_CRC32_ARMV8
+#include <arm_acle.h>
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+typedef _u32 (*crc32_update_fn)(_u32 crc, const _u8 * data, size_t len);
+
+// 0x04C11DB7 bit reversed
+static const _u32 CRC32_POLY_REFLECTED = 0xEDB88320;
+
+// Slicing-by-8 lookup tables, generated at compile time.
+// _table[0] is the classic byte-wise table, _table[k] advances a byte by k more zero bytes.
+struct Crc32Tables
+{
+    _u32 _table[8][256];
+
+    constexpr Crc32Tables()
+        : _table()
+    {
+        for (_u32 i = 0; i < 256; ++i) {
+            _u32 c = i;
+            for (int j = 0; j < 8; ++j) {
+                c = (c & 1) ? (CRC32_POLY_REFLECTED ^ (c >> 1)) : (c >> 1);
+            }
+            _table[0][i] = c;
+        }
+        for (_u32 i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                _u32 prev = _table[k - 1][i];
+                _table[k][i] = (prev >> 8) ^ _table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+static constexpr Crc32Tables _crc32Tables;
+
+static inline _u32 _load_le32(const _u8 * p)
+{
+    return (_u32)p[0] | ((_u32)p[1] << 8) | ((_u32)p[2] << 16) | ((_u32)p[3] << 24);
+}
+
+static _u32 _crc32_update_slice8(_u32 crc, const _u8 * data, size_t len)
+{
+    const _u32 (*t)[256] = _crc32Tables._table;
+
+    while (len >= 8) {
+        _u32 lo = _load_le32(data) ^ crc;
+        _u32 hi = _load_le32(data + 4);
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(RPLIDAR_CRC32_CLMUL)
+
+#if defined(__GNUC__)
+#define RPLIDAR_CRC32_CLMUL_TARGET __attribute__((target("sse2,pclmul")))
+#else
+#define RPLIDAR_CRC32_CLMUL_TARGET
+#endif
+
+// Carry-less multiplication folding, see Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction". Constants are for the reflected polynomial.
+// Requires len >= 64 and a multiple of 16.
+RPLIDAR_CRC32_CLMUL_TARGET
+static _u32 _crc32_fold_clmul(_u32 crc, const _u8 * data, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30));
+    __m128i x5;
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    data += 64;
+    len -= 64;
+
+    // fold 4 x 128 bits in parallel
+    while (len >= 64) {
+        __m128i x6, x7, x8;
+        x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 0x30)));
+
+        data += 64;
+        len -= 64;
+    }
+
+    // fold into 128 bits
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // single 128 bit folds
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data))), x5);
+        data += 16;
+        len -= 16;
+    }
+
+    // 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask32);
+    x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x2 = _mm_and_si128(x1, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+    x2 = _mm_and_si128(x2, mask32);
+    x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (_u32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static _u32 _crc32_update_clmul(_u32 crc, const _u8 * data, size_t len)
+{
+    if (len >= 64) {
+        size_t folded = len & ~(size_t)15;
+        crc = _crc32_fold_clmul(crc, data, folded);
+        data += folded;
+        len -= folded;
+    }
+    return _crc32_update_slice8(crc, data, len);
+}
+
+#endif
+
+#if defined(RPLIDAR_CRC32_ARMV8)
+
+#if defined(__clang__)
+#define RPLIDAR_CRC32_ARMV8_TARGET __attribute__((target("crc")))
+#else
+#define RPLIDAR_CRC32_ARMV8_TARGET __attribute__((target("+crc")))
+#endif
+
+// The ARMv8 CRC32 instructions implement exactly this (reflected) polynomial.
+RPLIDAR_CRC32_ARMV8_TARGET
+static _u32 _crc32_update_armv8(_u32 crc, const _u8 * data, size_t len)
+{
+    while (len >= 8) {
+        _u64 v;
+        memcpy(&v, data, sizeof(v));
+        crc = __crc32d(crc, v);
+        data += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32b(crc, *data++);
+    }
+    return crc;
+}
+
+#endif
+
+static crc32_update_fn _crc32_select()
+{
+#if defined(RPLIDAR_CRC32_CLMUL)
+    if (rp::hal::cpu_has_pclmul()) return _crc32_update_clmul;
+#endif
+#if defined(RPLIDAR_CRC32_ARMV8)
+    if (rp::hal::cpu_has_armv8_crc32()) return _crc32_update_armv8;
+#endif
+    return _crc32_update_slice8;
+}
+
+_u32 crc32_update(_u32 crc, const _u8 * data, size_t len)
+{
+    // initialized exactly once, even with several drivers running concurrently
+    static const crc32_update_fn impl = _crc32_select();
+    return impl(crc, data, len);
+}
+
+bool crc32_update_with(int impl, _u32 & crc, const _u8 * data, size_t len)
+{
+    switch (impl) {
+    case CRC32_IMPL_TABLE:
+        crc = _crc32_update_slice8(crc, data, len);
+        return true;
+#if defined(RPLIDAR_CRC32_CLMUL)
+    case CRC32_IMPL_CLMUL:
+        if (!rp::hal::cpu_has_pclmul()) return false;
+        crc = _crc32_update_clmul(crc, data, len);
+        return true;
+#endif
+#if defined(RPLIDAR_CRC32_ARMV8)
+    case CRC32_IMPL_ARMV8:
+        if (!rp::hal::cpu_has_armv8_crc32()) return false;
+        crc = _crc32_update_armv8(crc, data, len);
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+_u32 crc32_hq(const _u8 * data, size_t len)
+{
+    static const _u8 zeros[4] = { 0, 0, 0, 0 };
+
+    _u32 crc = crc32_update(0xFFFFFFFF, data, len);
+    crc = crc32_update(crc, zeros, (4 - len) & 0x3); // zero padding
+    return crc ^ 0xFFFFFFFF;
+}
+
+}}}
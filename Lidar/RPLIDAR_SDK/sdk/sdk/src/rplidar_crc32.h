@@ -0,0 +1,58 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// CRC32 of the HQ capsules: reflected polynomial 0x04C11DB7, initial value and
+// final xor 0xFFFFFFFF, computed over the data zero-padded to a multiple of 4 bytes.
+_u32 crc32_hq(const _u8 * data, size_t len);
+
+// Raw update of the (reflected, non-inverted) CRC register, without padding.
+// The fastest implementation supported by the running CPU is picked on first use.
+_u32 crc32_update(_u32 crc, const _u8 * data, size_t len);
+
+enum {
+    CRC32_IMPL_TABLE = 0,   // slicing-by-8, always available
+    CRC32_IMPL_CLMUL = 1,   // x86 PCLMULQDQ folding
+    CRC32_IMPL_ARMV8 = 2,   // ARMv8 CRC32 instructions
+};
+
+// crc32_update() through one given implementation, for tests and benchmarks.
+// Returns false, leaving crc untouched, when the implementation is not built
+// in or not supported by the running CPU.
+bool crc32_update_with(int impl, _u32 & crc, const _u8 * data, size_t len);
+
+}}}
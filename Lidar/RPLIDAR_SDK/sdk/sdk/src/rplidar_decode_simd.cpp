@@ -0,0 +1,332 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "hal/cpu_features.h"
+#include "rplidar_decode_simd.h"
+#include "rplidar_ultra_correction.h"
+
+#if defined(RP_HAL_CPU_X86)
+#define RPLIDAR_DECODE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define RPLIDAR_DECODE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Functions between RPLIDAR_DECODE_TARGET_BEGIN and RPLIDAR_DECODE_TARGET_END are
+// compiled for the given instruction set and only called after a runtime check.
+#if defined(__clang__)
+#define RPLIDAR_DECODE_PRAGMA(x) _Pragma(#x)
+#define RPLIDAR_DECODE_TARGET_BEGIN(isa) RPLIDAR_DECODE_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#define RPLIDAR_DECODE_TARGET_END RPLIDAR_DECODE_PRAGMA(clang attribute pop)
+#elif defined(__GNUC__)
+#define RPLIDAR_DECODE_PRAGMA(x) _Pragma(#x)
+#define RPLIDAR_DECODE_TARGET_BEGIN(isa) RPLIDAR_DECODE_PRAGMA(GCC push_options) RPLIDAR_DECODE_PRAGMA(GCC target(isa))
+#define RPLIDAR_DECODE_TARGET_END RPLIDAR_DECODE_PRAGMA(GCC pop_options)
+#else
+#define RPLIDAR_DECODE_TARGET_BEGIN(isa)
+#define RPLIDAR_DECODE_TARGET_END
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+static inline unsigned _lowest_bit(_u32 mask)
+{
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+struct CapsuleDecoders {
+    void (*ultra)(const _u32 *, int, int, bool &, rplidar_response_measurement_node_hq_t *);
+    void (*express)(const rplidar_response_capsule_measurement_nodes_t &, int, int, bool &, rplidar_response_measurement_node_hq_t *);
+    void (*dense)(const rplidar_response_dense_capsule_measurement_nodes_t &, int, int, bool &, rplidar_response_measurement_node_hq_t *);
+};
+
+#if defined(RPLIDAR_DECODE_X86)
+
+RPLIDAR_DECODE_TARGET_BEGIN("sse4.1")
+namespace sse41 {
+
+typedef __m128i vint;
+enum { VLANES = 4 };
+
+static inline vint vload(const void * p)            { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+static inline void vstore(void * p, vint v)         { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+static inline vint vset1(int x)                     { return _mm_set1_epi32(x); }
+static inline vint vlanes()                         { return _mm_setr_epi32(0, 1, 2, 3); }
+static inline vint vlanebits()                      { return _mm_setr_epi32(1, 2, 4, 8); }
+static inline vint vadd(vint a, vint b)             { return _mm_add_epi32(a, b); }
+static inline vint vsub(vint a, vint b)             { return _mm_sub_epi32(a, b); }
+static inline vint vmul(vint a, vint b)             { return _mm_mullo_epi32(a, b); }
+static inline vint vand(vint a, vint b)             { return _mm_and_si128(a, b); }
+static inline vint vor(vint a, vint b)              { return _mm_or_si128(a, b); }
+static inline vint vandnot(vint a, vint b)          { return _mm_andnot_si128(a, b); }
+static inline vint vslli(vint a, int n)             { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vsrai(vint a, int n)             { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vsrli(vint a, int n)             { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vcmpgt(vint a, vint b)           { return _mm_cmpgt_epi32(a, b); }
+static inline vint vcmpeq(vint a, vint b)           { return _mm_cmpeq_epi32(a, b); }
+// m is a full lane mask. The float blend only reads the sign bits; GCC folds the
+// byte blend on char vectors, which breaks under the -funsigned-char the SDK builds with.
+static inline vint vsel(vint m, vint a, vint b)     { return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b), _mm_castsi128_ps(a), _mm_castsi128_ps(m))); }
+static inline _u32 vmovemask(vint m)                { return (_u32)_mm_movemask_ps(_mm_castsi128_ps(m)); }
+
+// table[index] for each lane
+static inline vint vgather(const _s32 * table, vint index)
+{
+    return _mm_setr_epi32(table[_mm_cvtsi128_si32(index)], table[_mm_extract_epi32(index, 1)],
+                          table[_mm_extract_epi32(index, 2)], table[_mm_extract_epi32(index, 3)]);
+}
+
+// high 32 bits of the unsigned 32 x 32 bit products
+static inline vint vmulhi_u32(vint a, vint b)
+{
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(a, b), 32);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_blend_epi16(even, odd, 0xCC);
+}
+
+static inline void vstore_nodes(rplidar_response_measurement_node_hq_t * nodebuffer, vint lo, vint hi)
+{
+    vstore(nodebuffer, _mm_unpacklo_epi32(lo, hi));
+    vstore(nodebuffer + 2, _mm_unpackhi_epi32(lo, hi));
+}
+
+#include "rplidar_decode_simd_kernel.h"
+
+}
+RPLIDAR_DECODE_TARGET_END
+
+RPLIDAR_DECODE_TARGET_BEGIN("avx2")
+namespace avx2 {
+
+typedef __m256i vint;
+enum { VLANES = 8 };
+
+static inline vint vload(const void * p)            { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+static inline void vstore(void * p, vint v)         { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+static inline vint vset1(int x)                     { return _mm256_set1_epi32(x); }
+static inline vint vlanes()                         { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+static inline vint vlanebits()                      { return _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128); }
+static inline vint vadd(vint a, vint b)             { return _mm256_add_epi32(a, b); }
+static inline vint vsub(vint a, vint b)             { return _mm256_sub_epi32(a, b); }
+static inline vint vmul(vint a, vint b)             { return _mm256_mullo_epi32(a, b); }
+static inline vint vand(vint a, vint b)             { return _mm256_and_si256(a, b); }
+static inline vint vor(vint a, vint b)              { return _mm256_or_si256(a, b); }
+static inline vint vandnot(vint a, vint b)          { return _mm256_andnot_si256(a, b); }
+static inline vint vslli(vint a, int n)             { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vsrai(vint a, int n)             { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vsrli(vint a, int n)             { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+static inline vint vcmpgt(vint a, vint b)           { return _mm256_cmpgt_epi32(a, b); }
+static inline vint vcmpeq(vint a, vint b)           { return _mm256_cmpeq_epi32(a, b); }
+static inline vint vsel(vint m, vint a, vint b)     { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), _mm256_castsi256_ps(m))); }
+static inline _u32 vmovemask(vint m)                { return (_u32)_mm256_movemask_ps(_mm256_castsi256_ps(m)); }
+
+static inline vint vgather(const _s32 * table, vint index)
+{
+    return _mm256_i32gather_epi32(reinterpret_cast<const int *>(table), index, 4);
+}
+
+static inline vint vmulhi_u32(vint a, vint b)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+    return _mm256_blend_epi32(even, odd, 0xAA);
+}
+
+static inline void vstore_nodes(rplidar_response_measurement_node_hq_t * nodebuffer, vint lo, vint hi)
+{
+    // unpack works within 128 bit halves, put the records back in sample order
+    vint a = _mm256_unpacklo_epi32(lo, hi);
+    vint b = _mm256_unpackhi_epi32(lo, hi);
+    vstore(nodebuffer, _mm256_permute2x128_si256(a, b, 0x20));
+    vstore(nodebuffer + 4, _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+#include "rplidar_decode_simd_kernel.h"
+
+}
+RPLIDAR_DECODE_TARGET_END
+
+#endif
+
+#if defined(RPLIDAR_DECODE_NEON)
+
+namespace neon {
+
+typedef int32x4_t vint;
+enum { VLANES = 4 };
+
+static inline vint vload(const void * p)            { return vld1q_s32(reinterpret_cast<const int32_t *>(p)); }
+static inline void vstore(void * p, vint v)         { vst1q_s32(reinterpret_cast<int32_t *>(p), v); }
+static inline vint vset1(int x)                     { return vdupq_n_s32(x); }
+static inline vint vlanes()                         { static const int32_t l[4] = { 0, 1, 2, 3 }; return vld1q_s32(l); }
+static inline vint vlanebits()                      { static const int32_t l[4] = { 1, 2, 4, 8 }; return vld1q_s32(l); }
+static inline vint vadd(vint a, vint b)             { return vaddq_s32(a, b); }
+static inline vint vsub(vint a, vint b)             { return vsubq_s32(a, b); }
+static inline vint vmul(vint a, vint b)             { return vmulq_s32(a, b); }
+static inline vint vand(vint a, vint b)             { return vandq_s32(a, b); }
+static inline vint vor(vint a, vint b)              { return vorrq_s32(a, b); }
+static inline vint vandnot(vint a, vint b)          { return vbicq_s32(b, a); }
+static inline vint vslli(vint a, int n)             { return vshlq_s32(a, vdupq_n_s32(n)); }
+static inline vint vsrai(vint a, int n)             { return vshlq_s32(a, vdupq_n_s32(-n)); }
+static inline vint vsrli(vint a, int n)             { return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a), vdupq_n_s32(-n))); }
+static inline vint vcmpgt(vint a, vint b)           { return vreinterpretq_s32_u32(vcgtq_s32(a, b)); }
+static inline vint vcmpeq(vint a, vint b)           { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+static inline vint vsel(vint m, vint a, vint b)     { return vbslq_s32(vreinterpretq_u32_s32(m), a, b); }
+static inline _u32 vmovemask(vint m)                { return vaddvq_u32(vandq_u32(vreinterpretq_u32_s32(m), vreinterpretq_u32_s32(vlanebits()))); }
+
+static inline vint vgather(const _s32 * table, vint index)
+{
+    const int32_t v[4] = {
+        table[vgetq_lane_s32(index, 0)], table[vgetq_lane_s32(index, 1)],
+        table[vgetq_lane_s32(index, 2)], table[vgetq_lane_s32(index, 3)],
+    };
+    return vld1q_s32(v);
+}
+
+static inline vint vmulhi_u32(vint a, vint b)
+{
+    uint32x4_t ua = vreinterpretq_u32_s32(a), ub = vreinterpretq_u32_s32(b);
+    uint32x2_t lo = vshrn_n_u64(vmull_u32(vget_low_u32(ua), vget_low_u32(ub)), 32);
+    uint32x2_t hi = vshrn_n_u64(vmull_u32(vget_high_u32(ua), vget_high_u32(ub)), 32);
+    return vreinterpretq_s32_u32(vcombine_u32(lo, hi));
+}
+
+static inline void vstore_nodes(rplidar_response_measurement_node_hq_t * nodebuffer, vint lo, vint hi)
+{
+    int32x4x2_t z = vzipq_s32(lo, hi);
+    vstore(nodebuffer, z.val[0]);
+    vstore(nodebuffer + 2, z.val[1]);
+}
+
+#include "rplidar_decode_simd_kernel.h"
+
+}
+
+#endif
+
+static const CapsuleDecoders * _selectCapsuleDecoders()
+{
+#if defined(RPLIDAR_DECODE_X86)
+    if (rp::hal::cpu_has_avx2()) return &avx2::decoders;
+    if (rp::hal::cpu_has_sse41()) return &sse41::decoders;
+#endif
+#if defined(RPLIDAR_DECODE_NEON)
+    return &neon::decoders;
+#endif
+    return NULL;
+}
+
+static int                     _pinnedIsa = DECODE_SIMD_AUTO;
+static const CapsuleDecoders * _pinnedDecoders = NULL;
+
+static const CapsuleDecoders * _capsuleDecoders()
+{
+    static const CapsuleDecoders * decoders = _selectCapsuleDecoders();
+    if (_pinnedIsa != DECODE_SIMD_AUTO) return _pinnedDecoders;
+    return decoders;
+}
+
+bool decode_simd_select(int isa)
+{
+    const CapsuleDecoders * decoders = NULL;
+    switch (isa) {
+    case DECODE_SIMD_AUTO:
+    case DECODE_SIMD_NONE:
+        break;
+#if defined(RPLIDAR_DECODE_X86)
+    case DECODE_SIMD_SSE41:
+        if (!rp::hal::cpu_has_sse41()) return false;
+        decoders = &sse41::decoders;
+        break;
+    case DECODE_SIMD_AVX2:
+        if (!rp::hal::cpu_has_avx2()) return false;
+        decoders = &avx2::decoders;
+        break;
+#endif
+#if defined(RPLIDAR_DECODE_NEON)
+    case DECODE_SIMD_NEON:
+        decoders = &neon::decoders;
+        break;
+#endif
+    default:
+        return false;
+    }
+
+    _pinnedIsa = isa;
+    _pinnedDecoders = decoders;
+    return true;
+}
+
+bool decode_ultra_capsule_simd(const _u32 * combined_x3, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const CapsuleDecoders * decoders = _capsuleDecoders();
+    if (!decoders) return false;
+
+    decoders->ultra(combined_x3, startAngle_q16, angleInc_q16, syncFound, nodebuffer);
+    return true;
+}
+
+bool decode_express_capsule_simd(const rplidar_response_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const CapsuleDecoders * decoders = _capsuleDecoders();
+    if (!decoders) return false;
+
+    decoders->express(capsule, startAngle_q16, angleInc_q16, syncFound, nodebuffer);
+    return true;
+}
+
+bool decode_dense_capsule_simd(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    const CapsuleDecoders * decoders = _capsuleDecoders();
+    if (!decoders) return false;
+
+    decoders->dense(capsule, startAngle_q16, angleInc_q16, syncFound, nodebuffer);
+    return true;
+}
+
+}}}
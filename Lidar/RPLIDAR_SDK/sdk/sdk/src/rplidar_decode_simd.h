@@ -0,0 +1,89 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Vectorized capsule decoders (SSE4.1 / AVX2 on x86, NEON on aarch64).
+//
+// They produce bit-identical nodes to the scalar decoders of RPlidarDriverImplCommon,
+// including the sync bit detection state. Each returns false without touching its
+// outputs when no vector implementation is usable on the running CPU; the caller
+// then falls back to the scalar code.
+
+enum {
+    ULTRA_CAPSULE_CABINS    = 32,
+    ULTRA_CAPSULE_SAMPLES   = ULTRA_CAPSULE_CABINS * 3,
+    EXPRESS_CAPSULE_CABINS  = 16,
+    EXPRESS_CAPSULE_SAMPLES = EXPRESS_CAPSULE_CABINS * 2,
+    DENSE_CAPSULE_SAMPLES   = 40,
+    CAPSULE_SYNC_WORDS      = (ULTRA_CAPSULE_SAMPLES + 31) / 32,
+};
+
+enum {
+    DECODE_SIMD_AUTO  = 0,  // the best implementation of the running CPU
+    DECODE_SIMD_NONE  = 1,  // always fall back to the scalar decoders
+    DECODE_SIMD_SSE41 = 2,
+    DECODE_SIMD_AVX2  = 3,
+    DECODE_SIMD_NEON  = 4,
+};
+
+// Pin the implementation used by every driver of the process, for tests and
+// benchmarks. Must not be called while capsules are being decoded. Returns
+// false, keeping the current choice, when the implementation is not built in
+// or not supported by the running CPU.
+bool decode_simd_select(int isa);
+
+// Decode the cabins of an ultra capsule into ULTRA_CAPSULE_SAMPLES nodes.
+//
+// \param combined_x3    ULTRA_CAPSULE_CABINS + 1 words: the cabins of the capsule being
+//                       decoded followed by the first cabin of the next capsule
+// \param startAngle_q16 raw angle of the first sample
+// \param angleInc_q16   angle increment between two samples. Must be positive and
+//                       startAngle_q16 + (ULTRA_CAPSULE_SAMPLES + 1) * angleInc_q16 must
+//                       stay below 720 degrees
+// \param syncFound      sync bit detection state, see _getSyncBitByAngle()
+bool decode_ultra_capsule_simd(const _u32 * combined_x3, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+// Decode the cabins of an express capsule into EXPRESS_CAPSULE_SAMPLES nodes.
+// The parameters are those of decode_ultra_capsule_simd(). Any angleInc_q16 derived
+// from two consecutive start angles is within range.
+bool decode_express_capsule_simd(const rplidar_response_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+// Decode the cabins of a dense capsule into DENSE_CAPSULE_SAMPLES nodes, as
+// decode_express_capsule_simd().
+bool decode_dense_capsule_simd(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer);
+
+}}}
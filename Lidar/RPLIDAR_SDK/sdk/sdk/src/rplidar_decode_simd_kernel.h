@@ -0,0 +1,239 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Instruction set independent body of the vectorized capsule decoders.
+//
+// Included once per instruction set by rplidar_decode_simd.cpp, inside a namespace
+// that provides the vint type, VLANES and the v* primitives. No include guard.
+
+// x / 90 for 0 <= x < 2^23 (every angle_z_q14 numerator), as a multiply-shift.
+// 3054198967 = ceil(2^38 / 90) is exact for x < 2^38 / 86.
+static inline vint vdiv90(vint x)
+{
+    return vsrli(vmulhi_u32(x, vset1((int)3054198967u)), 6);
+}
+
+// var bit scale decoding, see _varbitscale_decode(). scale receives 1 << scaleLevel.
+static inline vint vbs_decode(vint scaled, vint & scale)
+{
+    static const int SCALED_BASE[4] = {
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+    };
+    static const int TARGET_BASE[4] = {
+        (0x1 << RPLIDAR_VARBITSCALE_X2_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X4_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X8_SRC_BIT),
+        (0x1 << RPLIDAR_VARBITSCALE_X16_SRC_BIT),
+    };
+
+    vint scaledBase = vset1(0);
+    vint targetBase = vset1(0);
+    vint sc = vset1(1);
+    for (int i = 0; i < 4; ++i) {
+        vint hit = vcmpgt(scaled, vset1(SCALED_BASE[i] - 1));
+        scaledBase = vsel(hit, vset1(SCALED_BASE[i]), scaledBase);
+        targetBase = vsel(hit, vset1(TARGET_BASE[i]), targetBase);
+        sc = vsel(hit, vset1(2 << i), sc);
+    }
+    scale = sc;
+    return vadd(targetBase, vmul(vsub(scaled, scaledBase), sc));
+}
+
+// Sync bit of count consecutive samples, see _getSyncBitByAngle().
+// The predicted angles are classified in vectors, then only the state transitions
+// are walked.
+static void detect_sync(int startAngle_q16, int angleInc_q16, int count, bool & syncFound, _u32 * syncBits)
+{
+    _u32 lowBits[CAPSULE_SYNC_WORDS] = { 0 };
+    _u32 highBits[CAPSULE_SYNC_WORDS] = { 0 };
+    const vint laneAngle = vmul(vlanes(), vset1(angleInc_q16));
+
+    for (int i = 0; i < count; i += VLANES) {
+        vint predict = vadd(vset1(startAngle_q16 + (i + 1) * angleInc_q16), laneAngle);
+        predict = vsub(predict, vand(vcmpgt(predict, vset1((360 << 16) - 1)), vset1(360 << 16)));
+
+        vint low = vand(vcmpgt(predict, vset1(0)), vcmpgt(vset1(90 << 16), predict));
+        vint high = vcmpgt(predict, vset1(270 << 16));
+        lowBits[i >> 5] |= vmovemask(low) << (i & 31);
+        highBits[i >> 5] |= vmovemask(high) << (i & 31);
+    }
+
+    for (int w = 0; w < (count + 31) / 32; ++w) syncBits[w] = 0;
+
+    for (int i = 0; i < count; ) {
+        int w = i >> 5;
+        _u32 pending = (syncFound ? highBits[w] : lowBits[w]) >> (i & 31);
+        if (!pending) {
+            i = (w + 1) << 5;
+            continue;
+        }
+        i += (int)_lowest_bit(pending);
+        if (i >= count) break;
+        if (!syncFound) {
+            syncBits[i >> 5] |= 1u << (i & 31);
+        }
+        syncFound = !syncFound;
+        ++i;
+    }
+}
+
+// Pack the decoded fields into rplidar_response_measurement_node_hq_t records.
+static inline void store_nodes(rplidar_response_measurement_node_hq_t * nodebuffer, vint angle_z_q14, vint dist_mm_q2, vint sync)
+{
+    vint quality = vandnot(vcmpeq(dist_mm_q2, vset1(0)), vset1(0x2F << RPLIDAR_RESP_MEASUREMENT_QUALITY_SHIFT));
+    vint flag = vsub(vset1(2), vand(sync, vset1(1)));
+
+    vint lo = vor(vand(angle_z_q14, vset1(0xFFFF)), vslli(dist_mm_q2, 16));
+    vint hi = vor(vor(vsrli(dist_mm_q2, 16), vslli(quality, 16)), vslli(flag, 24));
+    vstore_nodes(nodebuffer, lo, hi);
+}
+
+static inline vint sync_lanes(const _u32 * syncBits, int i)
+{
+    vint bits = vset1((int)(syncBits[i >> 5] >> (i & 31)));
+    return vcmpeq(vand(bits, vlanebits()), vlanebits());
+}
+
+static void decode_ultra_capsule(const _u32 * combined_x3, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    _s32 cabinDist[3][ULTRA_CAPSULE_CABINS];
+    _s32 dist_q2[ULTRA_CAPSULE_SAMPLES];
+    _u32 syncBits[CAPSULE_SYNC_WORDS];
+    const _s32 * correction = ultra_angle_correction_table();
+
+    // distances, one cabin per lane
+    for (int c = 0; c < ULTRA_CAPSULE_CABINS; c += VLANES) {
+        vint combined = vload(combined_x3 + c);
+        vint scale1, scale2;
+        vint major = vbs_decode(vand(combined, vset1(0xFFF)), scale1);
+        vint major2 = vbs_decode(vand(vload(combined_x3 + c + 1), vset1(0xFFF)), scale2);
+
+        vint borrow = vandnot(vcmpeq(major2, vset1(0)), vcmpeq(major, vset1(0)));
+        vint base1 = vsel(borrow, major2, major);
+        scale1 = vsel(borrow, scale2, scale1);
+
+        // signed 10 bit predictions
+        vint predict1 = vsrai(vslli(combined, 10), 22);
+        vint predict2 = vsrai(combined, 22);
+        vint invalid1 = vor(vcmpeq(predict1, vset1(-512)), vcmpeq(predict1, vset1(0x1FF)));
+        vint invalid2 = vor(vcmpeq(predict2, vset1(-512)), vcmpeq(predict2, vset1(0x1FF)));
+
+        vstore(cabinDist[0] + c, vslli(major, 2));
+        vstore(cabinDist[1] + c, vandnot(invalid1, vslli(vadd(vmul(predict1, scale1), base1), 2)));
+        vstore(cabinDist[2] + c, vandnot(invalid2, vslli(vadd(vmul(predict2, scale2), major2), 2)));
+    }
+
+    for (int c = 0; c < ULTRA_CAPSULE_CABINS; ++c) {
+        dist_q2[c * 3 + 0] = cabinDist[0][c];
+        dist_q2[c * 3 + 1] = cabinDist[1][c];
+        dist_q2[c * 3 + 2] = cabinDist[2][c];
+    }
+
+    detect_sync(startAngle_q16, angleInc_q16, ULTRA_CAPSULE_SAMPLES, syncFound, syncBits);
+
+    // angles, one sample per lane
+    const vint laneAngle = vmul(vlanes(), vset1(angleInc_q16));
+    for (int i = 0; i < ULTRA_CAPSULE_SAMPLES; i += VLANES) {
+        vint dist = vload(dist_q2 + i);
+        vint angle = vadd(vset1(startAngle_q16 + i * angleInc_q16), laneAngle);
+
+        // see ultra_angle_correction_q16()
+        vint mm = vsrai(dist, 2);
+        mm = vandnot(vcmpgt(vset1(0), mm), mm);
+        mm = vsel(vcmpgt(mm, vset1(ULTRA_CORRECTION_FAR_MM)), vset1(ULTRA_CORRECTION_FAR_MM), mm);
+
+        vint angle_q6 = vsrai(vsub(angle, vgather(correction, mm)), 10);
+        angle_q6 = vadd(angle_q6, vand(vcmpgt(vset1(0), angle_q6), vset1(360 << 6)));
+        angle_q6 = vsub(angle_q6, vand(vcmpgt(angle_q6, vset1((360 << 6) - 1)), vset1(360 << 6)));
+
+        store_nodes(nodebuffer + i, vdiv90(vslli(angle_q6, 8)), dist, sync_lanes(syncBits, i));
+    }
+}
+
+static void decode_express_capsule(const rplidar_response_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    _s32 dist_q2[EXPRESS_CAPSULE_SAMPLES];
+    _s32 offset_q3[EXPRESS_CAPSULE_SAMPLES];
+    _u32 syncBits[CAPSULE_SYNC_WORDS];
+
+    // the cabins are packed 5 byte records, split them first
+    for (int c = 0; c < EXPRESS_CAPSULE_CABINS; ++c) {
+        const rplidar_response_cabin_nodes_t & cabin = capsule.cabins[c];
+        dist_q2[c * 2 + 0] = cabin.distance_angle_1 & 0xFFFC;
+        dist_q2[c * 2 + 1] = cabin.distance_angle_2 & 0xFFFC;
+        offset_q3[c * 2 + 0] = (cabin.offset_angles_q3 & 0xF) | ((cabin.distance_angle_1 & 0x3) << 4);
+        offset_q3[c * 2 + 1] = (cabin.offset_angles_q3 >> 4) | ((cabin.distance_angle_2 & 0x3) << 4);
+    }
+
+    detect_sync(startAngle_q16, angleInc_q16, EXPRESS_CAPSULE_SAMPLES, syncFound, syncBits);
+
+    const vint laneAngle = vmul(vlanes(), vset1(angleInc_q16));
+    for (int i = 0; i < EXPRESS_CAPSULE_SAMPLES; i += VLANES) {
+        vint angle = vadd(vset1(startAngle_q16 + i * angleInc_q16), laneAngle);
+        angle = vsub(angle, vslli(vload(offset_q3 + i), 13));
+        angle = vadd(angle, vand(vcmpgt(vset1(0), angle), vset1(360 << 16)));
+        angle = vsub(angle, vand(vcmpgt(angle, vset1((360 << 16) - 1)), vset1(360 << 16)));
+
+        store_nodes(nodebuffer + i, vdiv90(vsrli(angle, 2)), vload(dist_q2 + i), sync_lanes(syncBits, i));
+    }
+}
+
+static void decode_dense_capsule(const rplidar_response_dense_capsule_measurement_nodes_t & capsule, int startAngle_q16, int angleInc_q16, bool & syncFound, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    _s32 dist_q2[DENSE_CAPSULE_SAMPLES];
+    _u32 syncBits[CAPSULE_SYNC_WORDS];
+
+    for (int c = 0; c < DENSE_CAPSULE_SAMPLES; ++c) {
+        dist_q2[c] = capsule.cabins[c].distance << 2;
+    }
+
+    detect_sync(startAngle_q16, angleInc_q16, DENSE_CAPSULE_SAMPLES, syncFound, syncBits);
+
+    const vint laneAngle = vmul(vlanes(), vset1(angleInc_q16));
+    for (int i = 0; i < DENSE_CAPSULE_SAMPLES; i += VLANES) {
+        vint angle_q6 = vsrai(vadd(vset1(startAngle_q16 + i * angleInc_q16), laneAngle), 10);
+        angle_q6 = vsub(angle_q6, vand(vcmpgt(angle_q6, vset1((360 << 6) - 1)), vset1(360 << 6)));
+
+        store_nodes(nodebuffer + i, vdiv90(vslli(angle_q6, 8)), vload(dist_q2 + i), sync_lanes(syncBits, i));
+    }
+}
+
+static const CapsuleDecoders decoders = {
+    decode_ultra_capsule,
+    decode_express_capsule,
+    decode_dense_capsule,
+};
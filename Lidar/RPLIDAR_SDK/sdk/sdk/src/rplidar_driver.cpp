@@ -41,9 +41,25 @@
 #include "hal/locker.h"
 #include "hal/socket.h"
 #include "hal/event.h"
+#include "hal/mapped_file.h"
+#include "rplidar_scan_ring.h"
+#include "rplidar_interval_ring.h"
+#include "rplidar_scan_subscription.h"
+#include "rplidar_sample_timestamper.h"
+#include "rplidar_packet_scanner.h"
+#include "rplidar_packet_queue.h"
+#include "rplidar_crc32.h"
+#include "rplidar_profile_cache.h"
+#include "rplidar_spin_monitor.h"
+#include "rplidar_scan_grid.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_stream_record.h"
+#include "rplidar_decode_simd.h"
+#include "rplidar_ultra_correction.h"
 #include "rplidar_driver_impl.h"
 #include "rplidar_driver_serial.h"
 #include "rplidar_driver_TCP.h"
+#include "rplidar_driver_replay.h"
 
 #include <algorithm>
 
@@ -82,13 +98,18 @@ static void convert(const rplidar_response_measurement_node_hq_t& from, rplidar_
 }
 
 // Factory Impl
-RPlidarDriver * RPlidarDriver::CreateDriver(_u32 drivertype)
+RPlidarDriver * RPlidarDriver::CreateDriver(_u32 drivertype, size_t maxScanNodes, _u32 options)
 {
+    // a full scan buffer keeps its last entry free
+    if (maxScanNodes < 2) return NULL;
+
     switch (drivertype) {
     case DRIVER_TYPE_SERIALPORT:
-        return new RPlidarDriverSerial();
+        return new RPlidarDriverSerial(maxScanNodes, options);
     case DRIVER_TYPE_TCP:
-         return new RPlidarDriverTCP();
+         return new RPlidarDriverTCP(maxScanNodes, options);
+    case DRIVER_TYPE_REPLAY:
+        return new RPlidarDriverReplay(maxScanNodes, options);
     default:
         return NULL;
     }
@@ -100,16 +121,154 @@ void RPlidarDriver::DisposeDriver(RPlidarDriver * drv)
     delete drv;
 }
 
+u_result RPlidarDriver::ConvertScanToArrays(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * angle_rad, float * range_mm, _u8 * quality, _u8 * flag)
+{
+    if (count && (!nodebuffer || !angle_rad || !range_mm)) return RESULT_INVALID_DATA;
+
+    scan_to_arrays(nodebuffer, count, angle_rad, range_mm, quality, flag);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriver::ConvertArraysToScan(const RplidarScanArrays & arrays, rplidar_response_measurement_node_hq_t * nodebuffer)
+{
+    if (arrays.count && (!nodebuffer || !arrays.angle_rad || !arrays.range_mm)) return RESULT_INVALID_DATA;
+
+    arrays_to_scan(arrays.angle_rad, arrays.range_mm, arrays.quality, arrays.flag, arrays.count, nodebuffer);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriver::ConvertScanToCartesian(const rplidar_response_measurement_node_hq_t * nodebuffer, size_t count, float * x, float * y, float * quality, size_t & pointCount, const RplidarTransform2D * transform)
+{
+    pointCount = 0;
+    if (count && (!nodebuffer || !x || !y)) return RESULT_INVALID_DATA;
+
+    pointCount = scan_to_cartesian(nodebuffer, count, transform, x, y, quality);
+    return RESULT_OK;
+}
+
+
+bool ChannelDevice::peek(size_t size, const _u8 *& data, size_t & available, _u32 timeout)
+{
+    _u32 startTs = getms();
+    _u32 waitTime;
+
+    if (size > READ_AHEAD_SIZE) return false;
+
+    while (_readAheadEnd - _readAheadBegin < size) {
+        if ((waitTime = getms() - startTs) > timeout) return false;
+        if (!_fillReadAhead(size - (_readAheadEnd - _readAheadBegin), timeout - waitTime)) return false;
+    }
+    data = _readAheadBuf + _readAheadBegin;
+    available = _readAheadEnd - _readAheadBegin;
+    return true;
+}
+
+void ChannelDevice::consume(size_t size)
+{
+    size = min(size, _readAheadEnd - _readAheadBegin);
+    if (!size) return;
+    _readAheadBegin += size;
+
+    // the read that delivered the last consumed byte, then drop the reads consumed entirely
+    size_t pos = 0;
+    while (pos < _rxMarkCount && _rxMarks[pos].end < _readAheadBegin) ++pos;
+    if (pos < _rxMarkCount) _consumedRxUs = _rxMarks[pos].rxUs;
+    if (pos < _rxMarkCount && _rxMarks[pos].end == _readAheadBegin) ++pos;
+    if (pos) {
+        memmove(_rxMarks, _rxMarks + pos, (_rxMarkCount - pos) * sizeof(RxMark));
+        _rxMarkCount -= pos;
+    }
+}
+
+void ChannelDevice::discardBuffered()
+{
+    _readAheadBegin = _readAheadEnd = 0;
+    _rxMarkCount = 0;
+}
+
+bool ChannelDevice::_fillReadAhead(size_t minBytes, _u32 timeout)
+{
+    if (_readAheadBegin == _readAheadEnd) {
+        _readAheadBegin = _readAheadEnd = 0;
+    } else if (READ_AHEAD_SIZE - _readAheadEnd < minBytes || _readAheadBegin >= READ_AHEAD_SIZE / 2) {
+        memmove(_readAheadBuf, _readAheadBuf + _readAheadBegin, _readAheadEnd - _readAheadBegin);
+        for (size_t pos = 0; pos < _rxMarkCount; ++pos) {
+            _rxMarks[pos].end -= _readAheadBegin;
+        }
+        _readAheadEnd -= _readAheadBegin;
+        _readAheadBegin = 0;
+    }
+
+    size_t available = 0;
+    if (!waitfordata(minBytes, timeout, &available)) return false;
+
+    // take everything the device has, in one read
+    size_t room = READ_AHEAD_SIZE - _readAheadEnd;
+    if (available < minBytes) available = minBytes;
+    if (available > room) available = room;
+
+    int received = recvdata(_readAheadBuf + _readAheadEnd, available);
+    if (received <= 0) return false;
+    _u64 rxUs = getus();
+    if (_recorder) _recorder->record(STREAM_RECORD_RX, _readAheadBuf + _readAheadEnd, received);
+    _readAheadEnd += received;
+
+    // out of marks: this read absorbs the newest one, whose bytes get stamped a little late
+    if (_rxMarkCount == RX_MARKS) --_rxMarkCount;
+    _rxMarks[_rxMarkCount].end = _readAheadEnd;
+    _rxMarks[_rxMarkCount].rxUs = rxUs;
+    ++_rxMarkCount;
+    return true;
+}
 
-RPlidarDriverImplCommon::RPlidarDriverImplCommon()
+RPlidarDriverImplCommon::RPlidarDriverImplCommon(size_t maxScanNodes, _u32 options)
     : _isConnected(false)
     , _isScanning(false)
     , _isSupportingMotorCtrl(false)
+    , _max_scan_nodes(maxScanNodes)
+    , _driver_options(options)
+    , _scanPool(maxScanNodes, (options & DRIVER_OPTION_COMPACT_MEMORY) == 0, (options & DRIVER_OPTION_SCAN_ARRAYS) != 0)
 {
-    _cached_scan_node_hq_count = 0;
-    _cached_scan_node_hq_count_for_interval_retrieve = 0;
     _cached_sampleduration_std = LEGACY_SAMPLE_DURATION;
     _cached_sampleduration_express = LEGACY_SAMPLE_DURATION;
+    _cached_current_us_per_sample = 0;
+    _rx_low_water_mark = 0;
+    _decode_pipeline = false;
+    _io_cpu = -1;
+    _decode_cpu = -1;
+    _pumpFormat = NULL;
+    _pumpActive = false;
+    _lastPacketUs = 0;
+    _is_previous_capsuledataRdy = false;
+    _syncBit_is_finded = false;
+    _scanRing.resize((options & DRIVER_OPTION_COMPACT_MEMORY) ? (size_t)COMPACT_SCAN_QUEUE_DEPTH : (size_t)ScanRing::DEFAULT_DEPTH);
+    _profileValid = false;
+    _scanCommand = SCAN_COMMAND_NONE;
+    _scanForce = false;
+    _scanModeId = 0;
+    _scanOptions = 0;
+    _pauseStartUs = 0;
+    _lastScanGapUs = 0;
+    _healthBusy = false;
+    _healthCallback = NULL;
+    _healthUserData = NULL;
+    _healthTimeout = DEFAULT_TIMEOUT;
+    _scanLent = false;
+    _nextScanSeq = 0;
+    _truncatedScans = 0;
+    _nextSubscriptionId = 1;
+}
+
+RPlidarDriverImplCommon::~RPlidarDriverImplCommon()
+{
+    // a health request may still be running, even on a disconnected driver
+    _commandthread.join();
+
+    // the queued scans go back to the pool before it is destroyed
+    for (size_t pos = 0; pos < _subscriptions.size(); ++pos) {
+        delete _subscriptions[pos];
+    }
+    _subscriptions.clear();
 }
 
 bool RPlidarDriverImplCommon::isConnected()
@@ -121,6 +280,7 @@ bool RPlidarDriverImplCommon::isConnected()
 u_result RPlidarDriverImplCommon::reset(_u32 timeout)
 {
     u_result ans;
+    rp::hal::AutoLocker cl(_commandLock);
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -137,65 +297,126 @@ u_result RPlidarDriverImplCommon::clearNetSerialRxCache()
     if (!isConnected()) return RESULT_OPERATION_FAIL;
 
     _chanDev->flush();
+    _chanDev->discardBuffered();
   
     return RESULT_OK;
 }
 
+static const PacketFormat _ansHeaderFormat = {
+    sizeof(rplidar_ans_header_t),
+    { 0xFF, 0xFF },
+    { RPLIDAR_ANS_SYNC_BYTE1, RPLIDAR_ANS_SYNC_BYTE2 },
+    NULL
+};
+
 u_result RPlidarDriverImplCommon::_waitResponseHeader(rplidar_ans_header_t * header, _u32 timeout)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_ans_header_t)];
-    _u8  *headerBuffer = reinterpret_cast<_u8 *>(header);
-    _u32 waitTime;
+    const _u8 * packet;
+    u_result ans = _scanner.next(_chanDev, _ansHeaderFormat, packet, timeout);
+    if (IS_FAIL(ans)) return ans;
 
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_ans_header_t) - recvPos;
-        size_t recvSize;
-        
-        bool ans = _chanDev->waitfordata(remainSize, timeout - waitTime, &recvSize);
-        if(!ans) return RESULT_OPERATION_TIMEOUT;
-        
-        if(recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0:
-                if (currentByte != RPLIDAR_ANS_SYNC_BYTE1) {
-                   continue;
-                }
-                
-                break;
-            case 1:
-                if (currentByte != RPLIDAR_ANS_SYNC_BYTE2) {
-                    recvPos = 0;
-                    continue;
-                }
-                break;
-            }
-            headerBuffer[recvPos++] = currentByte;
+    memcpy(header, packet, sizeof(rplidar_ans_header_t));
+    return RESULT_OK;
+}
 
-            if (recvPos == sizeof(rplidar_ans_header_t)) {
-                return RESULT_OK;
-            }
-        }
+
+
+u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & healthinfo, _u32 timeout)
+{
+    _u64 gapUs;
+    return _getHealth(healthinfo, gapUs, timeout);
+}
+
+u_result RPlidarDriverImplCommon::getHealthAsync(RplidarHealthCallback callback, void * user_data, _u32 timeout)
+{
+    if (!isConnected() || !callback) return RESULT_OPERATION_FAIL;
+    bool idle = false;
+    if (!_healthBusy.compare_exchange_strong(idle, true)) return RESULT_ALREADY_DONE;
+
+    // the previous request has completed, reclaim its thread
+    _commandthread.join();
+    _commandthread = rp::hal::Thread();
+
+    _healthCallback = callback;
+    _healthUserData = user_data;
+    _healthTimeout = timeout;
+    _commandthread = CLASS_THREAD(RPlidarDriverImplCommon, _runHealthRequest);
+    if (_commandthread.getHandle() == 0) {
+        _healthBusy = false;
+        return RESULT_OPERATION_FAIL;
     }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_runHealthRequest()
+{
+    rplidar_response_device_health_t health;
+    _u64 gapUs = 0;
+
+    memset(&health, 0, sizeof(health));
+    u_result ans = _getHealth(health, gapUs, _healthTimeout);
+    _healthCallback(ans, health, gapUs, _healthUserData);
+    _healthBusy = false;
+    return ans;
+}
 
-    return RESULT_OPERATION_TIMEOUT;
+u_result RPlidarDriverImplCommon::getLastScanGap(_u64 & gapUs)
+{
+    gapUs = _lastScanGapUs;
+    return RESULT_OK;
 }
 
+u_result RPlidarDriverImplCommon::_getHealth(rplidar_response_device_health_t & healthinfo, _u64 & gapUs, _u32 timeout)
+{
+    gapUs = 0;
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
 
+    rp::hal::AutoLocker l(_commandLock);
+    bool paused = _pauseScan();
+    u_result ans = _queryHealth(healthinfo, timeout);
+    u_result restarted = _resumeScan(paused, gapUs);
+    return IS_FAIL(ans) ? ans : restarted;
+}
 
-u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & healthinfo, _u32 timeout)
+bool RPlidarDriverImplCommon::_pauseScan()
+{
+    // called under _commandLock
+    // the device answers no other request while it streams a scan
+    if (!_isScanning || _scanCommand == SCAN_COMMAND_NONE) {
+        _disableDataGrabbing();
+        return false;
+    }
+
+    _pauseStartUs = getus();
+    _stop();
+
+    // drop the measurements sent before the device took the stop
+    _drainResponses(STOP_QUIET_MS);
+    return true;
+}
+
+u_result RPlidarDriverImplCommon::_resumeScan(bool paused, _u64 & gapUs)
+{
+    gapUs = 0;
+    if (!paused) {
+        _lastScanGapUs = 0;
+        return RESULT_OK;
+    }
+
+    u_result ans;
+    if (_scanCommand == SCAN_COMMAND_NORMAL) {
+        ans = _startScanNormal(_scanForce);
+    } else {
+        ans = _startScanExpress(_scanForce, _scanModeId, _scanOptions);
+    }
+    gapUs = getus() - _pauseStartUs;
+    _lastScanGapUs = gapUs;
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::_queryHealth(rplidar_response_device_health_t & healthinfo, _u32 timeout)
 {
     u_result  ans;
-    
-    if (!isConnected()) return RESULT_OPERATION_FAIL;
-    
-    _disableDataGrabbing();
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -219,10 +440,11 @@ u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & h
             return RESULT_INVALID_DATA;
         }
 
-         if (!_chanDev->waitfordata(header_size, timeout)) {
-            return RESULT_OPERATION_TIMEOUT;
+        const _u8 * payload;
+        if (IS_FAIL(ans = _scanner.read(_chanDev, header_size, payload, timeout))) {
+            return ans;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&healthinfo), sizeof(healthinfo));
+        memcpy(&healthinfo, payload, sizeof(healthinfo));
     }
     return RESULT_OK;
 }
@@ -230,11 +452,23 @@ u_result RPlidarDriverImplCommon::getHealth(rplidar_response_device_health_t & h
 
 
 u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _getDeviceInfo(info, timeout);
+}
+
+u_result RPlidarDriverImplCommon::_getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout)
 {
     u_result  ans;
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
 
+    // the device info does not change while connected, keep the scan running
+    if (_isScanning && _profileValid) {
+        info = _profile.info;
+        return RESULT_OK;
+    }
+
     _disableDataGrabbing();
 
     {
@@ -259,10 +493,11 @@ u_result RPlidarDriverImplCommon::getDeviceInfo(rplidar_response_device_info_t &
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
-            return RESULT_OPERATION_TIMEOUT;
+        const _u8 * payload;
+        if (IS_FAIL(ans = _scanner.read(_chanDev, header_size, payload, timeout))) {
+            return ans;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&info), sizeof(info));
+        memcpy(&info, payload, sizeof(info));
         if ((info.model >> 4) > RPLIDAR_TOF_MINUM_MAJOR_ID){
             _isTofLidar = true;
         }else {
@@ -301,315 +536,114 @@ u_result RPlidarDriverImplCommon::getFrequency(const RplidarScanMode& scanMode,
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitNode(rplidar_response_measurement_node_t * node, _u32 timeout)
+// expect the sync bit and its reverse in the first byte, the check bit in the second one
+static bool _isMeasurementNodeValid(const _u8 * packet)
 {
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_measurement_node_t)];
-    _u8 *nodeBuffer = (_u8*)node;
-    _u32 waitTime;
-
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_measurement_node_t) - recvPos;
-        size_t recvSize;
-
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans) return RESULT_OPERATION_FAIL;
-
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit and its reverse in this byte
-                {
-                    _u8 tmp = (currentByte>>1);
-                    if ( (tmp ^ currentByte) & 0x1 ) {
-                        // pass
-                    } else {
-                        continue;
-                    }
-
-                }
-                break;
-            case 1: // expect the highest bit to be 1
-                {
-                    if (currentByte & RPLIDAR_RESP_MEASUREMENT_CHECKBIT) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-
-            if (recvPos == sizeof(rplidar_response_measurement_node_t)) {
-                return RESULT_OK;
-            }
-        }
-    }
-
-    return RESULT_OPERATION_TIMEOUT;
+    return (((packet[0] >> 1) ^ packet[0]) & 0x1) != 0;
 }
 
-u_result RPlidarDriverImplCommon::_waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
-{
-    if (!_isConnected) {
-        count = 0;
-        return RESULT_OPERATION_FAIL;
-    }
-
-    size_t   recvNodeCount =  0;
-    _u32     startTs = getms();
-    _u32     waitTime;
-    u_result ans;
+static const PacketFormat _measurementNodeFormat = {
+    sizeof(rplidar_response_measurement_node_t),
+    { 0x00, RPLIDAR_RESP_MEASUREMENT_CHECKBIT },
+    { 0x00, RPLIDAR_RESP_MEASUREMENT_CHECKBIT },
+    _isMeasurementNodeValid
+};
 
-    while ((waitTime = getms() - startTs) <= timeout && recvNodeCount < count) {
-        rplidar_response_measurement_node_t node;
-        if (IS_FAIL(ans = _waitNode(&node, timeout - waitTime))) {
-            return ans;
-        }
-        
-        nodebuffer[recvNodeCount++] = node;
+// only consider the capsule vaild if the checksum matches...
+template <class CapsuleT>
+static bool _isCapsuleChecksumValid(const _u8 * packet)
+{
+    const CapsuleT * node = reinterpret_cast<const CapsuleT *>(packet);
+    _u8 checksum = 0;
+    _u8 recvChecksum = ((node->s_checksum_1 & 0xF) | (node->s_checksum_2 << 4));
 
-        if (recvNodeCount == count) return RESULT_OK;
+    for (size_t cpos = offsetof(CapsuleT, start_angle_sync_q6); cpos < sizeof(CapsuleT); ++cpos) {
+        checksum ^= packet[cpos];
     }
-    count = recvNodeCount;
-    return RESULT_OPERATION_TIMEOUT;
+    return recvChecksum == checksum;
 }
 
+static const PacketFormat _capsuleFormat = {
+    sizeof(rplidar_response_capsule_measurement_nodes_t),
+    { 0xF0, 0xF0 },
+    { RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4, RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4 },
+    _isCapsuleChecksumValid<rplidar_response_capsule_measurement_nodes_t>
+};
 
-u_result RPlidarDriverImplCommon::_waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout)
-{
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-
+static const PacketFormat _ultraCapsuleFormat = {
+    sizeof(rplidar_response_ultra_capsule_measurement_nodes_t),
+    { 0xF0, 0xF0 },
+    { RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 << 4, RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2 << 4 },
+    _isCapsuleChecksumValid<rplidar_response_ultra_capsule_measurement_nodes_t>
+};
 
-   while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
-
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                        // pass
-                    } else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
+u_result RPlidarDriverImplCommon::_waitCapsuledNode(const rplidar_response_capsule_measurement_nodes_t *& node, _u32 timeout)
+{
+    const _u8 * packet;
+    bool resynced;
+    u_result ans = _nextPacket(_capsuleFormat, packet, resynced, timeout);
+    if (resynced) {
+        // the stream lost continuity, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
+    }
+    if (IS_FAIL(ans)) return ans;
 
-                }
-                break;
-            case 1: // expect the sync bit 2
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                        // pass
-                    } else {
-                        recvPos = 0;
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }
-                break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2<<4));
-                for (size_t cpos = offsetof(rplidar_response_capsule_measurement_nodes_t, start_angle_sync_q6);
-                    cpos < sizeof(rplidar_response_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
-        }
+    node = reinterpret_cast<const rplidar_response_capsule_measurement_nodes_t *>(packet);
+    if (node->start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
+        // this is the first capsule frame in logic, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitUltraCapsuledNode(const rplidar_response_ultra_capsule_measurement_nodes_t *& node, _u32 timeout)
 {
     if (!_isConnected) {
         return RESULT_OPERATION_FAIL;
     }
-    
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_ultra_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
 
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-        
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync bit 1
-                {
-                    _u8 tmp = (currentByte>>4);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_1 ) {
-                    // pass
-                    }
-                    else {
-                        _is_previous_capsuledataRdy = false;
-                        continue;
-                    }
-                }    
-            break;
-            case 1: // expect the sync bit 2
-            {
-                _u8 tmp = (currentByte>>4);
-                if (tmp == RPLIDAR_RESP_MEASUREMENT_EXP_SYNC_2) {
-                    // pass
-                }
-                else {
-                    recvPos = 0;
-                    _is_previous_capsuledataRdy = false;
-                    continue;
-                }
-            }
-            break;
-            }
-            nodeBuffer[recvPos++] = currentByte;
-            if (recvPos == sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
-                // calc the checksum ...
-                _u8 checksum = 0;
-                _u8 recvChecksum = ((node.s_checksum_1 & 0xF) | (node.s_checksum_2 << 4));
-                
-                for (size_t cpos = offsetof(rplidar_response_ultra_capsule_measurement_nodes_t, start_angle_sync_q6);
-                cpos < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t); ++cpos)
-                {
-                    checksum ^= nodeBuffer[cpos];
-                }
-                
-                if (recvChecksum == checksum)
-                {
-                    // only consider vaild if the checksum matches...
-                    if (node.start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) 
-                    {
-                        // this is the first capsule frame in logic, discard the previous cached data...
-                        _is_previous_capsuledataRdy = false;
-                        return RESULT_OK;
-                    }
-                    return RESULT_OK;
-                }
-                _is_previous_capsuledataRdy = false;
-                return RESULT_INVALID_DATA;
-            }
-        }
+    const _u8 * packet;
+    bool resynced;
+    u_result ans = _nextPacket(_ultraCapsuleFormat, packet, resynced, timeout);
+    if (resynced) {
+        // the stream lost continuity, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
     }
-    _is_previous_capsuledataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
-}
-
-u_result RPlidarDriverImplCommon::_cacheScanData()
-{
-    rplidar_response_measurement_node_t      local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitScanData(local_buf, count); // // always discard the first data since it may be incomplete
-
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitScanData(local_buf, count))) {
-            if (ans != RESULT_OPERATION_TIMEOUT) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            }
-        }
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].sync_quality & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-
-            rplidar_response_measurement_node_hq_t nodeHq;
-            convert(local_buf[pos], nodeHq);
-            local_scan[scan_count++] = nodeHq;
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
+    if (IS_FAIL(ans)) return ans;
 
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = nodeHq;
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
-        }
+    node = reinterpret_cast<const rplidar_response_ultra_capsule_measurement_nodes_t *>(packet);
+    if (node->start_angle_sync_q6 & RPLIDAR_RESP_MEASUREMENT_EXP_SYNCBIT) {
+        // this is the first capsule frame in logic, discard the previous cached data...
+        _is_previous_capsuledataRdy = false;
     }
-    _isScanning = false;
     return RESULT_OK;
 }
 
 u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _startScanNormal(force, timeout);
+}
+
+u_result RPlidarDriverImplCommon::_startScanNormal(bool force,  _u32 timeout)
 {
     u_result ans;
     if (!isConnected()) return RESULT_OPERATION_FAIL;
     if (_isScanning) return RESULT_ALREADY_DONE;
 
-    stop(); //force the previous operation to stop
+    _stop(); //force the previous operation to stop
+
+    // devices without the configuration commands get scan buffers of the full capacity
+    float usPerSample = 0;
+    bool ifSupportLidarConf = false;
+    if (IS_OK(_checkSupportConfigCommands(ifSupportLidarConf)) && ifSupportLidarConf) {
+        const RplidarScanMode * usedMode = _findScanMode(RPLIDAR_CONF_SCAN_COMMAND_STD);
+        if (usedMode) usPerSample = usedMode->us_per_sample;
+    }
+
+    // remembered to restart the scan after a query, see _pauseScan
+    _scanCommand = SCAN_COMMAND_NORMAL;
+    _scanForce = force;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -634,11 +668,15 @@ u_result RPlidarDriverImplCommon::startScanNormal(bool force,  _u32 timeout)
             return RESULT_INVALID_DATA;
         }
 
+        _applyRxLowWaterMark(sizeof(rplidar_response_measurement_node_t));
+        _sizeScanBuffers(usPerSample);
         _isScanning = true;
-        _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheScanData);
+        _startPacketPump(_measurementNodeFormat);
+        _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _ingestScanData<NormalNodePolicy>);
         if (_cachethread.getHandle() == 0) {
             return RESULT_OPERATION_FAIL;
         }
+        if (_decode_cpu >= 0) _cachethread.setAffinity(_decode_cpu);
     }
     return RESULT_OK;
 }
@@ -696,146 +734,26 @@ int RPlidarDriverImplCommon::_getSyncBitByAngle(const int current_angle_q16, con
     return syncBit;
 }
 
-u_result RPlidarDriverImplCommon::_cacheCapsuledScanData()
+void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
 {
-    rplidar_response_capsule_measurement_nodes_t    capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[512];
-    size_t                                   count = 512;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitCapsuledNode(capsule_node); // // always discard the first data since it may be incomplete
-    
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitCapsuledNode(capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
-        }
-        switch (_cached_express_flag) 
-        {
-        case 0:
-            _capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        case 1:
-            _dense_capsuleToNormal(capsule_node, local_buf, count);
-            break;
-        }
-        //
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
+    nodeCount = 0;
+    if (_is_previous_capsuledataRdy) {
+        int diffAngle_q8;
+        int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF)<< 2);
+        int prevStartAngle_q8 = ((_cached_previous_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
 
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
-        }
-    }
-    _isScanning = false;
-
-    return RESULT_OK;
-}
-
-u_result RPlidarDriverImplCommon::_cacheUltraCapsuledScanData()
-{
-    rplidar_response_ultra_capsule_measurement_nodes_t    ultra_capsule_node;
-    rplidar_response_measurement_node_hq_t   local_buf[512];
-    size_t                                   count = 512;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    size_t                                   last_scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-
-    _waitUltraCapsuledNode(ultra_capsule_node);
-    
-    while(_isScanning)
-    {
-        if (IS_FAIL(ans=_waitUltraCapsuledNode(ultra_capsule_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            } else {
-                // current data is invalid, do not use it.
-                continue;
-            }
-        }
-        
-        _ultraCapsuleToNormal(ultra_capsule_node, local_buf, count);
-        
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-                // only publish the data when it contains a full 360 degree scan 
-                
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count*sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count-=1; // prevent overflow
-
-            //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if(_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve-=1; // prevent overflow
-            }
-        }
-    }
-    
-    _isScanning = false;
-
-    return RESULT_OK;
-}
-
-void     RPlidarDriverImplCommon::_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount)
-{
-    nodeCount = 0;
-    if (_is_previous_capsuledataRdy) {
-        int diffAngle_q8;
-        int currentStartAngle_q8 = ((capsule.start_angle_sync_q6 & 0x7FFF)<< 2);
-        int prevStartAngle_q8 = ((_cached_previous_capsuledata.start_angle_sync_q6 & 0x7FFF) << 2);
-
-        diffAngle_q8 = (currentStartAngle_q8) - (prevStartAngle_q8);
-        if (prevStartAngle_q8 >  currentStartAngle_q8) {
-            diffAngle_q8 += (360<<8);
+        diffAngle_q8 = (currentStartAngle_q8) - (prevStartAngle_q8);
+        if (prevStartAngle_q8 >  currentStartAngle_q8) {
+            diffAngle_q8 += (360<<8);
         }
 
         int angleInc_q16 = (diffAngle_q8 << 3);
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_capsuledata.cabins); ++pos)
+
+        bool decoded = decode_express_capsule_simd(_cached_previous_capsuledata, currentAngle_raw_q16, angleInc_q16, _syncBit_is_finded, nodebuffer);
+        if (decoded) nodeCount = EXPRESS_CAPSULE_SAMPLES;
+
+        for (size_t pos = 0; !decoded && pos < _countof(_cached_previous_capsuledata.cabins); ++pos)
         {
             int dist_q2[2];
             int angle_q16[2];
@@ -895,7 +813,11 @@ void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_
 
         int angleInc_q16 = (diffAngle_q8 << 8)/40;
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos)
+
+        bool decoded = decode_dense_capsule_simd(_cached_previous_dense_capsuledata, currentAngle_raw_q16, angleInc_q16, _syncBit_is_finded, nodebuffer);
+        if (decoded) nodeCount = DENSE_CAPSULE_SAMPLES;
+
+        for (size_t pos = 0; !decoded && pos < _countof(_cached_previous_dense_capsuledata.cabins); ++pos)
         {
             int dist_q2;
             int angle_q6;
@@ -928,198 +850,37 @@ void     RPlidarDriverImplCommon::_dense_capsuleToNormal(const rplidar_response_
     _is_previous_capsuledataRdy = true;
 }
 
-u_result RPlidarDriverImplCommon::_cacheHqScanData()
-{
-    rplidar_response_hq_capsule_measurement_nodes_t    hq_node;
-    rplidar_response_measurement_node_hq_t   local_buf[128];
-    size_t                                   count = 128;
-    rplidar_response_measurement_node_hq_t   local_scan[MAX_SCAN_NODES];
-    size_t                                   scan_count = 0;
-    u_result                                 ans;
-    memset(local_scan, 0, sizeof(local_scan));
-    _waitHqNode(hq_node);
-    while (_isScanning) {
-        if (IS_FAIL(ans = _waitHqNode(hq_node))) {
-            if (ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
-                _isScanning = false;
-                return RESULT_OPERATION_FAIL;
-            }
-            else {
-				// current data is invalid, do not use it.
-				continue;
-            }
-        }
-
-        _HqToNormal(hq_node, local_buf, count);
-        for (size_t pos = 0; pos < count; ++pos)
-        {
-            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
-            {
-				// only publish the data when it contains a full 360 degree scan 
-                if ((local_scan[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
-                    _lock.lock();
-                    memcpy(_cached_scan_node_hq_buf, local_scan, scan_count * sizeof(rplidar_response_measurement_node_hq_t));
-                    _cached_scan_node_hq_count = scan_count;
-                    _dataEvt.set();
-                    _lock.unlock();
-                }
-                scan_count = 0;
-            }
-            local_scan[scan_count++] = local_buf[pos];
-            if (scan_count == _countof(local_scan)) scan_count -= 1; // prevent overflow
-																	 //for interval retrieve
-            {
-                rp::hal::AutoLocker l(_lock);
-                _cached_scan_node_hq_buf_for_interval_retrieve[_cached_scan_node_hq_count_for_interval_retrieve++] = local_buf[pos];
-                if (_cached_scan_node_hq_count_for_interval_retrieve == _countof(_cached_scan_node_hq_buf_for_interval_retrieve)) _cached_scan_node_hq_count_for_interval_retrieve -= 1; // prevent overflow
-            }
-        }
-
-    }
-    return RESULT_OK;
-}
-
-//CRC calculate
-static _u32 table[256];//crc32_table
-
-//reflect
-static _u32 _bitrev(_u32 input, _u16 bw)
-{
-    _u16 i;
-    _u32 var;
-    var = 0;
-    for (i = 0; i<bw; i++){
-        if (input & 0x01)
-        {
-            var |= 1 << (bw - 1 - i);
-        }
-        input >>= 1;
-    }
-    return var;
-}
-
-// crc32_table init
-static void _crc32_init(_u32 poly)
-{
-    _u16 i;
-    _u16 j;
-    _u32 c;
-    
-    poly = _bitrev(poly, 32);
-    for (i = 0; i<256; i++){
-        c = i;
-        for (j = 0; j<8; j++){
-            if (c & 1)
-                c = poly ^ (c >> 1);
-            else
-                c = c >> 1;
-        }
-        table[i] = c;
-    }
-}
-
-static _u32 _crc32cal(_u32 crc, void* input, _u16 len)
+static bool _isHqCapsuleCrcValid(const _u8 * packet)
 {
-    _u16 i;
-    _u8 index;
-    _u8* pch;
-    pch = (unsigned char*)input;
-    _u8 leftBytes = 4 - len & 0x3;
-
-    for (i = 0; i<len; i++){
-        index = (unsigned char)(crc^*pch);
-        crc = (crc >> 8) ^ table[index];
-        pch++;
-    }
-
-    for (i = 0; i < leftBytes; i++) {//zero padding
-        index = (unsigned char)(crc^0);
-        crc = (crc >> 8) ^ table[index];
-    }
-    return crc^0xffffffff;
+    const rplidar_response_hq_capsule_measurement_nodes_t * node = reinterpret_cast<const rplidar_response_hq_capsule_measurement_nodes_t *>(packet);
+    _u32 crcCalc2 = crc32_hq(packet, sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 4);
+    return crcCalc2 == node->crc32;
 }
 
-//crc32cal
-static u_result _crc32(_u8 *ptr, _u32 len) {
-	static _u8 tmp;
-	if (tmp != 1) {
-		_crc32_init(0x4C11DB7);
-		tmp = 1;
-	}
-	
-	return _crc32cal(0xFFFFFFFF, ptr,len);
-}
+static const PacketFormat _hqCapsuleFormat = {
+    sizeof(rplidar_response_hq_capsule_measurement_nodes_t),
+    { 0xFF, 0x00 },
+    { RPLIDAR_RESP_MEASUREMENT_HQ_SYNC, 0x00 },
+    _isHqCapsuleCrcValid
+};
 
-u_result RPlidarDriverImplCommon::_waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout)
+u_result RPlidarDriverImplCommon::_waitHqNode(const rplidar_response_hq_capsule_measurement_nodes_t *& node, _u32 timeout)
 {
     if (!_isConnected) {
         return RESULT_OPERATION_FAIL;
     }
 
-    int  recvPos = 0;
-    _u32 startTs = getms();
-    _u8  recvBuffer[sizeof(rplidar_response_hq_capsule_measurement_nodes_t)];
-    _u8 *nodeBuffer = (_u8*)&node;
-    _u32 waitTime;
-    
-    while ((waitTime=getms() - startTs) <= timeout) {
-        size_t remainSize = sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - recvPos;
-        size_t recvSize;
-        
-        bool ans = _chanDev->waitfordata(remainSize, timeout-waitTime, &recvSize);
-        if(!ans)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        if (recvSize > remainSize) recvSize = remainSize;
-        
-        recvSize = _chanDev->recvdata(recvBuffer, recvSize);
-    
-        for (size_t pos = 0; pos < recvSize; ++pos) {
-            _u8 currentByte = recvBuffer[pos];
-            switch (recvPos) {
-            case 0: // expect the sync byte
-                {
-                    _u8 tmp = (currentByte);
-                    if ( tmp == RPLIDAR_RESP_MEASUREMENT_HQ_SYNC ) {
-                    // pass
-                    }
-                    else {
-                        recvPos = 0;
-                        _is_previous_HqdataRdy = false;
-                        continue;
-                    }
-                }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1 - 4: 
-            {
-
-            }
-           break;
-           case sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 1: 
-            {				
-
-            }
-           break;
-           }
-           nodeBuffer[recvPos++] = currentByte;
-           if (recvPos == sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
-                _u32 crcCalc2 = _crc32(nodeBuffer, sizeof(rplidar_response_hq_capsule_measurement_nodes_t) - 4);
-
-                if(crcCalc2 == node.crc32){
-                    _is_previous_HqdataRdy = true;
-                    return RESULT_OK;
-                }
-                else {
-                    _is_previous_HqdataRdy = false;
-                    return RESULT_INVALID_DATA;
-                }
-
-            }
-        }
+    const _u8 * packet;
+    bool resynced;
+    u_result ans = _nextPacket(_hqCapsuleFormat, packet, resynced, timeout);
+    if (IS_FAIL(ans)) {
+        _is_previous_HqdataRdy = false;
+        return ans;
     }
-    _is_previous_HqdataRdy = false;
-    return RESULT_OPERATION_TIMEOUT;
+
+    node = reinterpret_cast<const rplidar_response_hq_capsule_measurement_nodes_t *>(packet);
+    _is_previous_HqdataRdy = true;
+    return RESULT_OK;
 }
 
 void RPlidarDriverImplCommon::_HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount) 
@@ -1189,7 +950,23 @@ void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra
 
         int angleInc_q16 = (diffAngle_q8 << 3) / 3;
         int currentAngle_raw_q16 = (prevStartAngle_q8 << 8);
-        for (size_t pos = 0; pos < _countof(_cached_previous_ultracapsuledata.ultra_cabins); ++pos)
+
+        const _s32 * angleCorrection = ultra_angle_correction_table();
+
+        // take the vectorized path when the angles stay within its valid range
+        bool decoded = false;
+        if (angleInc_q16 > 0 && (_s64)currentAngle_raw_q16 + (ULTRA_CAPSULE_SAMPLES + 1) * (_s64)angleInc_q16 < (720 << 16)) {
+            _u32 combined_x3[ULTRA_CAPSULE_CABINS + 1];
+            for (size_t pos = 0; pos < ULTRA_CAPSULE_CABINS; ++pos) {
+                combined_x3[pos] = _cached_previous_ultracapsuledata.ultra_cabins[pos].combined_x3;
+            }
+            combined_x3[ULTRA_CAPSULE_CABINS] = capsule.ultra_cabins[0].combined_x3;
+
+            decoded = decode_ultra_capsule_simd(combined_x3, currentAngle_raw_q16, angleInc_q16, _syncBit_is_finded, nodebuffer);
+            if (decoded) nodeCount = ULTRA_CAPSULE_SAMPLES;
+        }
+
+        for (size_t pos = 0; !decoded && pos < _countof(_cached_previous_ultracapsuledata.ultra_cabins); ++pos)
         {
             int dist_q2[3];
             int angle_q6[3];
@@ -1209,7 +986,7 @@ void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra
 
             int dist_major2;
 
-            _u32 scalelvl1, scalelvl2;
+            _u32 scalelvl1 = 0, scalelvl2 = 0;
 
             // prefetch next ...
             if (pos == _countof(_cached_previous_ultracapsuledata.ultra_cabins) - 1)
@@ -1253,20 +1030,9 @@ void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra
 
             for (int cpos = 0; cpos < 3; ++cpos)
             {
-                int syncBit_check_threshold = (int)((3 << 16) / angleInc_q16)+1;//find syncBit in 0~1 degree
                 syncBit[cpos] = _getSyncBitByAngle(currentAngle_raw_q16, angleInc_q16);
 
-                int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
-
-                if (dist_q2[cpos] >= (50 * 4))
-                {
-                    const int k1 = 98361;
-                    const int k2 = int(k1 / dist_q2[cpos]);
-
-                    offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
-                }
-
-                angle_q6[cpos] = ((currentAngle_raw_q16 - int(offsetAngleMean_q16 * 180 / 3.14159265)) >> 10);
+                angle_q6[cpos] = ((currentAngle_raw_q16 - ultra_angle_correction_q16(angleCorrection, dist_q2[cpos])) >> 10);
                 currentAngle_raw_q16 += angleInc_q16;
 
                 if (angle_q6[cpos] < 0) angle_q6[cpos] += (360 << 6);
@@ -1288,277 +1054,617 @@ void RPlidarDriverImplCommon::_ultraCapsuleToNormal(const rplidar_response_ultra
     _is_previous_capsuledataRdy = true;
 }
 
-u_result RPlidarDriverImplCommon::checkSupportConfigCommands(bool& outSupport, _u32 timeoutInMs)
-{
-    u_result ans;
-
-    rplidar_response_device_info_t devinfo;
-    ans = getDeviceInfo(devinfo, timeoutInMs);
-    if (IS_FAIL(ans)) return ans;
-
-    // if lidar firmware >= 1.24
-    if (devinfo.firmware_version >= ((0x1 << 8) | 24)) {
-        outSupport = true;
-    }
-    return ans;
-}
+// Ingestion policies, the compile-time description of one answer type for
+// _ingestScanData(): how to wait for and decode a packet, and how to stamp it.
+//  PACKETS_PER_BATCH     packets decoded per pass of the loop
+//  NODES_PER_PACKET      upper bound of the samples decoded from one packet
+//  DECODES_PREVIOUS      the decoder emits the samples of the previous packet
+//  HAS_DEVICE_TIMESTAMP  the packet carries the device clock (deviceTimestamp())
+// The decoders are called non-virtually, so each instantiation gets them inlined.
 
-u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outputBuf, const std::vector<_u8> &reserve, _u32 timeout)
+struct RPlidarDriverImplCommon::NormalNodePolicy
 {
-    rplidar_payload_get_scan_conf_t query;
-    memset(&query, 0, sizeof(query));
-    query.type = type;
-    int sizeVec = reserve.size();
-
-    int maxLen = sizeof(query.reserved) / sizeof(query.reserved[0]);
-    if (sizeVec > maxLen) sizeVec = maxLen;
+    typedef rplidar_response_measurement_node_t packet_t;
+    enum {
+        PACKETS_PER_BATCH    = 128,
+        NODES_PER_PACKET     = 1,
+        DECODES_PREVIOUS     = 0,
+        HAS_DEVICE_TIMESTAMP = 0,
+    };
 
-    if (sizeVec > 0)
-        memcpy(query.reserved, &reserve[0], reserve.size());
+    static float sampleDuration(const RPlidarDriverImplCommon & drv) { return drv._cached_sampleduration_std; }
 
-    u_result ans;
+    static u_result wait(RPlidarDriverImplCommon & drv, const packet_t *& packet)
     {
-        rp::hal::AutoLocker l(_lock);
-        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_GET_LIDAR_CONF, &query, sizeof(query)))) {
-            return ans;
-        }
-
-        // waiting for confirmation
-        rplidar_ans_header_t response_header;
-        if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
-            return ans;
-        }
+        if (!drv._isConnected) return RESULT_OPERATION_FAIL;
 
-        // verify whether we got a correct header
-        if (response_header.type != RPLIDAR_ANS_TYPE_GET_LIDAR_CONF) {
-            return RESULT_INVALID_DATA;
-        }
+        const _u8 * raw;
+        bool resynced;
+        u_result ans = drv._nextPacket(_measurementNodeFormat, raw, resynced, DEFAULT_TIMEOUT);
+        if (IS_OK(ans)) packet = reinterpret_cast<const packet_t *>(raw);
+        return ans;
+    }
 
-        _u32 header_size = (response_header.size_q30_subtype & RPLIDAR_ANS_HEADER_SIZE_MASK);
-        if (header_size < sizeof(type)) {
-            return RESULT_INVALID_DATA;
-        }
+    static size_t decode(RPlidarDriverImplCommon &, const packet_t & packet, rplidar_response_measurement_node_hq_t * nodes)
+    {
+        convert(packet, nodes[0]);
+        return 1;
+    }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
-            return RESULT_OPERATION_TIMEOUT;
-        }
+    static _u64 deviceTimestamp(const packet_t &) { return 0; }
+};
 
-        std::vector<_u8> dataBuf;
-        dataBuf.resize(header_size);
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&dataBuf[0]), header_size);
+struct RPlidarDriverImplCommon::CapsulePolicy
+{
+    typedef rplidar_response_capsule_measurement_nodes_t packet_t;
+    enum {
+        PACKETS_PER_BATCH    = 1,
+        NODES_PER_PACKET     = EXPRESS_CAPSULE_SAMPLES,
+        DECODES_PREVIOUS     = 1,
+        HAS_DEVICE_TIMESTAMP = 0,
+    };
 
-        //check if returned type is same as asked type
-        _u32 replyType = -1;
-        memcpy(&replyType, &dataBuf[0], sizeof(type));
-        if (replyType != type) {
-            return RESULT_INVALID_DATA;
-        }
+    static float sampleDuration(const RPlidarDriverImplCommon & drv) { return drv._cached_current_us_per_sample; }
 
-        //copy all the payload into &outputBuf
-        int payLoadLen = header_size - sizeof(type);
+    static u_result wait(RPlidarDriverImplCommon & drv, const packet_t *& packet)
+    {
+        return drv._waitCapsuledNode(packet);
+    }
 
-        //do consistency check
-        if (payLoadLen <= 0) {
-            return RESULT_INVALID_DATA;
-        }
-        //copy all payLoadLen bytes to outputBuf
-        outputBuf.resize(payLoadLen);
-        memcpy(&outputBuf[0], &dataBuf[0] + sizeof(type), payLoadLen);
+    static size_t decode(RPlidarDriverImplCommon & drv, const packet_t & packet, rplidar_response_measurement_node_hq_t * nodes)
+    {
+        size_t count;
+        drv._capsuleToNormal(packet, nodes, count);
+        return count;
     }
-    return ans;
-}
 
-u_result RPlidarDriverImplCommon::getTypicalScanMode(_u16& outMode, _u32 timeoutInMs)
-{
-    u_result ans;
-    std::vector<_u8> answer;
-    bool lidarSupportConfigCmds = false;
-    ans = checkSupportConfigCommands(lidarSupportConfigCmds);
-    if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
+    static _u64 deviceTimestamp(const packet_t &) { return 0; }
+};
 
-    if (lidarSupportConfigCmds)
-    {
-        ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_TYPICAL, answer, std::vector<_u8>(), timeoutInMs);
-        if (IS_FAIL(ans)) {
-            return ans;
-        }
-        if (answer.size() < sizeof(_u16)) {
-            return RESULT_INVALID_DATA;
-        }
+// dense capsules share the framing of the express capsules
+struct RPlidarDriverImplCommon::DenseCapsulePolicy : public RPlidarDriverImplCommon::CapsulePolicy
+{
+    enum {
+        NODES_PER_PACKET     = DENSE_CAPSULE_SAMPLES,
+    };
 
-        const _u16 *p_answer = reinterpret_cast<const _u16*>(&answer[0]);
-        outMode = *p_answer;
-        return ans;
-    }
-    //old version of triangle lidar
-    else
+    static size_t decode(RPlidarDriverImplCommon & drv, const packet_t & packet, rplidar_response_measurement_node_hq_t * nodes)
     {
-        outMode = RPLIDAR_CONF_SCAN_COMMAND_EXPRESS;
-        return ans;
+        size_t count;
+        drv._dense_capsuleToNormal(packet, nodes, count);
+        return count;
     }
-    return ans;
-}
+};
 
-u_result RPlidarDriverImplCommon::getLidarSampleDuration(float& sampleDurationRes, _u16 scanModeID, _u32 timeoutInMs)
+struct RPlidarDriverImplCommon::UltraCapsulePolicy
 {
-    u_result ans;
-    std::vector<_u8> reserve(2);
-    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+    typedef rplidar_response_ultra_capsule_measurement_nodes_t packet_t;
+    enum {
+        PACKETS_PER_BATCH    = 1,
+        NODES_PER_PACKET     = ULTRA_CAPSULE_SAMPLES,
+        DECODES_PREVIOUS     = 1,
+        HAS_DEVICE_TIMESTAMP = 0,
+    };
 
-    std::vector<_u8> answer;
-    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE, answer, reserve, timeoutInMs);
-    if (IS_FAIL(ans))
+    static float sampleDuration(const RPlidarDriverImplCommon & drv) { return drv._cached_current_us_per_sample; }
+
+    static u_result wait(RPlidarDriverImplCommon & drv, const packet_t *& packet)
     {
-        return ans;
+        return drv._waitUltraCapsuledNode(packet);
     }
-    if (answer.size() < sizeof(_u32))
+
+    static size_t decode(RPlidarDriverImplCommon & drv, const packet_t & packet, rplidar_response_measurement_node_hq_t * nodes)
     {
-        return RESULT_INVALID_DATA;
+        size_t count;
+        drv._ultraCapsuleToNormal(packet, nodes, count);
+        return count;
     }
-    const _u32 *result = reinterpret_cast<const _u32*>(&answer[0]);
-    sampleDurationRes = (float)(*result >> 8);
-    _cached_current_us_per_sample = sampleDurationRes;
-    return ans;
-}
 
-u_result RPlidarDriverImplCommon::getMaxDistance(float &maxDistance, _u16 scanModeID, _u32 timeoutInMs)
+    static _u64 deviceTimestamp(const packet_t &) { return 0; }
+};
+
+struct RPlidarDriverImplCommon::HqCapsulePolicy
 {
-    u_result ans;
-    std::vector<_u8> reserve(2);
-    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+    typedef rplidar_response_hq_capsule_measurement_nodes_t packet_t;
+    enum {
+        PACKETS_PER_BATCH    = 1,
+        NODES_PER_PACKET     = sizeof(((packet_t *)0)->node_hq) / sizeof(rplidar_response_measurement_node_hq_t),
+        DECODES_PREVIOUS     = 0,
+        HAS_DEVICE_TIMESTAMP = 1,
+    };
 
-    std::vector<_u8> answer;
-    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE, answer, reserve, timeoutInMs);
-    if (IS_FAIL(ans))
+    static float sampleDuration(const RPlidarDriverImplCommon & drv) { return drv._cached_current_us_per_sample; }
+
+    static u_result wait(RPlidarDriverImplCommon & drv, const packet_t *& packet)
     {
-        return ans;
+        return drv._waitHqNode(packet);
     }
-    if (answer.size() < sizeof(_u32))
+
+    static size_t decode(RPlidarDriverImplCommon & drv, const packet_t & packet, rplidar_response_measurement_node_hq_t * nodes)
     {
-        return RESULT_INVALID_DATA;
+        size_t count;
+        drv._HqToNormal(packet, nodes, count);
+        return count;
     }
-    const _u32 *result = reinterpret_cast<const _u32*>(&answer[0]);
-    maxDistance = (float)(*result >> 8);
-    return ans;
-}
 
-u_result RPlidarDriverImplCommon::getScanModeAnsType(_u8 &ansType, _u16 scanModeID, _u32 timeoutInMs)
+    // stamp the samples from the device clock, the arrival times jitter with the transfer
+    static _u64 deviceTimestamp(const packet_t & packet) { return packet.time_stamp; }
+};
+
+template <class Policy>
+u_result RPlidarDriverImplCommon::_ingestScanData()
 {
-    u_result ans;
-    std::vector<_u8> reserve(2);
-    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+    typedef typename Policy::packet_t packet_t;
+    enum {
+        BATCH_NODES = Policy::PACKETS_PER_BATCH * Policy::NODES_PER_PACKET,
+    };
 
-    std::vector<_u8> answer;
-    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_ANS_TYPE, answer, reserve, timeoutInMs);
-    if (IS_FAIL(ans))
-    {
-        return ans;
-    }
-    if (answer.size() < sizeof(_u8))
-    {
-        return RESULT_INVALID_DATA;
+    const packet_t *                         packet = NULL;
+    rplidar_response_measurement_node_hq_t   local_buf[BATCH_NODES];
+    _u64                                     local_buf_ts[BATCH_NODES];
+    PooledScan *                             scan = _scanPool.acquire();
+    rplidar_response_measurement_node_hq_t * scan_nodes = scan->writeNodes();
+    _u64 *                                   scan_ts = scan->writeTimestamps();
+    const size_t                             scan_capacity = scan->capacity();
+    ScanTiming                               scan_timing = { 0 };
+    size_t                                   scan_count = 0;
+    SampleTimestamper                        timestamper;
+    DeviceClockSync                          deviceClock;
+    const float                              nominal_us = Policy::sampleDuration(*this);
+    u_result                                 ans = RESULT_OK;
+
+    // compact scans keep no per-sample timestamps, see grabScanDataHq
+    timestamper.reset(nominal_us);
+    _resetSpin();
+    // always discard the first data since it may be incomplete
+    for (size_t received = 0; received < Policy::PACKETS_PER_BATCH; ++received) {
+        if (IS_FAIL(Policy::wait(*this, packet))) break;
     }
-    const _u8 *result = reinterpret_cast<const _u8*>(&answer[0]);
-    ansType = *result;
-    return ans;
-}
+    _u64 previous_us = _lastPacketUs;
 
-u_result RPlidarDriverImplCommon::getScanModeName(char* modeName, _u16 scanModeID, _u32 timeoutInMs)
+    while(_isScanning)
+    {
+        size_t received = 0;
+        size_t count = 0;
+        for (; received < Policy::PACKETS_PER_BATCH; ++received) {
+            if (IS_FAIL(ans = Policy::wait(*this, packet))) break;
+            count += Policy::decode(*this, *packet, local_buf + count);
+        }
+        if (IS_FAIL(ans) && ans != RESULT_OPERATION_TIMEOUT && ans != RESULT_INVALID_DATA) {
+            _isScanning = false;
+            scan->release();
+            return RESULT_OPERATION_FAIL;
+        }
+        if (!received) {
+            // current data is invalid, do not use it.
+            continue;
+        }
+
+        // a decoder working one packet behind emits the samples received at the previous packet
+        _u64 packet_us = Policy::DECODES_PREVIOUS ? previous_us : _lastPacketUs;
+        previous_us = _lastPacketUs;
+        _u64 device_ts = Policy::HAS_DEVICE_TIMESTAMP ? Policy::deviceTimestamp(*packet) : 0;
+        if (scan_ts) {
+            timestamper.stamp(Policy::HAS_DEVICE_TIMESTAMP ? deviceClock.update(device_ts, packet_us) : packet_us, count, local_buf_ts);
+        }
+
+        for (size_t pos = 0; pos < count; ++pos)
+        {
+            if (local_buf[pos].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)
+            {
+                // only publish the data when it contains a full 360 degree scan 
+                
+                if (scan_count && (scan_nodes[0].flag & RPLIDAR_RESP_MEASUREMENT_SYNCBIT)) {
+                    _updateSpin(scan_count <= scan_capacity ? scan_count : 0, nominal_us > 0 ? nominal_us : timestamper.usPerSample(), scan_timing);
+                    scan = _publishScan(scan, scan_count, scan_timing);
+                    scan_nodes = scan->writeNodes();
+                    scan_ts = scan->writeTimestamps();
+                }
+                scan_count = 0;
+            }
+            if (!scan_count) {
+                scan_timing.firstPacketUs = packet_us;
+                scan_timing.firstDeviceTs = device_ts;
+            }
+            scan_timing.lastPacketUs = packet_us;
+            scan_timing.lastDeviceTs = device_ts;
+            // a scan longer than the buffer keeps its first samples, see _publishScan
+            if (scan_count < scan_capacity) {
+                if (scan_ts) scan_ts[scan_count] = local_buf_ts[pos];
+                scan_nodes[scan_count] = local_buf[pos];
+            }
+            ++scan_count;
+        }
+        _intervalRing.push(local_buf, count);
+    }
+    _isScanning = false;
+
+    scan->release();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::checkSupportConfigCommands(bool& outSupport, _u32 timeoutInMs)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _checkSupportConfigCommands(outSupport, timeoutInMs);
+}
+
+u_result RPlidarDriverImplCommon::_checkSupportConfigCommands(bool& outSupport, _u32 timeoutInMs)
+{
+    if (!_profileValid) {
+        u_result ans = _loadDeviceProfile(timeoutInMs);
+        if (IS_FAIL(ans)) return ans;
+    }
+
+    // if lidar firmware >= 1.24
+    if (_profile.conf_supported) {
+        outSupport = true;
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_sendConfQuery(_u32 type, const void * reserve, size_t reserveSize)
+{
+    rplidar_payload_get_scan_conf_t query;
+    memset(&query, 0, sizeof(query));
+    query.type = type;
+
+    if (reserveSize > sizeof(query.reserved)) reserveSize = sizeof(query.reserved);
+    if (reserveSize > 0)
+        memcpy(query.reserved, reserve, reserveSize);
+
+    return _sendCommand(RPLIDAR_CMD_GET_LIDAR_CONF, &query, sizeof(query));
+}
+
+u_result RPlidarDriverImplCommon::_readConfAnswer(_u32 type, const _u8 *& payload, size_t & size, _u32 timeout)
 {
     u_result ans;
-    std::vector<_u8> reserve(2);
-    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
 
-    std::vector<_u8> answer;
-    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_NAME, answer, reserve, timeoutInMs);
-    if (IS_FAIL(ans))
-    {
+    // waiting for confirmation
+    rplidar_ans_header_t response_header;
+    if (IS_FAIL(ans = _waitResponseHeader(&response_header, timeout))) {
         return ans;
     }
-    int len = answer.size();
-    if (0 == len) return RESULT_INVALID_DATA;
-    memcpy(modeName, &answer[0], len);
-    return ans;
+
+    // verify whether we got a correct header
+    if (response_header.type != RPLIDAR_ANS_TYPE_GET_LIDAR_CONF) {
+        return RESULT_INVALID_DATA;
+    }
+
+    _u32 header_size = (response_header.size_q30_subtype & RPLIDAR_ANS_HEADER_SIZE_MASK);
+    //do consistency check, the answer carries at least one byte after its type
+    if (header_size <= sizeof(type)) {
+        return RESULT_INVALID_DATA;
+    }
+
+    if (IS_FAIL(ans = _scanner.read(_chanDev, header_size, payload, timeout))) {
+        return ans;
+    }
+
+    //check if returned type is same as asked type
+    _u32 replyType;
+    memcpy(&replyType, payload, sizeof(type));
+    if (replyType != type) {
+        return RESULT_INVALID_DATA;
+    }
+
+    payload += sizeof(type);
+    size = header_size - sizeof(type);
+    return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::getAllSupportedScanModes(std::vector<RplidarScanMode>& outModes, _u32 timeoutInMs)
+u_result RPlidarDriverImplCommon::getLidarConf(_u32 type, std::vector<_u8> &outputBuf, const std::vector<_u8> &reserve, _u32 timeout)
 {
     u_result ans;
-    bool confProtocolSupported = false;
-    ans = checkSupportConfigCommands(confProtocolSupported);
-    if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
-
-    if (confProtocolSupported)
+    rp::hal::AutoLocker cl(_commandLock);
     {
-        // 1. get scan mode count
-        _u16 modeCount;
-        ans = getScanModeCount(modeCount);
-        if (IS_FAIL(ans))
-        {
-            return RESULT_INVALID_DATA;
+        rp::hal::AutoLocker l(_lock);
+        if (IS_FAIL(ans = _sendConfQuery(type, reserve.empty() ? NULL : &reserve[0], reserve.size()))) {
+            return ans;
         }
-        // 2. for loop to get all fields of each scan mode
-        for (_u16 i = 0; i < modeCount; i++)
-        {
-            RplidarScanMode scanModeInfoTmp;
-            memset(&scanModeInfoTmp, 0, sizeof(scanModeInfoTmp));
-            scanModeInfoTmp.id = i;
-            ans = getLidarSampleDuration(scanModeInfoTmp.us_per_sample, i);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-            ans = getMaxDistance(scanModeInfoTmp.max_distance, i);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-            ans = getScanModeAnsType(scanModeInfoTmp.ans_type, i);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-            ans = getScanModeName(scanModeInfoTmp.scan_mode, i);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-            outModes.push_back(scanModeInfoTmp);
+
+        const _u8 * payload;
+        size_t size;
+        if (IS_FAIL(ans = _readConfAnswer(type, payload, size, timeout))) {
+            return ans;
         }
-        return ans;
+        //copy all the payload into &outputBuf
+        outputBuf.assign(payload, payload + size);
     }
-    else
-    {
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::getTypicalScanMode(_u16& outMode, _u32 timeoutInMs)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    if (!_profileValid) {
+        u_result ans = _loadDeviceProfile(timeoutInMs);
+        if (IS_FAIL(ans)) return ans;
+    }
+
+    // RPLIDAR_CONF_SCAN_COMMAND_EXPRESS for the old version of triangle lidar
+    outMode = _profile.typical_mode;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::getDeviceProfile(RplidarDeviceProfile & profile, _u32 timeoutInMs)
+{
+    if (!isConnected()) return RESULT_OPERATION_FAIL;
+
+    rp::hal::AutoLocker l(_commandLock);
+    if (!_profileValid) {
+        u_result ans = _loadDeviceProfile(timeoutInMs);
+        if (IS_FAIL(ans)) return ans;
+    }
+    profile = _profile;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setDeviceProfileCacheDir(const char * path)
+{
+    _profileCacheDir = path ? path : "";
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::_loadDeviceProfile(_u32 timeout)
+{
+    RplidarDeviceProfile profile;
+    u_result ans = _getDeviceInfo(profile.info, timeout);
+    if (IS_FAIL(ans)) return ans;
+
+    // if lidar firmware >= 1.24
+    profile.conf_supported = profile.info.firmware_version >= ((0x1 << 8) | 24);
+    profile.typical_mode = RPLIDAR_CONF_SCAN_COMMAND_EXPRESS;
+
+    if (!_profileCacheDir.empty() && loadDeviceProfile(_profileCacheDir.c_str(), profile)) {
+        _profile = profile;
+        _profileValid = true;
+        return RESULT_OK;
+    }
+
+    if (profile.conf_supported) {
+        ans = _fetchScanModes(profile, PROFILE_PIPELINE_DEPTH, timeout);
+        if (IS_FAIL(ans)) {
+            // the device may not keep up with queued queries, ask one at a time
+            _drainResponses();
+            ans = _fetchScanModes(profile, 1, timeout);
+        }
+        if (IS_FAIL(ans)) return ans;
+    } else {
         rplidar_response_sample_rate_t sampleRateTmp;
-        ans = getSampleDuration_uS(sampleRateTmp);
-        if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
-        //judge if support express scan
-        bool ifSupportExpScan = false;
-        ans = checkExpressScanSupported(ifSupportExpScan);
-        if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
+        ans = _getSampleDuration_uS(sampleRateTmp);
+        if (IS_FAIL(ans)) return ans;
+        _cached_sampleduration_express = sampleRateTmp.express_sample_duration_us;
+        _cached_sampleduration_std = sampleRateTmp.std_sample_duration_us;
 
         RplidarScanMode stdScanModeInfo;
+        memset(&stdScanModeInfo, 0, sizeof(stdScanModeInfo));
         stdScanModeInfo.id = RPLIDAR_CONF_SCAN_COMMAND_STD;
         stdScanModeInfo.us_per_sample = sampleRateTmp.std_sample_duration_us;
         stdScanModeInfo.max_distance = 16;
         stdScanModeInfo.ans_type = RPLIDAR_ANS_TYPE_MEASUREMENT;
         strcpy(stdScanModeInfo.scan_mode, "Standard");
-        outModes.push_back(stdScanModeInfo);
-        if (ifSupportExpScan)
+        profile.modes.push_back(stdScanModeInfo);
+
+        //judge if support express scan
+        if (profile.info.firmware_version >= ((0x1 << 8) | 17))
         {
             RplidarScanMode expScanModeInfo;
+            memset(&expScanModeInfo, 0, sizeof(expScanModeInfo));
             expScanModeInfo.id = RPLIDAR_CONF_SCAN_COMMAND_EXPRESS;
             expScanModeInfo.us_per_sample = sampleRateTmp.express_sample_duration_us;
             expScanModeInfo.max_distance = 16;
             expScanModeInfo.ans_type = RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
             strcpy(expScanModeInfo.scan_mode, "Express");
-            outModes.push_back(expScanModeInfo);
+            profile.modes.push_back(expScanModeInfo);
+        }
+    }
+
+    if (!_profileCacheDir.empty()) {
+        // a failing disk cache only costs the next start its queries
+        saveDeviceProfile(_profileCacheDir.c_str(), profile);
+    }
+    _profile = profile;
+    _profileValid = true;
+    return RESULT_OK;
+}
+
+static u_result parseScanModeField(RplidarScanMode & mode, _u32 type, const _u8 * payload, size_t size)
+{
+    _u32 value;
+
+    switch (type) {
+    case RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE:
+    case RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE:
+        if (size < sizeof(_u32)) return RESULT_INVALID_DATA;
+        memcpy(&value, payload, sizeof(value));
+        if (type == RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE) {
+            mode.us_per_sample = (float)(value >> 8);
+        } else {
+            mode.max_distance = (float)(value >> 8);
+        }
+        return RESULT_OK;
+    case RPLIDAR_CONF_SCAN_MODE_ANS_TYPE:
+        mode.ans_type = payload[0];
+        return RESULT_OK;
+    case RPLIDAR_CONF_SCAN_MODE_NAME:
+        if (size > sizeof(mode.scan_mode) - 1) size = sizeof(mode.scan_mode) - 1;
+        memcpy(mode.scan_mode, payload, size);
+        mode.scan_mode[size] = 0;
+        return RESULT_OK;
+    default:
+        return RESULT_INVALID_DATA;
+    }
+}
+
+u_result RPlidarDriverImplCommon::_fetchScanModes(RplidarDeviceProfile & profile, size_t depth, _u32 timeout)
+{
+    static const _u32 modeFields[] = {
+        RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE,
+        RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE,
+        RPLIDAR_CONF_SCAN_MODE_ANS_TYPE,
+        RPLIDAR_CONF_SCAN_MODE_NAME,
+    };
+    const size_t fieldCount = _countof(modeFields);
+
+    u_result ans;
+    const _u8 * payload;
+    size_t size;
+
+    rp::hal::AutoLocker l(_lock);
+
+    // 1. the scan mode count and the typical scan mode
+    if (IS_FAIL(ans = _sendConfQuery(RPLIDAR_CONF_SCAN_MODE_COUNT, NULL, 0))) return ans;
+    if (depth > 1 && IS_FAIL(ans = _sendConfQuery(RPLIDAR_CONF_SCAN_MODE_TYPICAL, NULL, 0))) return ans;
+
+    if (IS_FAIL(ans = _readConfAnswer(RPLIDAR_CONF_SCAN_MODE_COUNT, payload, size, timeout))) return ans;
+    if (size < sizeof(_u16)) return RESULT_INVALID_DATA;
+    _u16 modeCount;
+    memcpy(&modeCount, payload, sizeof(modeCount));
+
+    if (depth <= 1 && IS_FAIL(ans = _sendConfQuery(RPLIDAR_CONF_SCAN_MODE_TYPICAL, NULL, 0))) return ans;
+    if (IS_FAIL(ans = _readConfAnswer(RPLIDAR_CONF_SCAN_MODE_TYPICAL, payload, size, timeout))) return ans;
+    if (size < sizeof(_u16)) return RESULT_INVALID_DATA;
+    memcpy(&profile.typical_mode, payload, sizeof(profile.typical_mode));
+
+    RplidarScanMode emptyMode;
+    memset(&emptyMode, 0, sizeof(emptyMode));
+    profile.modes.assign(modeCount, emptyMode);
+
+    // 2. all fields of each scan mode, keeping up to depth queries in flight
+    size_t total = modeCount * fieldCount;
+    size_t sent = 0;
+    for (size_t done = 0; done < total; ++done) {
+        for (; sent < total && sent - done < depth; ++sent) {
+            _u16 id = (_u16)(sent / fieldCount);
+            if (IS_FAIL(ans = _sendConfQuery(modeFields[sent % fieldCount], &id, sizeof(id)))) return ans;
         }
+
+        RplidarScanMode & mode = profile.modes[done / fieldCount];
+        mode.id = (_u16)(done / fieldCount);
+        if (IS_FAIL(ans = _readConfAnswer(modeFields[done % fieldCount], payload, size, timeout))) return ans;
+        if (IS_FAIL(ans = parseScanModeField(mode, modeFields[done % fieldCount], payload, size))) return ans;
+    }
+    return RESULT_OK;
+}
+
+void RPlidarDriverImplCommon::_drainResponses(_u32 quietMs)
+{
+    rp::hal::AutoLocker l(_lock);
+
+    // drop the answers still in flight until the line is quiet
+    _u8 scratch[64];
+    size_t available = 0;
+    _chanDev->discardBuffered();
+    while (_chanDev->waitfordata(1, quietMs, &available)) {
+        int received = _chanDev->recvdata(scratch, available < sizeof(scratch) ? available : sizeof(scratch));
+        if (received <= 0) break;
+        _recorder.record(STREAM_RECORD_RX, scratch, received);
+    }
+}
+
+const RplidarScanMode * RPlidarDriverImplCommon::_findScanMode(_u16 id) const
+{
+    for (size_t pos = 0; pos < _profile.modes.size(); ++pos) {
+        if (_profile.modes[pos].id == id) return &_profile.modes[pos];
+    }
+    return NULL;
+}
+
+u_result RPlidarDriverImplCommon::getLidarSampleDuration(float& sampleDurationRes, _u16 scanModeID, _u32 timeoutInMs)
+{
+    u_result ans;
+    std::vector<_u8> reserve(2);
+    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+
+    std::vector<_u8> answer;
+    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_US_PER_SAMPLE, answer, reserve, timeoutInMs);
+    if (IS_FAIL(ans))
+    {
         return ans;
     }
+    if (answer.size() < sizeof(_u32))
+    {
+        return RESULT_INVALID_DATA;
+    }
+    const _u32 *result = reinterpret_cast<const _u32*>(&answer[0]);
+    sampleDurationRes = (float)(*result >> 8);
+    _cached_current_us_per_sample = sampleDurationRes;
     return ans;
 }
 
+u_result RPlidarDriverImplCommon::getMaxDistance(float &maxDistance, _u16 scanModeID, _u32 timeoutInMs)
+{
+    u_result ans;
+    std::vector<_u8> reserve(2);
+    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+
+    std::vector<_u8> answer;
+    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_MAX_DISTANCE, answer, reserve, timeoutInMs);
+    if (IS_FAIL(ans))
+    {
+        return ans;
+    }
+    if (answer.size() < sizeof(_u32))
+    {
+        return RESULT_INVALID_DATA;
+    }
+    const _u32 *result = reinterpret_cast<const _u32*>(&answer[0]);
+    maxDistance = (float)(*result >> 8);
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::getScanModeAnsType(_u8 &ansType, _u16 scanModeID, _u32 timeoutInMs)
+{
+    u_result ans;
+    std::vector<_u8> reserve(2);
+    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+
+    std::vector<_u8> answer;
+    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_ANS_TYPE, answer, reserve, timeoutInMs);
+    if (IS_FAIL(ans))
+    {
+        return ans;
+    }
+    if (answer.size() < sizeof(_u8))
+    {
+        return RESULT_INVALID_DATA;
+    }
+    const _u8 *result = reinterpret_cast<const _u8*>(&answer[0]);
+    ansType = *result;
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::getScanModeName(char* modeName, _u16 scanModeID, _u32 timeoutInMs)
+{
+    u_result ans;
+    std::vector<_u8> reserve(2);
+    memcpy(&reserve[0], &scanModeID, sizeof(scanModeID));
+
+    std::vector<_u8> answer;
+    ans = getLidarConf(RPLIDAR_CONF_SCAN_MODE_NAME, answer, reserve, timeoutInMs);
+    if (IS_FAIL(ans))
+    {
+        return ans;
+    }
+    int len = answer.size();
+    if (0 == len) return RESULT_INVALID_DATA;
+    memcpy(modeName, &answer[0], len);
+    return ans;
+}
+
+u_result RPlidarDriverImplCommon::getAllSupportedScanModes(std::vector<RplidarScanMode>& outModes, _u32 timeoutInMs)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    if (!_profileValid) {
+        u_result ans = _loadDeviceProfile(timeoutInMs);
+        if (IS_FAIL(ans)) return ans;
+    }
+
+    outModes.insert(outModes.end(), _profile.modes.begin(), _profile.modes.end());
+    return RESULT_OK;
+}
+
 u_result RPlidarDriverImplCommon::getScanModeCount(_u16& modeCount, _u32 timeoutInMs)
 {
     u_result ans;
@@ -1579,11 +1685,17 @@ u_result RPlidarDriverImplCommon::getScanModeCount(_u16& modeCount, _u32 timeout
 
 
 u_result RPlidarDriverImplCommon::startScan(bool force, bool useTypicalScan, _u32 options, RplidarScanMode* outUsedScanMode)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _startScan(force, useTypicalScan, options, outUsedScanMode);
+}
+
+u_result RPlidarDriverImplCommon::_startScan(bool force, bool useTypicalScan, _u32 options, RplidarScanMode* outUsedScanMode)
 {
     u_result ans;
 
     bool ifSupportLidarConf = false;
-    ans = checkSupportConfigCommands(ifSupportLidarConf);
+    ans = _checkSupportConfigCommands(ifSupportLidarConf);
     if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
 
     if (useTypicalScan)
@@ -1591,148 +1703,67 @@ u_result RPlidarDriverImplCommon::startScan(bool force, bool useTypicalScan, _u3
         //if support lidar config protocol
         if (ifSupportLidarConf)
         {
-            _u16 typicalMode;
-            ans = getTypicalScanMode(typicalMode);
-            if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
-
             //call startScanExpress to do the job
-            return startScanExpress(false, typicalMode, 0, outUsedScanMode);
+            return _startScanExpress(false, _profile.typical_mode, 0, outUsedScanMode);
         }
-        //if old version of triangle lidar
-        else
+        //if old version of triangle lidar supporting express scan
+        else if (_findScanMode(RPLIDAR_CONF_SCAN_COMMAND_EXPRESS))
         {
-            bool isExpScanSupported = false;
-            ans = checkExpressScanSupported(isExpScanSupported);
-            if (IS_FAIL(ans)) {
-                return ans;
-            }
-            if (isExpScanSupported)
-            {
-                return startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_EXPRESS, 0, outUsedScanMode);
-            }
+            return _startScanExpress(false, RPLIDAR_CONF_SCAN_COMMAND_EXPRESS, 0, outUsedScanMode);
         }
     }
     
     // 'useTypicalScan' is false, just use normal scan mode
-    if(ifSupportLidarConf)
-    {
-        if(outUsedScanMode)
-        {
-            outUsedScanMode->id = RPLIDAR_CONF_SCAN_COMMAND_STD;
-            ans = getLidarSampleDuration(outUsedScanMode->us_per_sample, outUsedScanMode->id);
-            if(IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-
-            ans = getMaxDistance(outUsedScanMode->max_distance, outUsedScanMode->id);
-            if(IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-
-            ans = getScanModeAnsType(outUsedScanMode->ans_type, outUsedScanMode->id);
-            if(IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-
-            ans = getScanModeName(outUsedScanMode->scan_mode, outUsedScanMode->id);
-            if(IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-        }
-    }
-    else
+    if (outUsedScanMode)
     {
-        if(outUsedScanMode)
-        {
-            rplidar_response_sample_rate_t sampleRateTmp;
-            ans = getSampleDuration_uS(sampleRateTmp);
-            if(IS_FAIL(ans)) return RESULT_INVALID_DATA;
-            outUsedScanMode->us_per_sample = sampleRateTmp.std_sample_duration_us;
-            outUsedScanMode->max_distance = 16;
-            outUsedScanMode->ans_type = RPLIDAR_ANS_TYPE_MEASUREMENT;
-            strcpy(outUsedScanMode->scan_mode, "Standard");
-        }
+        const RplidarScanMode * usedMode = _findScanMode(RPLIDAR_CONF_SCAN_COMMAND_STD);
+        if (!usedMode) return RESULT_INVALID_DATA;
+        *outUsedScanMode = *usedMode;
     }
 
-    return startScanNormal(force);
+    return _startScanNormal(force);
 }
 
 u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u32 options, RplidarScanMode* outUsedScanMode, _u32 timeout)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _startScanExpress(force, scanMode, options, outUsedScanMode, timeout);
+}
+
+u_result RPlidarDriverImplCommon::_startScanExpress(bool force, _u16 scanMode, _u32 options, RplidarScanMode* outUsedScanMode, _u32 timeout)
 {
     u_result ans;
     if (!isConnected()) return RESULT_OPERATION_FAIL;
     if (_isScanning) return RESULT_ALREADY_DONE;
 
-    stop(); //force the previous operation to stop
+    _stop(); //force the previous operation to stop
 
     if (scanMode == RPLIDAR_CONF_SCAN_COMMAND_STD)
     {
-        return startScan(force, false, 0, outUsedScanMode);
+        return _startScan(force, false, 0, outUsedScanMode);
     }
 
     
     bool ifSupportLidarConf = false;
-    ans = checkSupportConfigCommands(ifSupportLidarConf);
+    ans = _checkSupportConfigCommands(ifSupportLidarConf);
     if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
 
-    if (outUsedScanMode)
-    {
-        outUsedScanMode->id = scanMode;
-        if (ifSupportLidarConf)
-        {
-            ans = getLidarSampleDuration(outUsedScanMode->us_per_sample, outUsedScanMode->id);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-            
-            ans = getMaxDistance(outUsedScanMode->max_distance, outUsedScanMode->id);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-
-            ans = getScanModeAnsType(outUsedScanMode->ans_type, outUsedScanMode->id);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
+    // the scans are sized, and their samples stamped, with the duration of this very mode
+    const RplidarScanMode * usedMode = _findScanMode(scanMode);
+    if (!usedMode) return RESULT_INVALID_DATA;
+    if (outUsedScanMode) *outUsedScanMode = *usedMode;
 
-            ans = getScanModeName(outUsedScanMode->scan_mode, outUsedScanMode->id);
-            if (IS_FAIL(ans))
-            {
-                return RESULT_INVALID_DATA;
-            }
-           
-
-        }
-        else
-        {
-            rplidar_response_sample_rate_t sampleRateTmp;
-            ans = getSampleDuration_uS(sampleRateTmp);
-            if (IS_FAIL(ans)) return RESULT_INVALID_DATA;
-
-            outUsedScanMode->us_per_sample = sampleRateTmp.express_sample_duration_us;
-            outUsedScanMode->max_distance = 16;
-            outUsedScanMode->ans_type = RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
-            strcpy(outUsedScanMode->scan_mode, "Express");
-        }
-    }
+    float usPerSample = usedMode->us_per_sample;
+    _cached_current_us_per_sample = usPerSample;
 
     //get scan answer type to specify how to wait data
-    _u8 scanAnsType;
-    if (ifSupportLidarConf)
-    {      
-        getScanModeAnsType(scanAnsType, scanMode);
-    }
-    else
-    {
-        scanAnsType = RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED;
-    }
+    _u8 scanAnsType = usedMode->ans_type;
+
+    // remembered to restart the scan after a query, see _pauseScan
+    _scanCommand = SCAN_COMMAND_EXPRESS;
+    _scanForce = force;
+    _scanModeId = scanMode;
+    _scanOptions = options;
 
     {
         rp::hal::AutoLocker l(_lock);
@@ -1766,8 +1797,11 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
                 return RESULT_INVALID_DATA;
             }
             _cached_express_flag = 0;
+            _applyRxLowWaterMark(sizeof(rplidar_response_capsule_measurement_nodes_t));
+            _sizeScanBuffers(usPerSample);
             _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheCapsuledScanData);
+            _startPacketPump(_capsuleFormat);
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _ingestScanData<CapsulePolicy>);
         }
         else if (scanAnsType == RPLIDAR_ANS_TYPE_MEASUREMENT_DENSE_CAPSULED)
         {
@@ -1775,176 +1809,441 @@ u_result RPlidarDriverImplCommon::startScanExpress(bool force, _u16 scanMode, _u
                 return RESULT_INVALID_DATA;
             }
             _cached_express_flag = 1;
+            _applyRxLowWaterMark(sizeof(rplidar_response_dense_capsule_measurement_nodes_t));
+            _sizeScanBuffers(usPerSample);
             _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheCapsuledScanData);
+            _startPacketPump(_capsuleFormat);
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _ingestScanData<DenseCapsulePolicy>);
         }
         else if (scanAnsType == RPLIDAR_ANS_TYPE_MEASUREMENT_HQ) {
             if (header_size < sizeof(rplidar_response_hq_capsule_measurement_nodes_t)) {
                 return RESULT_INVALID_DATA;
             }
+            _applyRxLowWaterMark(sizeof(rplidar_response_hq_capsule_measurement_nodes_t));
+            _sizeScanBuffers(usPerSample);
             _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheHqScanData);
+            _startPacketPump(_hqCapsuleFormat);
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _ingestScanData<HqCapsulePolicy>);
         }
         else
         {
             if (header_size < sizeof(rplidar_response_ultra_capsule_measurement_nodes_t)) {
                 return RESULT_INVALID_DATA;
             }
+            _applyRxLowWaterMark(sizeof(rplidar_response_ultra_capsule_measurement_nodes_t));
+            _sizeScanBuffers(usPerSample);
             _isScanning = true;
-            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _cacheUltraCapsuledScanData);
+            _startPacketPump(_ultraCapsuleFormat);
+            _cachethread = CLASS_THREAD(RPlidarDriverImplCommon, _ingestScanData<UltraCapsulePolicy>);
         }
 
         if (_cachethread.getHandle() == 0) {
             return RESULT_OPERATION_FAIL;
         }
+        if (_decode_cpu >= 0) _cachethread.setAffinity(_decode_cpu);
         
     }
     return RESULT_OK;
 }
 
-u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+u_result RPlidarDriverImplCommon::stop(_u32 timeout)
+{
+    rp::hal::AutoLocker l(_commandLock);
+    return _stop(timeout);
+}
+
+u_result RPlidarDriverImplCommon::_stop(_u32 timeout)
+{
+    u_result ans;
+    _disableDataGrabbing();
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
+            return ans;
+        }
+    }
+    return RESULT_OK;
+}
+
+void RPlidarDriverImplCommon::_sizeScanBuffers(float usPerSample)
+{
+    // called under _lock, before the cache thread starts
+    bool compact = (_driver_options & DRIVER_OPTION_COMPACT_MEMORY) != 0;
+    size_t capacity = _max_scan_nodes;
+    if (usPerSample > 0) {
+        // one rotation at the slowest rate, rounded up
+        size_t rotation = (size_t)(1000000.0f / (usPerSample * (compact ? COMPACT_MIN_SCAN_FREQUENCY : MIN_SCAN_FREQUENCY))) + 1;
+        if (rotation < capacity) capacity = rotation;
+    }
+    _scanPool.setCapacity(capacity);
+
+    // the interval buffer is drained by polling, not per rotation, it keeps the full size
+    rp::hal::AutoLocker l(_intervalLock);
+    if (_intervalRing.capacity() != _max_scan_nodes) {
+        _intervalRing.resize(_max_scan_nodes);
+    }
+}
+
+PooledScan * RPlidarDriverImplCommon::_publishScan(PooledScan * scan, size_t count, const ScanTiming & timing)
+{
+    if (count > scan->capacity()) ++_truncatedScans;
+    scan->seal(_nextScanSeq++, count, timing, _truncatedScans);
+    _scanRing.publish(scan);
+    {
+        rp::hal::AutoLocker l(_subscriptionLock);
+        for (size_t pos = 0; pos < _subscriptions.size(); ++pos) {
+            _subscriptions[pos]->push(scan);
+        }
+    }
+    scan->release();
+
+    // unless a consumer still holds it, this is the scan just released
+    return _scanPool.acquire();
+}
+
+u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+{
+    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+
+    rp::hal::AutoLocker l(_grabLock);
+    if (_scanLent) return RESULT_OPERATION_FAIL;
+    const RplidarScan * scan = _scanRing.beginRead(timeout);
+    if (!scan) {
+        count = 0;
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    size_t size_to_copy = min(count, scan->count());
+
+    for (size_t i = 0; i < size_to_copy; i++)
+        convert(scan->nodes()[i], nodebuffer[i]);
+
+    count = size_to_copy;
+    _scanRing.releaseRead();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout)
+{
+    RplidarScanInfo info;
+    return grabScanDataHq(nodebuffer, count, info, timeout);
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, RplidarScanInfo & info, _u32 timeout)
+{
+    return grabScanDataHq(nodebuffer, NULL, count, info, timeout);
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamp_us, size_t & count, RplidarScanInfo & info, _u32 timeout)
+{
+    rp::hal::AutoLocker l(_grabLock);
+    if (_scanLent) return RESULT_OPERATION_FAIL;
+    const RplidarScan * scan = _scanRing.beginRead(timeout);
+    if (!scan) {
+        count = 0;
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    size_t size_to_copy = min(count, scan->count());
+    memcpy(nodebuffer, scan->nodes(), size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+    if (timestamp_us && scan->timestamps()) {
+        memcpy(timestamp_us, scan->timestamps(), size_to_copy * sizeof(_u64));
+    } else if (timestamp_us) {
+        // compact scans: spread the packet arrival times evenly over the samples
+        const RplidarScanInfo & scanInfo = scan->info();
+        _u64 span = scanInfo.last_packet_us - scanInfo.first_packet_us;
+        size_t steps = scan->count() > 1 ? scan->count() - 1 : 1;
+        for (size_t pos = 0; pos < size_to_copy; ++pos) {
+            timestamp_us[pos] = scanInfo.first_packet_us + span * pos / steps;
+        }
+    }
+
+    count = size_to_copy;
+    info = scan->info();
+    info.dropped = _scanRing.droppedCount();
+    _scanRing.releaseRead();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataGrid(float * ranges, _u8 * qualities, size_t bins, _u32 reduction, RplidarScanInfo & info, _u32 timeout)
+{
+    rp::hal::AutoLocker l(_grabLock);
+    if (_scanLent) return RESULT_OPERATION_FAIL;
+
+    const RplidarScan * scan = _scanRing.beginRead(timeout);
+    if (!scan) return RESULT_OPERATION_TIMEOUT;
+
+    // binned straight from the ring, nothing is copied or sorted
+    if (!_scanGrid.resample(scan->nodes(), scan->count(), bins, reduction, ranges, qualities)) {
+        _scanRing.releaseRead();
+        return RESULT_INVALID_DATA;
+    }
+    info = scan->info();
+    info.dropped = _scanRing.droppedCount();
+    _scanRing.releaseRead();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::grabScanDataCartesian(float * x, float * y, float * quality, size_t & count, RplidarScanInfo & info, const RplidarTransform2D * transform, _u32 timeout)
+{
+    if (!x || !y) return RESULT_INVALID_DATA;
+    rp::hal::AutoLocker l(_grabLock);
+    if (_scanLent) return RESULT_OPERATION_FAIL;
+
+    const RplidarScan * scan = _scanRing.beginRead(timeout);
+    if (!scan) {
+        count = 0;
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    // converted straight from the ring, a scan has no more points than nodes
+    count = scan_to_cartesian(scan->nodes(), min(count, scan->count()), transform, x, y, quality);
+    info = scan->info();
+    info.dropped = _scanRing.droppedCount();
+    _scanRing.releaseRead();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::lendScanDataHq(RplidarScanView & view, _u32 timeout)
+{
+    rp::hal::AutoLocker l(_grabLock);
+    // a lent scan is still held by the ring
+    const RplidarScan * scan = _scanRing.beginRead(_scanLent ? 0 : timeout);
+    if (!scan) {
+        view.nodes = NULL;
+        view.timestamp_us = NULL;
+        view.count = 0;
+        memset(&view.arrays, 0, sizeof(view.arrays));
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    view.nodes = scan->nodes();
+    view.timestamp_us = scan->timestamps();
+    view.count = scan->count();
+    view.arrays = scan->arrays();
+    view.info = scan->info();
+    view.info.dropped = _scanRing.droppedCount();
+    _scanLent = true;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::releaseScanDataHq()
 {
-    u_result ans;
-    _disableDataGrabbing();
+    rp::hal::AutoLocker l(_grabLock);
+    if (!_scanLent) return RESULT_ALREADY_DONE;
 
-    {
-        rp::hal::AutoLocker l(_lock);
+    _scanLent = false;
+    _scanRing.releaseRead();
+    return RESULT_OK;
+}
 
-        if (IS_FAIL(ans = _sendCommand(RPLIDAR_CMD_STOP))) {
-            return ans;
-        }
+ScanSubscription * RPlidarDriverImplCommon::_findSubscription(_u32 subscription)
+{
+    for (size_t pos = 0; pos < _subscriptions.size(); ++pos) {
+        if (_subscriptions[pos]->id() == subscription) return _subscriptions[pos];
     }
-    return RESULT_OK;
+    return NULL;
 }
 
-u_result RPlidarDriverImplCommon::grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::subscribeScans(_u32 & subscription, size_t backlog, RplidarScanCallback callback, void * user_data)
 {
-    DEPRECATED_WARN("grabScanData()", "grabScanDataHq()");
+    if (backlog == 0) return RESULT_INVALID_DATA;
+
+    rp::hal::AutoLocker l(_subscriptionLock);
+    ScanSubscription * sub = new ScanSubscription(_nextSubscriptionId++, backlog, callback, user_data);
+    sub->start();
+    _subscriptions.push_back(sub);
+    subscription = sub->id();
+    return RESULT_OK;
+}
 
-    switch (_dataEvt.wait(timeout))
+u_result RPlidarDriverImplCommon::waitSubscribedScan(_u32 subscription, const RplidarScan *& scan, _u32 timeout)
+{
+    ScanSubscription * sub;
     {
-    case rp::hal::Event::EVENT_TIMEOUT:
-        count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-        {
-            if(_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+        rp::hal::AutoLocker l(_subscriptionLock);
+        sub = _findSubscription(subscription);
+    }
+    scan = NULL;
+    if (!sub || sub->hasCallback()) return RESULT_INVALID_DATA;
 
-            rp::hal::AutoLocker l(_lock);
+    // the subscription cannot go away while its own consumer waits on it
+    scan = sub->pop(timeout);
+    return scan ? RESULT_OK : RESULT_OPERATION_TIMEOUT;
+}
 
-            size_t size_to_copy = min(count, _cached_scan_node_hq_count);
+u_result RPlidarDriverImplCommon::unsubscribeScans(_u32 subscription)
+{
+    ScanSubscription * sub = NULL;
+    {
+        rp::hal::AutoLocker l(_subscriptionLock);
+        for (size_t pos = 0; pos < _subscriptions.size(); ++pos) {
+            if (_subscriptions[pos]->id() == subscription) {
+                sub = _subscriptions[pos];
+                _subscriptions.erase(_subscriptions.begin() + pos);
+                break;
+            }
+        }
+    }
+    if (!sub) return RESULT_INVALID_DATA;
 
-            for (size_t i = 0; i < size_to_copy; i++)
-                convert(_cached_scan_node_hq_buf[i], nodebuffer[i]);
+    // joins the callback thread, outside of the lock the cache thread publishes under
+    delete sub;
+    return RESULT_OK;
+}
 
-            count = size_to_copy;
-            _cached_scan_node_hq_count = 0;
-        }
-        return RESULT_OK;
+u_result RPlidarDriverImplCommon::setScanQueueDepth(size_t depth)
+{
+    rp::hal::AutoLocker l(_grabLock);
+    if (_isScanning || _scanLent) return RESULT_OPERATION_FAIL;
+    if (depth == _scanRing.depth()) return RESULT_OK;
 
-    default:
-        count = 0;
-        return RESULT_OPERATION_FAIL;
-    }
+    return _scanRing.resize(depth) ? RESULT_OK : RESULT_INVALID_DATA;
 }
 
-u_result RPlidarDriverImplCommon::grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout)
+u_result RPlidarDriverImplCommon::setScanOverflowPolicy(_u32 policy)
 {
-    switch (_dataEvt.wait(timeout))
-    {
-    case rp::hal::Event::EVENT_TIMEOUT:
-        count = 0;
-        return RESULT_OPERATION_TIMEOUT;
-    case rp::hal::Event::EVENT_OK:
-    {
-        if (_cached_scan_node_hq_count == 0) return RESULT_OPERATION_TIMEOUT; //consider as timeout
+    if (policy != SCAN_OVERFLOW_KEEP_LATEST && policy != SCAN_OVERFLOW_DROP_NEWEST) return RESULT_INVALID_DATA;
 
-        rp::hal::AutoLocker l(_lock);
+    rp::hal::AutoLocker l(_grabLock);
+    if (_isScanning || _scanLent) return RESULT_OPERATION_FAIL;
 
-        size_t size_to_copy = min(count, _cached_scan_node_hq_count);
-        memcpy(nodebuffer, _cached_scan_node_hq_buf, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
+    _scanRing.setPolicy(policy == SCAN_OVERFLOW_DROP_NEWEST ? ScanRing::DROP_NEWEST : ScanRing::KEEP_LATEST);
+    return RESULT_OK;
+}
 
-        count = size_to_copy;
-        _cached_scan_node_hq_count = 0;
-    }
+u_result RPlidarDriverImplCommon::setRxLowWaterMark(size_t bytes)
+{
+    _rx_low_water_mark = bytes;
     return RESULT_OK;
+}
 
-    default:
-        count = 0;
-        return RESULT_OPERATION_FAIL;
-    }
+u_result RPlidarDriverImplCommon::setDecodePipeline(bool enable, int ioCpu, int decodeCpu)
+{
+    if (ioCpu < -1 || decodeCpu < -1) return RESULT_INVALID_DATA;
+
+    _decode_pipeline = enable;
+    _io_cpu = ioCpu;
+    _decode_cpu = decodeCpu;
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::startRecording(const char * path)
+{
+    if (!path) return RESULT_INVALID_DATA;
+    return _recorder.start(path) ? RESULT_OK : RESULT_OPERATION_FAIL;
+}
+
+u_result RPlidarDriverImplCommon::stopRecording()
+{
+    _recorder.stop();
+    return RESULT_OK;
 }
 
 u_result RPlidarDriverImplCommon::getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count)
 {
     DEPRECATED_WARN("getScanDataWithInterval(rplidar_response_measurement_node_t*, size_t&)", "getScanDataWithInterval(rplidar_response_measurement_node_hq_t*, size_t&)");
 
+    rplidar_response_measurement_node_hq_t chunk[64];
     size_t size_to_copy = 0;
     {
-        rp::hal::AutoLocker l(_lock);
-        if(_cached_scan_node_hq_count_for_interval_retrieve == 0)
-        {
-            return RESULT_OPERATION_TIMEOUT; 
-        }
-        //copy all the nodes(_cached_scan_node_count_for_interval_retrieve nodes) in _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = _cached_scan_node_hq_count_for_interval_retrieve;
-        for (size_t i = 0; i < size_to_copy; i++)
+        rp::hal::AutoLocker l(_intervalLock);
+        //copy all the nodes queued in the interval ring
+        size_t taken;
+        while ((taken = _intervalRing.pop(chunk, _countof(chunk))) != 0)
         {
-            convert(_cached_scan_node_hq_buf_for_interval_retrieve[i], nodebuffer[i]);
+            for (size_t i = 0; i < taken; i++)
+            {
+                convert(chunk[i], nodebuffer[size_to_copy + i]);
+            }
+            size_to_copy += taken;
         }
-        _cached_scan_node_hq_count_for_interval_retrieve = 0;
     }
     count = size_to_copy;
 
+    if (size_to_copy == 0)
+    {
+        return RESULT_OPERATION_TIMEOUT; 
+    }
     return RESULT_OK;
 }
 
 u_result RPlidarDriverImplCommon::getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count)
+{
+    _u64 dropped;
+    return getScanDataWithIntervalHq(nodebuffer, count, dropped);
+}
+
+u_result RPlidarDriverImplCommon::getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u64 & dropped)
 {
     size_t size_to_copy = 0;
+    size_t remaining = 0;
     // Prevent crash in case lidar is not scanning - that way this function will leave nodebuffer untouched and set
     // count to 0.
     if (_isScanning)
     {
-        rp::hal::AutoLocker l(_lock);
-        if (_cached_scan_node_hq_count_for_interval_retrieve == 0)
-        {
-            return RESULT_OPERATION_TIMEOUT;
-        }
-        // Copy at most count nodes from _cached_scan_node_buf_for_interval_retrieve
-        size_to_copy = min(_cached_scan_node_hq_count_for_interval_retrieve, count);
-        memcpy(nodebuffer, _cached_scan_node_hq_buf_for_interval_retrieve, size_to_copy * sizeof(rplidar_response_measurement_node_hq_t));
-        _cached_scan_node_hq_count_for_interval_retrieve -= size_to_copy;
-        // Move remaining data to the start of the array.
-        memmove(&_cached_scan_node_hq_buf_for_interval_retrieve[0], &_cached_scan_node_hq_buf_for_interval_retrieve[size_to_copy], _cached_scan_node_hq_count_for_interval_retrieve *  sizeof(rplidar_response_measurement_node_hq_t));
+        rp::hal::AutoLocker l(_intervalLock);
+        // Copy at most count nodes, in up to two segments, the cache thread keeps appending meanwhile
+        size_to_copy = _intervalRing.pop(nodebuffer, count);
+        remaining = _intervalRing.pending();
     }
     count = size_to_copy;
+    dropped = _intervalRing.droppedCount();
+
+    if (size_to_copy == 0 && _isScanning)
+    {
+        return RESULT_OPERATION_TIMEOUT;
+    }
 
 	// If there is remaining data, return with a warning.
-	if (_cached_scan_node_hq_count_for_interval_retrieve > 0)
+	if (remaining > 0)
 		return RESULT_REMAINING_DATA;
     return RESULT_OK;
 }
 
-static inline float getAngle(const rplidar_response_measurement_node_t& node)
+u_result RPlidarDriverImplCommon::setIntervalOverflowPolicy(_u32 policy)
+{
+    if (_isScanning) return RESULT_OPERATION_FAIL;
+    if (policy != INTERVAL_OVERFLOW_DROP_NEWEST && policy != INTERVAL_OVERFLOW_DROP_OLDEST) return RESULT_INVALID_DATA;
+
+    rp::hal::AutoLocker l(_intervalLock);
+    _intervalRing.setPolicy(policy == INTERVAL_OVERFLOW_DROP_OLDEST ? IntervalRing::DROP_OLDEST : IntervalRing::DROP_NEWEST);
+    return RESULT_OK;
+}
+
+// Angles are handled in the fixed point unit of each node type: q6 degrees for the
+// legacy nodes, q14 quarter turns for the HQ ones, whose order matches the angles.
+static inline _u32 getAngleRaw(const rplidar_response_measurement_node_t& node)
 {
-    return (node.angle_q6_checkbit >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) / 64.f;
+    return node.angle_q6_checkbit >> RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT;
 }
 
-static inline void setAngle(rplidar_response_measurement_node_t& node, float v)
+static inline void setAngleRaw(rplidar_response_measurement_node_t& node, _u32 v)
 {
     _u16 checkbit = node.angle_q6_checkbit & RPLIDAR_RESP_MEASUREMENT_CHECKBIT;
-    node.angle_q6_checkbit = (((_u16)(v * 64.0f)) << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | checkbit;
+    node.angle_q6_checkbit = (_u16)((v << RPLIDAR_RESP_MEASUREMENT_ANGLE_SHIFT) | checkbit);
+}
+
+static inline _u32 getFullTurnRaw(const rplidar_response_measurement_node_t&)
+{
+    return 360 << 6;
+}
+
+static inline _u32 getAngleRaw(const rplidar_response_measurement_node_hq_t& node)
+{
+    return node.angle_z_q14;
 }
 
-static inline float getAngle(const rplidar_response_measurement_node_hq_t& node)
+static inline void setAngleRaw(rplidar_response_measurement_node_hq_t& node, _u32 v)
 {
-    return node.angle_z_q14 * 90.f / 16384.f;
+    node.angle_z_q14 = v;
 }
 
-static inline void setAngle(rplidar_response_measurement_node_hq_t& node, float v)
+static inline _u32 getFullTurnRaw(const rplidar_response_measurement_node_hq_t&)
 {
-    node.angle_z_q14 = _u32(v * 16384.f / 90.f);
+    return 4 << 14;
 }
 
 static inline _u16 getDistanceQ2(const rplidar_response_measurement_node_t& node)
@@ -1960,61 +2259,93 @@ static inline _u32 getDistanceQ2(const rplidar_response_measurement_node_hq_t& n
 template <class TNode>
 static bool angleLessThan(const TNode& a, const TNode& b)
 {
-    return getAngle(a) < getAngle(b);
+    return getAngleRaw(a) < getAngleRaw(b);
+}
+
+// Sort nodes that are ascending but for local disorder, in O(n + displacement).
+// Gives up and returns false once more than maxMoves nodes had to be shifted.
+template <class TNode>
+static bool insertionSortBounded(TNode * nodebuffer, size_t count, size_t maxMoves)
+{
+    size_t moves = 0;
+    for (size_t i = 1; i < count; ++i) {
+        _u32 key = getAngleRaw(nodebuffer[i]);
+        if (getAngleRaw(nodebuffer[i - 1]) <= key) continue;
+
+        TNode node = nodebuffer[i];
+        size_t pos = i;
+        do {
+            nodebuffer[pos] = nodebuffer[pos - 1];
+            --pos;
+            if (++moves > maxMoves) {
+                nodebuffer[pos] = node;
+                return false;
+            }
+        } while (pos && getAngleRaw(nodebuffer[pos - 1]) > key);
+        nodebuffer[pos] = node;
+    }
+    return true;
 }
 
 template < class TNode >
 static u_result ascendScanData_(TNode * nodebuffer, size_t count)
 {
-    float inc_origin_angle = 360.f/count;
-    size_t i = 0;
+    size_t first, last, i;
+
+    for (first = 0; first < count && getDistanceQ2(nodebuffer[first]) == 0; ++first);
+    // all the data is invalid
+    if (first == count) return RESULT_OPERATION_FAIL;
+    for (last = count - 1; getDistanceQ2(nodebuffer[last]) == 0; --last);
+
+    // the invalid nodes carry no angle, place them where they were sampled: one
+    // count-th of a turn apart, counted from the valid node before or after them
+    const _u64 fullTurn = getFullTurnRaw(nodebuffer[0]);
 
     //Tune head
-    for (i = 0; i < count; i++) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            continue;
-        } else {
-            while(i != 0) {
-                i--;
-                float expect_angle = getAngle(nodebuffer[i+1]) - inc_origin_angle;
-                if (expect_angle < 0.0f) expect_angle = 0.0f;
-                setAngle(nodebuffer[i], expect_angle);
-            }
-            break;
-        }
+    _u32 firstAngle = getAngleRaw(nodebuffer[first]);
+    for (i = 0; i < first; ++i) {
+        _u64 back = (first - i) * fullTurn / count;
+        setAngleRaw(nodebuffer[i], back < firstAngle ? (_u32)(firstAngle - back) : 0);
     }
 
-    // all the data is invalid
-    if (i == count) return RESULT_OPERATION_FAIL;
-
     //Tune tail
-    for (i = count - 1; i >= 0; i--) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            continue;
-        } else {
-            while(i != (count - 1)) {
-                i++;
-                float expect_angle = getAngle(nodebuffer[i-1]) + inc_origin_angle;
-                if (expect_angle > 360.0f) expect_angle -= 360.0f;
-                setAngle(nodebuffer[i], expect_angle);
-            }
-            break;
-        }
+    _u32 lastAngle = getAngleRaw(nodebuffer[last]);
+    for (i = last + 1; i < count; ++i) {
+        _u64 expect = lastAngle + (i - last) * fullTurn / count;
+        if (expect > fullTurn) expect -= fullTurn;
+        setAngleRaw(nodebuffer[i], (_u32)expect);
     }
 
     //Fill invalid angle in the scan
-    float frontAngle = getAngle(nodebuffer[0]);
-    for (i = 1; i < count; i++) {
-        if(getDistanceQ2(nodebuffer[i]) == 0) {
-            float expect_angle =  frontAngle + i * inc_origin_angle;
-            if (expect_angle > 360.0f) expect_angle -= 360.0f;
-            setAngle(nodebuffer[i], expect_angle);
+    _u32 frontAngle = getAngleRaw(nodebuffer[0]);
+    for (i = 1; i < count; ++i) {
+        if (getDistanceQ2(nodebuffer[i]) == 0) {
+            _u64 expect = frontAngle + i * fullTurn / count;
+            if (expect > fullTurn) expect -= fullTurn;
+            setAngleRaw(nodebuffer[i], (_u32)expect);
         }
     }
 
-    // Reorder the scan according to the angle value
-    std::sort(nodebuffer, nodebuffer + count, &angleLessThan<TNode>);
+    // One rotation is two ascending runs split where the angle wraps: the largest
+    // drop. Moving the second run in front leaves only the local disorder of the
+    // measurements, which the insertion sort removes in linear time.
+    size_t wrap = 0;
+    _u32 wrapDrop = 0;
+    for (i = 1; i < count; ++i) {
+        _u32 prev = getAngleRaw(nodebuffer[i - 1]);
+        _u32 cur = getAngleRaw(nodebuffer[i]);
+        if (prev > cur && prev - cur > wrapDrop) {
+            wrapDrop = prev - cur;
+            wrap = i;
+        }
+    }
+    if (!wrapDrop) return RESULT_OK;
+    if (wrap) std::rotate(nodebuffer, nodebuffer + wrap, nodebuffer + count);
 
+    if (!insertionSortBounded(nodebuffer, count, count * 8)) {
+        // far from a single rotation, sort it in O(n log n)
+        std::stable_sort(nodebuffer, nodebuffer + count, &angleLessThan<TNode>);
+    }
     return RESULT_OK;
 }
 
@@ -2030,10 +2361,20 @@ u_result RPlidarDriverImplCommon::ascendScanData(rplidar_response_measurement_no
     return ascendScanData_<rplidar_response_measurement_node_hq_t>(nodebuffer, count);
 }
 
+u_result RPlidarDriverImplCommon::ascendScanData(const rplidar_response_measurement_node_hq_t * nodebuffer, rplidar_response_measurement_node_hq_t * outbuffer, size_t count)
+{
+    if (outbuffer != nodebuffer && count) {
+        memcpy(outbuffer, nodebuffer, count * sizeof(rplidar_response_measurement_node_hq_t));
+    }
+    return ascendScanData_<rplidar_response_measurement_node_hq_t>(outbuffer, count);
+}
+
 u_result RPlidarDriverImplCommon::_sendCommand(_u8 cmd, const void * payload, size_t payloadsize)
 {
-    _u8 pkt_header[10];
-    rplidar_cmd_packet_t * header = reinterpret_cast<rplidar_cmd_packet_t * >(pkt_header);
+    // header, size byte, up to 255 payload bytes and checksum
+    _u8 pkt[2 + 1 + 255 + 1];
+    rplidar_cmd_packet_t * header = reinterpret_cast<rplidar_cmd_packet_t * >(pkt);
+    size_t pkt_size = 2;
     _u8 checksum = 0;
 
     if (!_isConnected) return RESULT_OPERATION_FAIL;
@@ -2045,30 +2386,28 @@ u_result RPlidarDriverImplCommon::_sendCommand(_u8 cmd, const void * payload, si
     header->syncByte = RPLIDAR_CMD_SYNC_BYTE;
     header->cmd_flag = cmd;
 
-    // send header first
-    _chanDev->senddata(pkt_header, 2) ;
-
     if (cmd & RPLIDAR_CMDFLAG_HAS_PAYLOAD) {
+        _u8 sizebyte = (_u8)payloadsize;
+
         checksum ^= RPLIDAR_CMD_SYNC_BYTE;
         checksum ^= cmd;
-        checksum ^= (payloadsize & 0xFF);
+        checksum ^= sizebyte;
 
         // calc checksum
-        for (size_t pos = 0; pos < payloadsize; ++pos) {
+        for (size_t pos = 0; pos < sizebyte; ++pos) {
             checksum ^= ((_u8 *)payload)[pos];
         }
 
-        // send size
-        _u8 sizebyte = payloadsize;
-        _chanDev->senddata(&sizebyte, 1);
-
-        // send payload
-        _chanDev->senddata((const _u8 *)payload, sizebyte);
-
-        // send checksum
-        _chanDev->senddata(&checksum, 1);
+        pkt[pkt_size++] = sizebyte;
+        memcpy(pkt + pkt_size, payload, sizebyte);
+        pkt_size += sizebyte;
+        pkt[pkt_size++] = checksum;
     }
 
+    // the whole packet in one write, one record of a recording
+    _chanDev->senddata(pkt, pkt_size);
+    _recorder.record(STREAM_RECORD_TX, pkt, pkt_size);
+
     return RESULT_OK;
 }
 
@@ -2076,13 +2415,26 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
 {  
     DEPRECATED_WARN("getSampleDuration_uS", "RplidarScanMode::us_per_sample");
 
+    rp::hal::AutoLocker l(_commandLock);
+    return _getSampleDuration_uS(rateInfo, timeout);
+}
+
+u_result RPlidarDriverImplCommon::_getSampleDuration_uS(rplidar_response_sample_rate_t & rateInfo, _u32 timeout)
+{
     if (!isConnected()) return RESULT_OPERATION_FAIL;
-    
-    _disableDataGrabbing();
-    
+
+    _u64 gapUs;
+    bool paused = _pauseScan();
+    u_result ans = _querySampleDuration(rateInfo, timeout);
+    u_result restarted = _resumeScan(paused, gapUs);
+    return IS_FAIL(ans) ? ans : restarted;
+}
+
+u_result RPlidarDriverImplCommon::_querySampleDuration(rplidar_response_sample_rate_t & rateInfo, _u32 timeout)
+{
     rplidar_response_device_info_t devinfo;
     // 1. fetch the device version first...
-    u_result ans = getDeviceInfo(devinfo, timeout);
+    u_result ans = _getDeviceInfo(devinfo, timeout);
 
     rateInfo.express_sample_duration_us = _cached_sampleduration_express;
     rateInfo.std_sample_duration_us = _cached_sampleduration_std;
@@ -2116,10 +2468,11 @@ u_result RPlidarDriverImplCommon::getSampleDuration_uS(rplidar_response_sample_r
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
-            return RESULT_OPERATION_TIMEOUT;
+        const _u8 * payload;
+        if (IS_FAIL(ans = _scanner.read(_chanDev, header_size, payload, timeout))) {
+            return ans;
         }
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&rateInfo), sizeof(rateInfo));
+        memcpy(&rateInfo, payload, sizeof(rateInfo));
     }
     _cached_current_us_per_sample = rateInfo.express_sample_duration_us;
     return RESULT_OK;
@@ -2131,6 +2484,14 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
     support = false;
     
     if (!isConnected()) return RESULT_OPERATION_FAIL;
+
+    rp::hal::AutoLocker cl(_commandLock);
+
+    // probed on connect, keep the scan running
+    if (_isScanning) {
+        support = _isSupportingMotorCtrl;
+        return RESULT_OK;
+    }
     
     _disableDataGrabbing();
 
@@ -2159,11 +2520,12 @@ u_result RPlidarDriverImplCommon::checkMotorCtrlSupport(bool & support, _u32 tim
             return RESULT_INVALID_DATA;
         }
 
-        if (!_chanDev->waitfordata(header_size, timeout)) {
-            return RESULT_OPERATION_TIMEOUT;
+        const _u8 * payload;
+        if (IS_FAIL(ans = _scanner.read(_chanDev, header_size, payload, timeout))) {
+            return ans;
         }
         rplidar_response_acc_board_flag_t acc_board_flag;
-        _chanDev->recvdata(reinterpret_cast<_u8 *>(&acc_board_flag), sizeof(acc_board_flag));
+        memcpy(&acc_board_flag, payload, sizeof(acc_board_flag));
 
         if (acc_board_flag.support_flag & RPLIDAR_RESP_ACC_BOARD_FLAG_MOTOR_CTRL_SUPPORT_MASK) {
             support = true;
@@ -2205,23 +2567,99 @@ u_result RPlidarDriverImplCommon::setLidarSpinSpeed(_u16 rpm, _u32 timeout)
 
 u_result RPlidarDriverImplCommon::startMotor()
 {
+    u_result ans = startMotorAsync();
+    if (IS_FAIL(ans)) return ans;
+
+    if (!_isTofLidar) {
+        delay(500);
+    }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::startMotorAsync()
+{
+    // rotations measured before belong to the previous speed
+    _resetSpin();
+
     if (!_isTofLidar) {
         if (_isSupportingMotorCtrl) { // RPLIDAR A2
             setMotorPWM(DEFAULT_MOTOR_PWM);
-            delay(500);
             return RESULT_OK;
         }
         else { // RPLIDAR A1
             rp::hal::AutoLocker l(_lock);
             _chanDev->clearDTR();
-            delay(500);
             return RESULT_OK;
         }
     }
     else {
         setLidarSpinSpeed(600);//set default rpm to tof lidar
     }
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::setSpinCriterion(const RplidarSpinCriterion & criterion)
+{
+    if (criterion.min_frequency < 0 || criterion.tolerance < 0) return RESULT_INVALID_DATA;
+
+    rp::hal::AutoLocker l(_spinLock);
+    _spinMonitor.setCriterion(criterion);
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::getSpinState(bool & stable, float & frequency)
+{
+    rp::hal::AutoLocker l(_spinLock);
+    stable = _spinMonitor.stable();
+    frequency = _spinMonitor.frequency();
+    return RESULT_OK;
+}
+
+u_result RPlidarDriverImplCommon::waitSpinStable(float & frequency, _u32 timeout)
+{
+    _u32 startTs = getms();
+    _u32 waitTime;
+
+    for (;;) {
+        {
+            rp::hal::AutoLocker l(_spinLock);
+            frequency = _spinMonitor.frequency();
+            if (_spinMonitor.stable()) return RESULT_OK;
+        }
+        if (!_isScanning) return RESULT_OPERATION_FAIL;
+        if ((waitTime = getms() - startTs) >= timeout) return RESULT_OPERATION_TIMEOUT;
+
+        // bounded, so a scan stopping meanwhile is noticed
+        _u32 remaining = timeout - waitTime;
+        _spinEvent.wait(remaining < 100 ? remaining : 100);
+    }
+}
+
+void RPlidarDriverImplCommon::_resetSpin()
+{
+    rp::hal::AutoLocker l(_spinLock);
+    _spinMonitor.reset();
+}
+
+void RPlidarDriverImplCommon::_updateSpin(size_t count, float usPerSample, const ScanTiming & timing)
+{
+    // the samples of a rotation are evenly spaced by the device, fall back to the
+    // packet arrival times when the sample duration is unknown. A rotation that
+    // overflowed the scan buffer (count 0) is too slow to be measured.
+    float frequency = 0;
+    if (!count) {
+        // not measured
+    } else if (usPerSample > 0) {
+        frequency = 1000000.0f / (count * usPerSample);
+    } else if (timing.lastPacketUs > timing.firstPacketUs) {
+        frequency = 1000000.0f / (float)(timing.lastPacketUs - timing.firstPacketUs);
+    }
 
+    {
+        rp::hal::AutoLocker l(_spinLock);
+        _spinMonitor.update(frequency);
+    }
+    _spinEvent.set();
 }
 
 u_result RPlidarDriverImplCommon::stopMotor()
@@ -2242,14 +2680,95 @@ u_result RPlidarDriverImplCommon::stopMotor()
 void RPlidarDriverImplCommon::_disableDataGrabbing()
 {
     _isScanning = false;
+    if (_pumpActive) {
+        _iothread.join();
+        _iothread = rp::hal::Thread();
+    }
     _cachethread.join();
+    _cachethread = rp::hal::Thread();
+    _pumpActive = false;
+    if (_driver_options & DRIVER_OPTION_COMPACT_MEMORY) {
+        // idle drivers only keep the scans still queued or held by the application
+        _scanPool.trim();
+    }
+    // bytes still buffered belong to the stream being torn down
+    _chanDev->discardBuffered();
+    // command responses must not wait for a batch
+    _chanDev->setLowWaterMark(0);
+}
+
+void RPlidarDriverImplCommon::_applyRxLowWaterMark(size_t packetSize)
+{
+    _chanDev->setLowWaterMark(_rx_low_water_mark ? _rx_low_water_mark : packetSize);
+}
+
+u_result RPlidarDriverImplCommon::_nextPacket(const PacketFormat & fmt, const _u8 *& packet, bool & resynced, _u32 timeout)
+{
+    if (!_pumpActive) {
+        u_result ans = _scanner.next(_chanDev, fmt, packet, timeout);
+        resynced = IS_FAIL(ans) || _scanner.skippedBytes();
+        _lastPacketUs = IS_FAIL(ans) ? getus() : _chanDev->consumedRxUs();
+        return ans;
+    }
+
+    // decode pipeline: the I/O thread has framed and validated the packet already
+    const RawPacket * raw = _packetQueue.next(timeout);
+    if (!raw) {
+        resynced = true;
+        return RESULT_OPERATION_TIMEOUT;
+    }
+    packet = raw->data;
+    resynced = raw->resynced;
+    _lastPacketUs = raw->rxUs;
+    return RESULT_OK;
+}
+
+void RPlidarDriverImplCommon::_startPacketPump(const PacketFormat & fmt)
+{
+    _pumpActive = false;
+    if (!_decode_pipeline || fmt.size > RawPacket::MAX_PACKET_SIZE) return;
+
+    _packetQueue.reset();
+    _pumpFormat = &fmt;
+    _iothread = CLASS_THREAD(RPlidarDriverImplCommon, _pumpPackets);
+    if (_iothread.getHandle() == 0) return;
+
+    if (_io_cpu >= 0) _iothread.setAffinity(_io_cpu);
+    _pumpActive = true;
+}
+
+u_result RPlidarDriverImplCommon::_pumpPackets()
+{
+    const PacketFormat & fmt = *_pumpFormat;
+    bool resynced = true;
+
+    while (_isScanning) {
+        const _u8 * packet;
+        u_result ans = _scanner.next(_chanDev, fmt, packet, DEFAULT_TIMEOUT);
+        if (IS_FAIL(ans)) {
+            if (ans != RESULT_OPERATION_TIMEOUT) {
+                _isScanning = false;
+                break;
+            }
+            resynced = true;
+            continue;
+        }
+
+        if (_scanner.skippedBytes()) resynced = true;
+        // a dropped packet breaks continuity for the next one queued
+        resynced = !_packetQueue.push(packet, fmt.size, _chanDev->consumedRxUs(), resynced);
+    }
+    _packetQueue.close();
+    return RESULT_OK;
 }
 
 // Serial Driver Impl
 
-RPlidarDriverSerial::RPlidarDriverSerial() 
+RPlidarDriverSerial::RPlidarDriverSerial(size_t maxScanNodes, _u32 options)
+    : RPlidarDriverImplCommon(maxScanNodes, options)
 {
     _chanDev = new SerialChannelDevice();
+    _chanDev->setRecorder(&_recorder);
 }
 
 RPlidarDriverSerial::~RPlidarDriverSerial()
@@ -2263,6 +2782,9 @@ RPlidarDriverSerial::~RPlidarDriverSerial()
 
 void RPlidarDriverSerial::disconnect()
 {
+    // a health request may be running
+    _commandthread.join();
+    _commandthread = rp::hal::Thread();
     if (!_isConnected) return ;
     stop();
 }
@@ -2281,19 +2803,26 @@ u_result RPlidarDriverSerial::connect(const char * port_path, _u32 baudrate, _u3
             return RESULT_INVALID_DATA;
         }
         _chanDev->flush();
+        _chanDev->discardBuffered();
     }
 
+    // the device may have been replaced or updated meanwhile
+    _profileValid = false;
     _isConnected = true;
 
     checkMotorCtrlSupport(_isSupportingMotorCtrl);
-    stopMotor();
+    if (!(flag & CONNECT_FLAG_KEEP_MOTOR)) {
+        stopMotor();
+    }
 
     return RESULT_OK;
 }
 
-RPlidarDriverTCP::RPlidarDriverTCP() 
+RPlidarDriverTCP::RPlidarDriverTCP(size_t maxScanNodes, _u32 options)
+    : RPlidarDriverImplCommon(maxScanNodes, options)
 {
     _chanDev = new TCPChannelDevice();
+    _chanDev->setRecorder(&_recorder);
 }
 
 RPlidarDriverTCP::~RPlidarDriverTCP()
@@ -2304,6 +2833,9 @@ RPlidarDriverTCP::~RPlidarDriverTCP()
 
 void RPlidarDriverTCP::disconnect()
 {
+    // a health request may be running
+    _commandthread.join();
+    _commandthread = rp::hal::Thread();
     if (!_isConnected) return ;
     stop();
     _chanDev->close();
@@ -2321,12 +2853,74 @@ u_result RPlidarDriverTCP::connect(const char * ipStr, _u32 port, _u32 flag)
         // establish the serial connection...
         if(!_chanDev->bind(ipStr, port))
             return RESULT_INVALID_DATA;
+        _chanDev->discardBuffered();
+    }
+
+    // the device may have been replaced or updated meanwhile
+    _profileValid = false;
+    _isConnected = true;
+
+    checkMotorCtrlSupport(_isSupportingMotorCtrl);
+    if (!(flag & CONNECT_FLAG_KEEP_MOTOR)) {
+        stopMotor();
+    }
+
+    return RESULT_OK;
+}
+
+// Replay Driver Impl
+
+RPlidarDriverReplay::RPlidarDriverReplay(size_t maxScanNodes, _u32 options)
+    : RPlidarDriverImplCommon(maxScanNodes, options)
+{
+    // a replay would only record its own input again
+    _chanDev = new ReplayChannelDevice();
+}
+
+RPlidarDriverReplay::~RPlidarDriverReplay()
+{
+    // force disconnection
+    disconnect();
+    delete _chanDev;
+}
+
+u_result RPlidarDriverReplay::startRecording(const char * path)
+{
+    return RESULT_OPERATION_NOT_SUPPORT;
+}
+
+void RPlidarDriverReplay::disconnect()
+{
+    // a health request may be running
+    _commandthread.join();
+    _commandthread = rp::hal::Thread();
+    if (!_isConnected) return ;
+    stop();
+    _chanDev->close();
+}
+
+u_result RPlidarDriverReplay::connect(const char * path, _u32 mode, _u32 flag)
+{
+    if (isConnected()) return RESULT_ALREADY_DONE;
+
+    if (!_chanDev) return RESULT_INSUFFICIENT_MEMORY;
+
+    {
+        rp::hal::AutoLocker l(_lock);
+
+        // map the recording
+        if (!_chanDev->bind(path, mode))
+            return RESULT_INVALID_DATA;
+        _chanDev->discardBuffered();
     }
 
+    _profileValid = false;
     _isConnected = true;
 
     checkMotorCtrlSupport(_isSupportingMotorCtrl);
-    stopMotor();
+    if (!(flag & CONNECT_FLAG_KEEP_MOTOR)) {
+        stopMotor();
+    }
 
     return RESULT_OK;
 }
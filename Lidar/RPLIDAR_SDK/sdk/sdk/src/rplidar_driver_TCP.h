@@ -44,29 +44,58 @@ public:
 
     bool bind(const char * ipStr, uint32_t port)
     {
+        if (!_binded_socket) _binded_socket = rp::net::StreamSocket::CreateSocket();
+        if (!_binded_socket) return false;
         rp::net::SocketAddress socket(ipStr, port);
         return IS_OK(_binded_socket->connect(socket));
     }
     void close()
     {
-        _binded_socket->dispose();
+        if (_binded_socket) _binded_socket->dispose();
         _binded_socket = NULL;
     }
+
+    /// Wait until at least data_count bytes are queued on the socket or timeout ms have elapsed,
+    /// and report the number of bytes actually queued through returned_size.
     bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
     {
-        if(returned_size)
-            *returned_size = data_count;
-        return (_binded_socket->waitforData(timeout) == RESULT_OK);
+        _u32 startTs = getms();
+        _u32 waitTime;
+        size_t queued = 0;
+        bool ans = false;
+
+        while (_binded_socket) {
+            if (IS_FAIL(_binded_socket->getRecvQueueSize(queued))) break;
+            if (queued >= data_count) {
+                ans = true;
+                break;
+            }
+            if ((waitTime = getms() - startTs) >= timeout) break;
+
+            if (queued) {
+                // the socket stays readable while a partial packet is queued
+                delay(1);
+                continue;
+            }
+            u_result waitAns = _binded_socket->waitforData(timeout - waitTime);
+            if (IS_FAIL(waitAns) && waitAns != RESULT_OPERATION_TIMEOUT) break;
+        }
+
+        if (returned_size)
+            *returned_size = queued;
+        return ans;
     }
     int senddata(const _u8 * data, size_t size)
     {
         return _binded_socket->send(data, size) ;
     }
+
+    /// Receive up to size bytes straight into the caller's buffer. Never blocks.
     int recvdata(unsigned char * data, size_t size)
     {
-        size_t lenRec = 0;
-        _binded_socket->recv(data, size, lenRec);
-        return lenRec;
+        size_t received = 0;
+        if (!_binded_socket || IS_FAIL(_binded_socket->recvNoWait(data, size, received))) return 0;
+        return (int)received;
     }
 };
 
@@ -75,7 +104,7 @@ class RPlidarDriverTCP : public RPlidarDriverImplCommon
 {
 public:
 
-    RPlidarDriverTCP();
+    RPlidarDriverTCP(size_t maxScanNodes = MAX_SCAN_NODES, _u32 options = 0);
     virtual ~RPlidarDriverTCP();
     virtual u_result connect(const char * ipStr, _u32 port, _u32 flag = 0);
     virtual void disconnect();
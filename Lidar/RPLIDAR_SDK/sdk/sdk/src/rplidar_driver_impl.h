@@ -34,6 +34,9 @@
 
 #pragma once
 
+#include <string>
+#include <atomic>
+
 namespace rp { namespace standalone{ namespace rplidar {
     class RPlidarDriverImplCommon : public RPlidarDriver
 {
@@ -47,6 +50,8 @@ public:
     virtual u_result clearNetSerialRxCache();
     virtual u_result getAllSupportedScanModes(std::vector<RplidarScanMode>& outModes, _u32 timeoutInMs = DEFAULT_TIMEOUT);
     virtual u_result getTypicalScanMode(_u16& outMode, _u32 timeoutInMs = DEFAULT_TIMEOUT);
+    virtual u_result getDeviceProfile(RplidarDeviceProfile & profile, _u32 timeoutInMs = DEFAULT_TIMEOUT);
+    virtual u_result setDeviceProfileCacheDir(const char * path);
     virtual u_result checkSupportConfigCommands(bool& outSupport, _u32 timeoutInMs = DEFAULT_TIMEOUT);
 
     virtual u_result getScanModeCount(_u16& modeCount, _u32 timeoutInMs = DEFAULT_TIMEOUT);
@@ -61,6 +66,8 @@ public:
 
 
     virtual u_result getHealth(rplidar_response_device_health_t & health, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result getHealthAsync(RplidarHealthCallback callback, void * user_data = NULL, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result getLastScanGap(_u64 & gapUs);
     virtual u_result getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result checkIfTofLidar(bool & isTofLidar, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result getSampleDuration_uS(rplidar_response_sample_rate_t & rateInfo, _u32 timeout = DEFAULT_TIMEOUT);
@@ -68,6 +75,10 @@ public:
     virtual u_result setLidarSpinSpeed(_u16 rpm, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result startMotor();
     virtual u_result stopMotor();
+    virtual u_result startMotorAsync();
+    virtual u_result setSpinCriterion(const RplidarSpinCriterion & criterion);
+    virtual u_result getSpinState(bool & stable, float & frequency);
+    virtual u_result waitSpinStable(float & frequency, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result checkMotorCtrlSupport(bool & support, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result getFrequency(bool inExpressMode, size_t count, float & frequency, bool & is4kmode);
     virtual u_result getFrequency(const RplidarScanMode& scanMode, size_t count, float & frequency);
@@ -76,49 +87,142 @@ public:
     virtual u_result stop(_u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
     virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataHq(rplidar_response_measurement_node_hq_t * nodebuffer, _u64 * timestamp_us, size_t & count, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataGrid(float * ranges, _u8 * qualities, size_t bins, _u32 reduction, RplidarScanInfo & info, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result grabScanDataCartesian(float * x, float * y, float * quality, size_t & count, RplidarScanInfo & info, const RplidarTransform2D * transform = NULL, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result lendScanDataHq(RplidarScanView & view, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result releaseScanDataHq();
+    virtual u_result subscribeScans(_u32 & subscription, size_t backlog, RplidarScanCallback callback = NULL, void * user_data = NULL);
+    virtual u_result waitSubscribedScan(_u32 subscription, const RplidarScan *& scan, _u32 timeout = DEFAULT_TIMEOUT);
+    virtual u_result unsubscribeScans(_u32 subscription);
+    virtual u_result setScanQueueDepth(size_t depth);
+    virtual u_result setScanOverflowPolicy(_u32 policy);
+    virtual u_result setRxLowWaterMark(size_t bytes);
+    virtual u_result setDecodePipeline(bool enable, int ioCpu = -1, int decodeCpu = -1);
+    virtual u_result startRecording(const char * path);
+    virtual u_result stopRecording();
     virtual u_result ascendScanData(rplidar_response_measurement_node_t * nodebuffer, size_t count);
     virtual u_result ascendScanData(rplidar_response_measurement_node_hq_t * nodebuffer, size_t count);
+    virtual u_result ascendScanData(const rplidar_response_measurement_node_hq_t * nodebuffer, rplidar_response_measurement_node_hq_t * outbuffer, size_t count);
     virtual u_result getScanDataWithInterval(rplidar_response_measurement_node_t * nodebuffer, size_t & count);
     virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count);
+    virtual u_result getScanDataWithIntervalHq(rplidar_response_measurement_node_hq_t * nodebuffer, size_t & count, _u64 & dropped);
+    virtual u_result setIntervalOverflowPolicy(_u32 policy);
 
 protected:
 
     virtual u_result _sendCommand(_u8 cmd, const void * payload = NULL, size_t payloadsize = 0);
     void     _disableDataGrabbing();
+    void     _applyRxLowWaterMark(size_t packetSize);
 
     virtual u_result _waitResponseHeader(rplidar_ans_header_t * header, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result _cacheScanData();
-    virtual u_result _waitScanData(rplidar_response_measurement_node_t * nodebuffer, size_t & count, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result _waitNode(rplidar_response_measurement_node_t * node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual u_result  _cacheCapsuledScanData();
-    virtual u_result _waitCapsuledNode(rplidar_response_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual int _getSyncBitByAngle(const int current_angle_q16, const int angleInc_q16);
-    virtual void     _capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
-    virtual void     _dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+    template <class Policy>
+    u_result _ingestScanData();
+    struct NormalNodePolicy;
+    struct CapsulePolicy;
+    struct DenseCapsulePolicy;
+    struct UltraCapsulePolicy;
+    struct HqCapsulePolicy;
+
+    u_result _waitCapsuledNode(const rplidar_response_capsule_measurement_nodes_t *& node, _u32 timeout = DEFAULT_TIMEOUT);
+    int      _getSyncBitByAngle(const int current_angle_q16, const int angleInc_q16);
+    void     _capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+    void     _dense_capsuleToNormal(const rplidar_response_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
     
     //FW1.23
-    virtual u_result  _cacheUltraCapsuledScanData();
-    virtual u_result _waitUltraCapsuledNode(rplidar_response_ultra_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual void     _ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+    u_result _waitUltraCapsuledNode(const rplidar_response_ultra_capsule_measurement_nodes_t *& node, _u32 timeout = DEFAULT_TIMEOUT);
+    void     _ultraCapsuleToNormal(const rplidar_response_ultra_capsule_measurement_nodes_t & capsule, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+
+    u_result _waitHqNode(const rplidar_response_hq_capsule_measurement_nodes_t *& node, _u32 timeout = DEFAULT_TIMEOUT);
+    void     _HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+
+    u_result _getHealth(rplidar_response_device_health_t & health, _u64 & gapUs, _u32 timeout);
+    u_result _queryHealth(rplidar_response_device_health_t & health, _u32 timeout);
+    u_result _querySampleDuration(rplidar_response_sample_rate_t & rateInfo, _u32 timeout);
+    u_result _runHealthRequest();
+    bool     _pauseScan();
+    u_result _resumeScan(bool paused, _u64 & gapUs);
+
+    // the command sequences, called under _commandLock
+    u_result _startScan(bool force, bool useTypicalScan, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL);
+    u_result _startScanExpress(bool force, _u16 scanMode, _u32 options = 0, RplidarScanMode* outUsedScanMode = NULL, _u32 timeout = DEFAULT_TIMEOUT);
+    u_result _startScanNormal(bool force, _u32 timeout = DEFAULT_TIMEOUT);
+    u_result _stop(_u32 timeout = DEFAULT_TIMEOUT);
+    u_result _getSampleDuration_uS(rplidar_response_sample_rate_t & rateInfo, _u32 timeout = DEFAULT_TIMEOUT);
+    u_result _getDeviceInfo(rplidar_response_device_info_t & info, _u32 timeout = DEFAULT_TIMEOUT);
+    u_result _checkSupportConfigCommands(bool& outSupport, _u32 timeoutInMs = DEFAULT_TIMEOUT);
+
+    u_result _loadDeviceProfile(_u32 timeout);
+    u_result _fetchScanModes(RplidarDeviceProfile & profile, size_t depth, _u32 timeout);
+    u_result _sendConfQuery(_u32 type, const void * reserve, size_t reserveSize);
+    u_result _readConfAnswer(_u32 type, const _u8 *& payload, size_t & size, _u32 timeout);
+    void     _drainResponses(_u32 quietMs = 100);
+    const RplidarScanMode * _findScanMode(_u16 id) const;
 
-    virtual u_result  _cacheHqScanData();
-    virtual u_result _waitHqNode(rplidar_response_hq_capsule_measurement_nodes_t & node, _u32 timeout = DEFAULT_TIMEOUT);
-    virtual void     _HqToNormal(const rplidar_response_hq_capsule_measurement_nodes_t & node_hq, rplidar_response_measurement_node_hq_t *nodebuffer, size_t &nodeCount);
+    u_result _nextPacket(const PacketFormat & fmt, const _u8 *& packet, bool & resynced, _u32 timeout);
+    void     _startPacketPump(const PacketFormat & fmt);
+    u_result _pumpPackets();
+
+    void     _sizeScanBuffers(float usPerSample);
+    void     _resetSpin();
+    void     _updateSpin(size_t count, float usPerSample, const ScanTiming & timing);
+    PooledScan * _publishScan(PooledScan * scan, size_t count, const ScanTiming & timing);
+    ScanSubscription * _findSubscription(_u32 subscription);
 
     bool     _isConnected; 
     bool     _isScanning;
     bool     _isSupportingMotorCtrl;
     bool     _isTofLidar;
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf[8192];
-    size_t                                   _cached_scan_node_hq_count;
+    RplidarDeviceProfile                     _profile;
+    bool                                     _profileValid;
+    std::string                              _profileCacheDir;
+    size_t                                   _max_scan_nodes;
+    _u32                                     _driver_options;
+    ScanPool                                 _scanPool;
+    ScanRing                                 _scanRing;
+    bool                                     _scanLent;
+    rp::hal::Locker                          _grabLock;         // the scan ring has one consumer, serializes the grabScanData* callers
+    ScanGrid                                 _scanGrid;
+    StreamRecorder                           _recorder;
+    _u64                                     _nextScanSeq;
+    _u64                                     _truncatedScans;   // written by the cache thread only
+    std::vector<ScanSubscription *>          _subscriptions;
+    _u32                                     _nextSubscriptionId;
+    rp::hal::Locker                          _subscriptionLock;
+    PacketScanner                            _scanner;
+    PacketQueue                              _packetQueue;
+    const PacketFormat *                     _pumpFormat;
+    bool                                     _pumpActive;
+    _u64                                     _lastPacketUs;
+
+    _u32                                     _scanCommand;      // how the running scan was started, see _resumeScan
+    bool                                     _scanForce;
+    _u16                                     _scanModeId;
+    _u32                                     _scanOptions;
+    _u64                                     _pauseStartUs;
+    _u64                                     _lastScanGapUs;
+
+    std::atomic<bool>                        _healthBusy;
+    RplidarHealthCallback                    _healthCallback;
+    void *                                   _healthUserData;
+    _u32                                     _healthTimeout;
 
-    rplidar_response_measurement_node_hq_t   _cached_scan_node_hq_buf_for_interval_retrieve[8192];
-    size_t                                   _cached_scan_node_hq_count_for_interval_retrieve;
+    SpinMonitor                              _spinMonitor;
+    rp::hal::Locker                          _spinLock;
+    rp::hal::Event                           _spinEvent;        // set on every measured rotation
+
+    IntervalRing                             _intervalRing;
+    rp::hal::Locker                          _intervalLock;     // serializes the interval readers and resize
 
     _u16                    _cached_sampleduration_std;
     _u16                    _cached_sampleduration_express;
     _u8                     _cached_express_flag;
     float                   _cached_current_us_per_sample;
+    size_t                  _rx_low_water_mark;
+    bool                    _decode_pipeline;
+    int                     _io_cpu;
+    int                     _decode_cpu;
 
     rplidar_response_capsule_measurement_nodes_t _cached_previous_capsuledata;
     rplidar_response_dense_capsule_measurement_nodes_t _cached_previous_dense_capsuledata;
@@ -131,11 +235,36 @@ protected:
 	
 
     rp::hal::Locker         _lock;
-    rp::hal::Event          _dataEvt;
+    rp::hal::Locker         _commandLock;   // serializes the command sequences of the public entry points, never nested
     rp::hal::Thread _cachethread;
+    rp::hal::Thread _iothread;
+    rp::hal::Thread _commandthread;
 
 protected:
-    RPlidarDriverImplCommon();
-    virtual ~RPlidarDriverImplCommon() {}
+    enum {
+        // slowest rotation (Hz) the scan buffers are sized for, see CreateDriver()
+        MIN_SCAN_FREQUENCY = 2,
+        COMPACT_MIN_SCAN_FREQUENCY = 5,
+        COMPACT_SCAN_QUEUE_DEPTH = 2,
+    };
+
+    enum {
+        // configuration queries in flight while fetching the device profile
+        PROFILE_PIPELINE_DEPTH = 4,
+    };
+
+    enum {
+        // a paused stream is over once the line stays idle this long
+        STOP_QUIET_MS = 10,
+    };
+
+    enum {
+        SCAN_COMMAND_NONE    = 0,
+        SCAN_COMMAND_NORMAL  = 1,
+        SCAN_COMMAND_EXPRESS = 2,
+    };
+
+    RPlidarDriverImplCommon(size_t maxScanNodes = MAX_SCAN_NODES, _u32 options = 0);
+    virtual ~RPlidarDriverImplCommon();
 };
 }}}
\ No newline at end of file
@@ -0,0 +1,216 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Plays a recording (see rplidar_stream_record.h) back as a device, the file
+// memory mapped. The RX records are released in file order, at their recorded
+// pace or at once. A TX record holds the release back until the driver sends
+// the same command, so each answer comes after the command it answers; a
+// command recorded further on skips the records before it, and a command not
+// recorded at all gets no answer.
+class ReplayChannelDevice :public ChannelDevice
+{
+public:
+    ReplayChannelDevice()
+        : _fast(false)
+        , _readPos(0)
+        , _readOffset(0)
+        , _releasePos(0)
+        , _available(0)
+        , _anchorHostUs(0)
+        , _anchorRecordUs(0)
+    {}
+
+    // mode is REPLAY_REAL_TIME or REPLAY_FAST
+    bool bind(const char * path, uint32_t mode)
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (!_file.open(path)) return false;
+        if (_file.size() < STREAM_RECORD_FILE_HEADER
+            || memcmp(_file.data(), STREAM_RECORD_MAGIC, sizeof(STREAM_RECORD_MAGIC)) != 0) {
+            _file.close();
+            return false;
+        }
+
+        _fast = (mode == REPLAY_FAST);
+        _readPos = _releasePos = STREAM_RECORD_FILE_HEADER;
+        _readOffset = 0;
+        _available = 0;
+        StreamRecordHeader header;
+        _anchorRecordUs = _recordAt(_releasePos, header) ? header.timestamp_us : 0;
+        _anchorHostUs = getus();
+        return true;
+    }
+    void close()
+    {
+        rp::hal::AutoLocker l(_lock);
+        _file.close();
+        _available = 0;
+        _sent.set();
+    }
+
+    bool waitfordata(size_t data_count,_u32 timeout = -1, size_t * returned_size = NULL)
+    {
+        _u32 startTs = getms();
+        _u32 waitTime;
+        bool ans = false;
+
+        while (true) {
+            _u64 dueUs;
+            {
+                rp::hal::AutoLocker l(_lock);
+                dueUs = _release();
+                ans = _available >= data_count;
+                if (returned_size) *returned_size = _available;
+                if (ans) break;
+            }
+            if ((waitTime = getms() - startTs) >= timeout) break;
+
+            // sleep until the next record is due, or a command releases the gate
+            _u32 sleepMs = timeout - waitTime;
+            if (dueUs) {
+                _u64 now = getus();
+                _u32 dueMs = dueUs > now ? (_u32)((dueUs - now + 999) / 1000) : 0;
+                if (dueMs < sleepMs) sleepMs = dueMs;
+            }
+            if (sleepMs) _sent.wait(sleepMs);
+        }
+        return ans;
+    }
+
+    // one call carries one complete command packet, see _sendCommand()
+    int senddata(const _u8 * data, size_t size)
+    {
+        rp::hal::AutoLocker l(_lock);
+        size_t pos = _releasePos;
+        StreamRecordHeader header;
+        while (_recordAt(pos, header)) {
+            if (header.type == STREAM_RECORD_TX && header.size == size
+                && memcmp(_file.data() + pos + sizeof(header), data, size) == 0) {
+                if (pos != _releasePos) {
+                    // skipped ahead, the bytes not yet read belong to the skipped exchange
+                    _readPos = pos;
+                    _readOffset = 0;
+                    _available = 0;
+                }
+                _releasePos = pos + sizeof(header) + header.size;
+                _anchorRecordUs = header.timestamp_us;
+                _anchorHostUs = getus();
+                _sent.set();
+                break;
+            }
+            pos += sizeof(header) + header.size;
+        }
+        return (int)size;
+    }
+
+    int recvdata(unsigned char * data, size_t size)
+    {
+        rp::hal::AutoLocker l(_lock);
+        size_t copied = 0;
+        StreamRecordHeader header;
+        while (copied < size && _available) {
+            _recordAt(_readPos, header);
+            if (header.type != STREAM_RECORD_RX) {
+                _readPos += sizeof(header) + header.size;
+                continue;
+            }
+            size_t chunk = header.size - _readOffset;
+            if (chunk > size - copied) chunk = size - copied;
+            memcpy(data + copied, _file.data() + _readPos + sizeof(header) + _readOffset, chunk);
+            copied += chunk;
+            _available -= chunk;
+            _readOffset += chunk;
+            if (_readOffset == header.size) {
+                _readPos += sizeof(header) + header.size;
+                _readOffset = 0;
+            }
+        }
+        return (int)copied;
+    }
+
+protected:
+    // the complete record at pos, false past the last one
+    bool _recordAt(size_t pos, StreamRecordHeader & header) const
+    {
+        if (pos + sizeof(header) > _file.size()) return false;
+        memcpy(&header, _file.data() + pos, sizeof(header));
+        return header.size <= _file.size() - pos - sizeof(header);
+    }
+
+    // release the RX records that are due, returns the host time (us) the next
+    // one is due at, 0 when the gate or the end of the file is reached
+    _u64 _release()
+    {
+        StreamRecordHeader header;
+        while (_recordAt(_releasePos, header) && header.type != STREAM_RECORD_TX) {
+            if (header.type == STREAM_RECORD_RX && !_fast) {
+                _u64 dueUs = _anchorHostUs + (header.timestamp_us > _anchorRecordUs ? header.timestamp_us - _anchorRecordUs : 0);
+                if (dueUs > getus()) return dueUs;
+            }
+            if (header.type == STREAM_RECORD_RX) _available += header.size;
+            _releasePos += sizeof(header) + header.size;
+        }
+        return 0;
+    }
+
+    rp::hal::MappedFile _file;
+    rp::hal::Locker     _lock;
+    rp::hal::Event      _sent;
+    bool                _fast;
+    size_t              _readPos;       // record the next byte is read from
+    size_t              _readOffset;    // bytes of that record already read
+    size_t              _releasePos;    // first record not released yet
+    size_t              _available;     // bytes released and not read yet
+    _u64                _anchorHostUs;  // host time matching _anchorRecordUs, for the recorded pace
+    _u64                _anchorRecordUs;
+};
+
+
+class RPlidarDriverReplay : public RPlidarDriverImplCommon
+{
+public:
+
+    RPlidarDriverReplay(size_t maxScanNodes = MAX_SCAN_NODES, _u32 options = 0);
+    virtual ~RPlidarDriverReplay();
+    virtual u_result connect(const char * path, _u32 mode, _u32 flag = 0);
+    virtual void disconnect();
+    virtual u_result startRecording(const char * path);
+};
+
+}}}
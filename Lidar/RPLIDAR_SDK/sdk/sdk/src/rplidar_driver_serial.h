@@ -90,13 +90,17 @@ public:
     {
         rp::hal::serial_rxtx::ReleaseRxTx(_rxtxSerial);
     }
+    void setLowWaterMark(size_t bytes)
+    {
+        _rxtxSerial->setLowWaterMark(bytes);
+    }
 };
 
 class RPlidarDriverSerial : public RPlidarDriverImplCommon
 {
 public:
 
-    RPlidarDriverSerial();
+    RPlidarDriverSerial(size_t maxScanNodes = MAX_SCAN_NODES, _u32 options = 0);
     virtual ~RPlidarDriverSerial();
     virtual u_result connect(const char * port_path,  _u32 baudrate, _u32 flag = 0);
     virtual void disconnect();
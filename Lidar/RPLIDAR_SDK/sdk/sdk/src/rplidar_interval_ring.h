@@ -0,0 +1,187 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Lock-free single-producer/single-consumer ring of the nodes handed out by
+// getScanDataWithInterval*().
+//
+// The cache thread appends every decoded batch, the interval caller takes
+// nodes out; both copy in at most two segments around the wrap. Positions
+// are free-running counters, only their difference is meaningful.
+//
+// With DROP_NEWEST a full ring keeps its oldest nodes and the producer
+// discards what does not fit. With DROP_OLDEST the producer always writes
+// and the consumer skips what was overwritten. The producer claims the
+// positions before writing them, so a consumer whose copy raced with an
+// overwrite notices it afterwards and copies again from the oldest node
+// still intact.
+class IntervalRing
+{
+public:
+    enum {
+        DROP_NEWEST = 0,
+        DROP_OLDEST = 1,
+    };
+
+    IntervalRing()
+        : _capacity(0)
+        , _policy(DROP_NEWEST)
+        , _head(0)
+        , _claimed(0)
+        , _tail(0)
+        , _dropped(0)
+    {
+    }
+
+    // (Re)allocate the ring, keeping the pending nodes that fit. Must not be
+    // called while a producer or a consumer is active.
+    void resize(size_t capacity)
+    {
+        std::vector<rplidar_response_measurement_node_hq_t> storage(capacity);
+        size_t pending = capacity ? pop(&storage[0], capacity) : 0;
+
+        _storage.swap(storage);
+        _capacity = capacity;
+        _tail.store(0);
+        _claimed.store(pending);
+        _head.store(pending);
+    }
+
+    // Must not be called while a producer is active.
+    void setPolicy(int policy) { _policy = policy; }
+
+    size_t capacity() const { return _capacity; }
+    int    policy() const { return _policy; }
+    _u64   droppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // Nodes waiting for the consumer, a hint only while the producer runs.
+    size_t pending() const
+    {
+        size_t queued = _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+        return queued < _capacity ? queued : _capacity;
+    }
+
+    // -- producer side --
+
+    void push(const rplidar_response_measurement_node_hq_t * nodes, size_t count)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        if (_policy == DROP_OLDEST) {
+            if (count > _capacity) {
+                _dropped.fetch_add(count - _capacity, std::memory_order_relaxed);
+                nodes += count - _capacity;
+                count = _capacity;
+            }
+        } else {
+            size_t queued = head - _tail.load(std::memory_order_acquire);
+            size_t room = queued < _capacity ? _capacity - queued : 0;
+            if (count > room) {
+                _dropped.fetch_add(count - room, std::memory_order_relaxed);
+                count = room;
+            }
+        }
+        if (!count) return;
+
+        _claimed.store(head + count, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _copyIn(head, nodes, count);
+        _head.store(head + count, std::memory_order_release);
+    }
+
+    // -- consumer side --
+
+    // Take out up to count of the oldest nodes, returns the number taken.
+    size_t pop(rplidar_response_measurement_node_hq_t * nodes, size_t count)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        size_t taken;
+
+        while (true) {
+            size_t head = _head.load(std::memory_order_acquire);
+            size_t claimed = _claimed.load(std::memory_order_relaxed);
+            if (claimed - tail > _capacity) {
+                // overwritten, or about to be, by a DROP_OLDEST producer
+                _dropped.fetch_add(claimed - _capacity - tail, std::memory_order_relaxed);
+                tail = claimed - _capacity;
+            }
+
+            taken = head - tail;
+            if (taken > count) taken = count;
+            _copyOut(tail, nodes, taken);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_claimed.load(std::memory_order_relaxed) - tail <= _capacity) break;
+        }
+
+        _tail.store(tail + taken, std::memory_order_release);
+        return taken;
+    }
+
+protected:
+    void _copyIn(size_t pos, const rplidar_response_measurement_node_hq_t * nodes, size_t count)
+    {
+        size_t index = pos % _capacity;
+        size_t first = _capacity - index < count ? _capacity - index : count;
+        memcpy(&_storage[index], nodes, first * sizeof(rplidar_response_measurement_node_hq_t));
+        memcpy(&_storage[0], nodes + first, (count - first) * sizeof(rplidar_response_measurement_node_hq_t));
+    }
+
+    void _copyOut(size_t pos, rplidar_response_measurement_node_hq_t * nodes, size_t count) const
+    {
+        if (!count) return;
+        size_t index = pos % _capacity;
+        size_t first = _capacity - index < count ? _capacity - index : count;
+        memcpy(nodes, &_storage[index], first * sizeof(rplidar_response_measurement_node_hq_t));
+        memcpy(nodes + first, &_storage[0], (count - first) * sizeof(rplidar_response_measurement_node_hq_t));
+    }
+
+    std::vector<rplidar_response_measurement_node_hq_t> _storage;
+    size_t               _capacity;
+    int                  _policy;
+
+    std::atomic<size_t>  _head;     // published by the producer
+    std::atomic<size_t>  _claimed;  // being written by the producer, >= _head
+    std::atomic<size_t>  _tail;     // written by the consumer only
+    std::atomic<_u64>    _dropped;
+};
+
+}}}
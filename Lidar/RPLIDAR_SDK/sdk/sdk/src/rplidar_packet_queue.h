@@ -0,0 +1,170 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <string.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// One validated answer packet, copied out of the channel by the I/O thread.
+struct RawPacket {
+    enum {
+        MAX_PACKET_SIZE = 144, // the largest answer packet is the 141 byte HQ capsule
+    };
+
+    _u64 rxUs;      // host time the read carrying the end of the packet returned
+    bool resynced;  // the stream lost continuity right before this packet
+    _u8  data[MAX_PACKET_SIZE];
+};
+
+// Lock-free single-producer/single-consumer queue of raw packets, the hand-off
+// between the I/O thread and the decode thread of the decode pipeline.
+//
+// The I/O thread only frames and validates packets, so it gets back to the
+// device quickly; decode spikes are absorbed by the queue instead of the
+// kernel receive buffer. When the queue is full the newest packet is dropped
+// and the next one queued is flagged as resynced.
+class PacketQueue
+{
+public:
+    enum {
+        DEPTH = 512, // power of two
+    };
+
+    PacketQueue()
+        : _head(0)
+        , _tail(0)
+        , _reading(false)
+        , _closed(false)
+        , _waiting(false)
+        , _dropped(0)
+    {
+    }
+
+    // Empty the queue and reopen it. Must not be called while a producer or a consumer is active.
+    void reset()
+    {
+        if (_slots.empty()) _slots.resize(DEPTH);
+        _head.store(0);
+        _tail.store(0);
+        _reading = false;
+        _closed.store(false);
+    }
+
+    _u64 droppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // -- producer side --
+
+    // Copy a packet in. Returns false when the queue is full and the packet was dropped.
+    bool push(const _u8 * packet, size_t size, _u64 rxUs, bool resynced)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= DEPTH || size > RawPacket::MAX_PACKET_SIZE) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        RawPacket & slot = _slots[head & (DEPTH - 1)];
+        slot.rxUs = rxUs;
+        slot.resynced = resynced;
+        memcpy(slot.data, packet, size);
+
+        _head.store(head + 1, std::memory_order_seq_cst);
+        _wake();
+        return true;
+    }
+
+    // No more packets will be pushed; lets the consumer return at once instead of timing out.
+    void close()
+    {
+        _closed.store(true, std::memory_order_seq_cst);
+        _wake();
+    }
+
+    // -- consumer side --
+
+    // Release the packet returned by the previous call and wait up to timeout ms
+    // for the next one. Returns NULL on timeout, or when the queue is closed and drained.
+    const RawPacket * next(_u32 timeout)
+    {
+        _u32 startTs = getms();
+        _u32 waitTime;
+
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (_reading) {
+            _tail.store(++tail, std::memory_order_release);
+            _reading = false;
+        }
+
+        while (true) {
+            if (_head.load(std::memory_order_acquire) != tail) {
+                _reading = true;
+                return &_slots[tail & (DEPTH - 1)];
+            }
+
+            if (_closed.load(std::memory_order_acquire)) return NULL;
+            if ((waitTime = getms() - startTs) >= timeout) return NULL;
+
+            _waiting.store(true, std::memory_order_seq_cst);
+            if (_head.load(std::memory_order_seq_cst) == tail && !_closed.load(std::memory_order_seq_cst)) {
+                _evt.wait(timeout == 0xFFFFFFFF ? timeout : timeout - waitTime);
+            }
+            _waiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+protected:
+    void _wake()
+    {
+        if (_waiting.load(std::memory_order_seq_cst)) {
+            _evt.set();
+        }
+    }
+
+    std::vector<RawPacket> _slots;
+
+    std::atomic<size_t>  _head;     // written by the producer only
+    std::atomic<size_t>  _tail;     // written by the consumer only
+    bool                 _reading;  // consumer holds the slot at _tail
+    std::atomic<bool>    _closed;
+    std::atomic<bool>    _waiting;  // consumer is parked on _evt
+    std::atomic<_u64>    _dropped;
+
+    rp::hal::Event       _evt;
+};
+
+}}}
@@ -0,0 +1,206 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RPLIDAR_SCANNER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RPLIDAR_SCANNER_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Framing description of one answer type: the packet size, the two leading
+// sync fields (matched as (byte & mask) == value) and an optional in-place
+// validator (checksum, crc, check bits) run on a complete candidate packet.
+struct PacketFormat {
+    size_t size;
+    _u8    syncMask[2];
+    _u8    syncValue[2];
+    bool   (*validate)(const _u8 * packet);
+};
+
+// Resynchronizing packet scanner shared by all answer types.
+//
+// Packets are framed in place in the read-ahead buffer of the channel, which
+// is filled in large blocks. Sync candidates are located with a vectorized
+// search, validated in place, and handed out as pointers into that buffer.
+// A returned packet stays valid until the next call on the scanner.
+class PacketScanner
+{
+public:
+    PacketScanner()
+        : _skipped(0)
+    {
+    }
+
+    // Number of bytes discarded by the last call to next() before the returned
+    // packet was found. Non-zero means the stream lost continuity.
+    size_t skippedBytes() const
+    {
+        return _skipped;
+    }
+
+    // Locate the next valid packet of the given format.
+    // Returns RESULT_OK with packet pointing into the channel buffer, or
+    // RESULT_OPERATION_TIMEOUT if the channel did not deliver enough data in time.
+    u_result next(ChannelDevice * chan, const PacketFormat & fmt, const _u8 *& packet, _u32 timeout)
+    {
+        _u32 startTs = getms();
+        _u32 waitTime;
+
+        _skipped = 0;
+        if (fmt.size < 2 || fmt.size > ChannelDevice::READ_AHEAD_SIZE) return RESULT_INVALID_DATA;
+
+        for (;;) {
+            const _u8 * data;
+            size_t available;
+
+            // returns at once when a whole packet is already buffered
+            if ((waitTime = getms() - startTs) > timeout) break;
+            if (!chan->peek(fmt.size, data, available, timeout - waitTime)) break;
+
+            while (available >= 2) {
+                size_t pos = _findSync(fmt, data, available);
+                chan->consume(pos);
+                _skipped += pos;
+                data += pos;
+                available -= pos;
+                if (available < fmt.size) break;
+
+                if (!fmt.validate || fmt.validate(data)) {
+                    chan->consume(fmt.size);
+                    packet = data;
+                    return RESULT_OK;
+                }
+                // false sync or corrupted packet, slide by one byte and keep searching
+                chan->consume(1);
+                ++_skipped;
+                ++data;
+                --available;
+            }
+        }
+        return RESULT_OPERATION_TIMEOUT;
+    }
+
+    // Consume exactly size bytes (e.g. a response payload following its header).
+    u_result read(ChannelDevice * chan, size_t size, const _u8 *& data, _u32 timeout)
+    {
+        size_t available;
+
+        if (size > ChannelDevice::READ_AHEAD_SIZE) return RESULT_INVALID_DATA;
+        if (!chan->peek(size, data, available, timeout)) return RESULT_OPERATION_TIMEOUT;
+        chan->consume(size);
+        return RESULT_OK;
+    }
+
+protected:
+    static bool _isSync(const PacketFormat & fmt, const _u8 * p)
+    {
+        return (p[0] & fmt.syncMask[0]) == fmt.syncValue[0]
+            && (p[1] & fmt.syncMask[1]) == fmt.syncValue[1];
+    }
+
+    static unsigned _lowestBit(_u32 mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long idx;
+        _BitScanForward(&idx, mask);
+        return (unsigned)idx;
+#else
+        return (unsigned)__builtin_ctz(mask);
+#endif
+    }
+
+    // Offset of the first sync candidate in buf[0, size), size >= 2. When none
+    // is found, the last byte is kept if it may start a sync pair.
+    static size_t _findSync(const PacketFormat & fmt, const _u8 * buf, size_t size)
+    {
+        size_t pos = 0;
+        const size_t last = size - 1;
+
+        // fast path: the stream is in sync
+        if (_isSync(fmt, buf)) return pos;
+        ++pos;
+
+#if defined(RPLIDAR_SCANNER_SSE2)
+        const __m128i mask0 = _mm_set1_epi8((char)fmt.syncMask[0]);
+        const __m128i mask1 = _mm_set1_epi8((char)fmt.syncMask[1]);
+        const __m128i val0  = _mm_set1_epi8((char)fmt.syncValue[0]);
+        const __m128i val1  = _mm_set1_epi8((char)fmt.syncValue[1]);
+        for (; pos + 16 < size; pos += 16) {
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + pos));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buf + pos + 1));
+            __m128i hit = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(b0, mask0), val0),
+                                        _mm_cmpeq_epi8(_mm_and_si128(b1, mask1), val1));
+            int bits = _mm_movemask_epi8(hit);
+            if (bits) return pos + _lowestBit((_u32)bits);
+        }
+#elif defined(RPLIDAR_SCANNER_NEON)
+        const uint8x16_t mask0 = vdupq_n_u8(fmt.syncMask[0]);
+        const uint8x16_t mask1 = vdupq_n_u8(fmt.syncMask[1]);
+        const uint8x16_t val0  = vdupq_n_u8(fmt.syncValue[0]);
+        const uint8x16_t val1  = vdupq_n_u8(fmt.syncValue[1]);
+        for (; pos + 16 < size; pos += 16) {
+            uint8x16_t b0 = vld1q_u8(buf + pos);
+            uint8x16_t b1 = vld1q_u8(buf + pos + 1);
+            uint8x16_t hit = vandq_u8(vceqq_u8(vandq_u8(b0, mask0), val0),
+                                      vceqq_u8(vandq_u8(b1, mask1), val1));
+            // narrow every byte lane to a nibble so the match mask fits in 64 bits
+            uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+            if (bits) {
+                unsigned idx = (bits & 0xFFFFFFFFu) ? _lowestBit((_u32)bits) : 32 + _lowestBit((_u32)(bits >> 32));
+                return pos + (idx >> 2);
+            }
+        }
+#endif
+        for (; pos < last; ++pos) {
+            if (_isSync(fmt, buf + pos)) return pos;
+        }
+        return ((buf[last] & fmt.syncMask[0]) == fmt.syncValue[0]) ? last : size;
+    }
+
+    size_t _skipped;
+};
+
+}}}
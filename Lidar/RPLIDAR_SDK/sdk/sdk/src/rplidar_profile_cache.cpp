@@ -0,0 +1,137 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "sdkcommon.h"
+#include "rplidar_profile_cache.h"
+
+#include <stdio.h>
+#include <string>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+enum {
+    PROFILE_MAGIC   = 0x46505052, // "RPPF"
+    PROFILE_VERSION = 1,
+    PROFILE_MAX_MODES = 256,
+};
+
+static std::string profilePath(const char * dir, const rplidar_response_device_info_t & info)
+{
+    char name[64];
+    int len = sprintf(name, "rplidar_");
+    for (size_t pos = 0; pos < sizeof(info.serialnum); ++pos) {
+        len += sprintf(name + len, "%02X", info.serialnum[pos]);
+    }
+    sprintf(name + len, "_%04X.profile", info.firmware_version);
+
+    std::string path(dir);
+    if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') {
+        path += '/';
+    }
+    return path + name;
+}
+
+template <class T>
+static bool readField(FILE * file, T & value)
+{
+    return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+template <class T>
+static bool writeField(FILE * file, const T & value)
+{
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+bool loadDeviceProfile(const char * dir, RplidarDeviceProfile & profile)
+{
+    FILE * file = fopen(profilePath(dir, profile.info).c_str(), "rb");
+    if (!file) return false;
+
+    _u32 magic = 0, version = 0;
+    _u8  confSupported = 0;
+    _u16 typicalMode = 0, modeCount = 0;
+    bool ok = readField(file, magic) && magic == PROFILE_MAGIC
+        && readField(file, version) && version == PROFILE_VERSION
+        && readField(file, confSupported)
+        && readField(file, typicalMode)
+        && readField(file, modeCount) && modeCount <= PROFILE_MAX_MODES;
+
+    std::vector<RplidarScanMode> modes(ok ? modeCount : 0);
+    for (size_t pos = 0; ok && pos < modes.size(); ++pos) {
+        RplidarScanMode & mode = modes[pos];
+        ok = readField(file, mode.id)
+            && readField(file, mode.us_per_sample)
+            && readField(file, mode.max_distance)
+            && readField(file, mode.ans_type)
+            && readField(file, mode.scan_mode);
+        mode.scan_mode[sizeof(mode.scan_mode) - 1] = 0;
+    }
+    fclose(file);
+    if (!ok) return false;
+
+    profile.conf_supported = confSupported != 0;
+    profile.typical_mode = typicalMode;
+    profile.modes.swap(modes);
+    return true;
+}
+
+bool saveDeviceProfile(const char * dir, const RplidarDeviceProfile & profile)
+{
+    FILE * file = fopen(profilePath(dir, profile.info).c_str(), "wb");
+    if (!file) return false;
+
+    _u32 magic = PROFILE_MAGIC, version = PROFILE_VERSION;
+    _u8  confSupported = profile.conf_supported ? 1 : 0;
+    _u16 modeCount = (_u16)profile.modes.size();
+    bool ok = writeField(file, magic)
+        && writeField(file, version)
+        && writeField(file, confSupported)
+        && writeField(file, profile.typical_mode)
+        && writeField(file, modeCount);
+
+    for (size_t pos = 0; ok && pos < profile.modes.size(); ++pos) {
+        const RplidarScanMode & mode = profile.modes[pos];
+        ok = writeField(file, mode.id)
+            && writeField(file, mode.us_per_sample)
+            && writeField(file, mode.max_distance)
+            && writeField(file, mode.ans_type)
+            && writeField(file, mode.scan_mode);
+    }
+    // a short file is rejected by loadDeviceProfile and fetched again
+    if (fclose(file) != 0) ok = false;
+    return ok;
+}
+
+}}}
@@ -0,0 +1,246 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Host timestamps of the decoded samples.
+//
+// The samples of a packet are measured before the packet is sent, so the last
+// one is stamped with the packet arrival time (the receive time of the read that
+// delivered it) and the earlier ones are spread backwards, one sample duration
+// apart. The sample duration starts from the nominal value of the scan mode and
+// follows the average spacing of the reads observed on the host, which also covers
+// an unknown or stale nominal value.
+class SampleTimestamper
+{
+public:
+    enum {
+        RATE_SMOOTHING = 64,    // packets averaged by the sample duration estimate
+    };
+
+    SampleTimestamper()
+        : _usPerSample(0)
+        , _lastArrivalUs(0)
+        , _burstUs(0)
+        , _burstSamples(0)
+    {
+    }
+
+    // Start a new sample stream. usPerSample is the nominal sample duration, 0 if unknown.
+    void reset(float usPerSample)
+    {
+        _usPerSample = usPerSample > 0 ? usPerSample : 0;
+        _lastArrivalUs = 0;
+        _burstUs = 0;
+        _burstSamples = 0;
+    }
+
+    float usPerSample() const { return _usPerSample; }
+
+    // Stamp the count samples carried by a packet that arrived at arrivalUs.
+    void stamp(_u64 arrivalUs, size_t count, _u64 * timestamps)
+    {
+        if (!count) return;
+
+        // packets taken from one read share its arrival time. The time since the
+        // previous read covers the samples of all of them, so a read is only
+        // accounted once the next one shows up.
+        if (arrivalUs != _burstUs) {
+            if (_lastArrivalUs && _burstUs > _lastArrivalUs) {
+                float observed = (float)(_burstUs - _lastArrivalUs) / _burstSamples;
+                _usPerSample = _usPerSample > 0 ? _usPerSample + (observed - _usPerSample) / RATE_SMOOTHING : observed;
+            }
+            _lastArrivalUs = _burstUs;
+            _burstUs = arrivalUs;
+            _burstSamples = 0;
+        }
+        _burstSamples += count;
+
+        for (size_t pos = 0; pos < count; ++pos) {
+            timestamps[pos] = arrivalUs - (_u64)((count - 1 - pos) * _usPerSample);
+        }
+    }
+
+protected:
+    float  _usPerSample;
+    _u64   _lastArrivalUs;  // arrival of the read before _burstUs
+    _u64   _burstUs;        // arrival of the latest read
+    size_t _burstSamples;   // samples stamped with _burstUs so far
+};
+
+// Online model of the device clock of the HQ capsules against the host monotonic clock:
+// host = hostRef + offset + drift * (device - deviceRef).
+//
+// Arrival times are the device times converted to host time plus a latency that is never
+// negative and jitters by milliseconds behind USB-serial buffering, so the model follows
+// the lower envelope of the arrivals:
+// - the arrival with the smallest latency of each WINDOW_US period is kept, and the
+//   drift is the least squares slope of the last WINDOWS of them;
+// - the offset is lowered at once by any arrival earlier than the model predicts.
+// Device timestamps going backwards or arrivals more than MAX_ERROR_US away from the
+// fitted prediction (device reset, stalled stream) restart the model. Device ticks are
+// expected in microseconds; the drift absorbs a rate mismatch.
+class DeviceClockSync
+{
+public:
+    enum {
+        WINDOW_US    = 1000000,
+        WINDOWS      = 16,
+        MAX_ERROR_US = 500000,
+    };
+
+    DeviceClockSync()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        _hasRef = false;
+        _deviceRef = _hostRef = _lastDevice = 0;
+        _offset = 0;
+        _drift = 1;
+        _windowCount = _windowNext = 0;
+        _windowStart = 0;
+        _bestX = _bestY = 0;
+        _hasBest = false;
+    }
+
+    double drift() const { return _drift; }
+
+    // Account for a packet carrying deviceTs that arrived at arrivalUs and return the
+    // host time of deviceTs.
+    _u64 update(_u64 deviceTs, _u64 arrivalUs)
+    {
+        if (_hasRef) {
+            // the prediction is only trusted once a drift has been fitted
+            double error = (double)(_s64)(arrivalUs - _hostRef) - _predict(deviceTs);
+            bool lost = _windowCount >= 2 && (error > MAX_ERROR_US || error < -MAX_ERROR_US);
+            if (deviceTs < _lastDevice || lost) {
+                reset();
+            }
+        }
+        if (!_hasRef) {
+            _hasRef = true;
+            _deviceRef = deviceTs;
+            _hostRef = arrivalUs;
+            _windowStart = 0;
+        }
+        _lastDevice = deviceTs;
+
+        double x = (double)(deviceTs - _deviceRef);
+        double y = (double)(_s64)(arrivalUs - _hostRef);
+
+        // the arrival with the smallest latency of the current window
+        if (!_hasBest || y - x < _bestY - _bestX) {
+            _bestX = x;
+            _bestY = y;
+            _hasBest = true;
+        }
+        if (y - _windowStart >= WINDOW_US) {
+            _closeWindow();
+            _windowStart = y;
+        }
+
+        double latency = y - (_offset + _drift * x);
+        if (latency < 0) _offset += latency;
+
+        return toHost(deviceTs);
+    }
+
+    _u64 toHost(_u64 deviceTs) const
+    {
+        return _hostRef + (_s64)(_predict(deviceTs) + 0.5);
+    }
+
+protected:
+    double _predict(_u64 deviceTs) const
+    {
+        return _offset + _drift * (double)(_s64)(deviceTs - _deviceRef);
+    }
+
+    void _closeWindow()
+    {
+        _windowX[_windowNext] = _bestX;
+        _windowY[_windowNext] = _bestY;
+        _windowNext = (_windowNext + 1) % WINDOWS;
+        if (_windowCount < WINDOWS) ++_windowCount;
+        _hasBest = false;
+
+        if (_windowCount >= 2) {
+            double mx = 0, my = 0;
+            for (size_t pos = 0; pos < _windowCount; ++pos) {
+                mx += _windowX[pos];
+                my += _windowY[pos];
+            }
+            mx /= _windowCount;
+            my /= _windowCount;
+
+            double sxx = 0, sxy = 0;
+            for (size_t pos = 0; pos < _windowCount; ++pos) {
+                sxx += (_windowX[pos] - mx) * (_windowX[pos] - mx);
+                sxy += (_windowX[pos] - mx) * (_windowY[pos] - my);
+            }
+            if (sxx > 0) _drift = sxy / sxx;
+        }
+
+        // the tightest offset under the window minima
+        double offset = _windowY[0] - _drift * _windowX[0];
+        for (size_t pos = 1; pos < _windowCount; ++pos) {
+            double candidate = _windowY[pos] - _drift * _windowX[pos];
+            if (candidate < offset) offset = candidate;
+        }
+        _offset = offset;
+    }
+
+    bool   _hasRef;
+    _u64   _deviceRef;
+    _u64   _hostRef;
+    _u64   _lastDevice;
+    double _offset;
+    double _drift;
+
+    double _windowX[WINDOWS];
+    double _windowY[WINDOWS];
+    size_t _windowCount;
+    size_t _windowNext;
+    double _windowStart;
+    double _bestX;
+    double _bestY;
+    bool   _hasBest;
+};
+
+}}}
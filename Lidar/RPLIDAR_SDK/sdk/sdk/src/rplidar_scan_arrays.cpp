@@ -0,0 +1,140 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_scan_arrays.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RPLIDAR_ARRAYS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RPLIDAR_ARRAYS_NEON
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+namespace {
+
+// a q14 angle has 16 significant bits, the round trip through float rounds back to it
+const float RAD_PER_Q14 = (float)(2 * 3.14159265358979323846 / 65536);
+const float Q14_PER_RAD = (float)(65536 / (2 * 3.14159265358979323846));
+
+}
+
+void scan_to_arrays(const rplidar_response_measurement_node_hq_t * nodes, size_t count,
+                    float * angle_rad, float * range_mm, _u8 * quality, _u8 * flag)
+{
+    size_t pos = 0;
+#if defined(RPLIDAR_ARRAYS_SSE2)
+    // two packed 8 byte nodes per register: angle in bits 0-15, distance in bits 16-47,
+    // quality and flag in bits 48-63 of each 64 bit lane
+    const __m128i low16 = _mm_set1_epi32(0xFFFF);
+    const __m128 rad = _mm_set1_ps(RAD_PER_Q14);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    const __m128 upper = _mm_set1_ps(65536.0f);
+    for (; pos + 4 <= count; pos += 4) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(nodes + pos));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(nodes + pos + 2));
+
+        // the low 32 bits of the four lanes, in node order
+        __m128i angle = _mm_unpacklo_epi64(_mm_shuffle_epi32(v0, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(v1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i dist = _mm_unpacklo_epi64(_mm_shuffle_epi32(_mm_srli_epi64(v0, 16), _MM_SHUFFLE(2, 0, 2, 0)),
+                                          _mm_shuffle_epi32(_mm_srli_epi64(v1, 16), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i tail = _mm_unpacklo_epi64(_mm_shuffle_epi32(_mm_srli_epi64(v0, 48), _MM_SHUFFLE(2, 0, 2, 0)),
+                                          _mm_shuffle_epi32(_mm_srli_epi64(v1, 48), _MM_SHUFFLE(2, 0, 2, 0)));
+
+        _mm_storeu_ps(angle_rad + pos, _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(angle, low16)), rad));
+        // unsigned distance, converted as two 16 bit halves
+        __m128 range = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(dist, 16)), upper), _mm_cvtepi32_ps(_mm_and_si128(dist, low16)));
+        _mm_storeu_ps(range_mm + pos, _mm_mul_ps(range, quarter));
+
+        // quality in the low byte of each 16 bit tail, flag in the high byte; sign extended
+        // first, the signed pack would saturate the tails with a flag of 0x80 or more
+        __m128i packed = _mm_srai_epi32(_mm_slli_epi32(tail, 16), 16);
+        packed = _mm_packs_epi32(packed, packed);
+        if (quality) {
+            int q = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_and_si128(packed, _mm_set1_epi16(0xFF)), packed));
+            memcpy(quality + pos, &q, 4);
+        }
+        if (flag) {
+            int f = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_srli_epi16(packed, 8), packed));
+            memcpy(flag + pos, &f, 4);
+        }
+    }
+#elif defined(RPLIDAR_ARRAYS_NEON)
+    // the 8 byte nodes as four 16 bit fields: angle, distance low, distance high, quality | flag << 8
+    const float32x4_t rad = vdupq_n_f32(RAD_PER_Q14);
+    const float32x4_t quarter = vdupq_n_f32(0.25f);
+    for (; pos + 8 <= count; pos += 8) {
+        uint16x8x4_t v = vld4q_u16(reinterpret_cast<const uint16_t *>(nodes + pos));
+
+        vst1q_f32(angle_rad + pos, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v.val[0]))), rad));
+        vst1q_f32(angle_rad + pos + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v.val[0]))), rad));
+
+        uint32x4_t dist0 = vorrq_u32(vmovl_u16(vget_low_u16(v.val[1])), vshlq_n_u32(vmovl_u16(vget_low_u16(v.val[2])), 16));
+        uint32x4_t dist1 = vorrq_u32(vmovl_u16(vget_high_u16(v.val[1])), vshlq_n_u32(vmovl_u16(vget_high_u16(v.val[2])), 16));
+        vst1q_f32(range_mm + pos, vmulq_f32(vcvtq_f32_u32(dist0), quarter));
+        vst1q_f32(range_mm + pos + 4, vmulq_f32(vcvtq_f32_u32(dist1), quarter));
+
+        if (quality) vst1_u8(quality + pos, vmovn_u16(v.val[3]));
+        if (flag) vst1_u8(flag + pos, vshrn_n_u16(v.val[3], 8));
+    }
+#endif
+    for (; pos < count; ++pos) {
+        angle_rad[pos] = nodes[pos].angle_z_q14 * RAD_PER_Q14;
+        range_mm[pos] = nodes[pos].dist_mm_q2 * 0.25f;
+        if (quality) quality[pos] = nodes[pos].quality;
+        if (flag) flag[pos] = nodes[pos].flag;
+    }
+}
+
+void arrays_to_scan(const float * angle_rad, const float * range_mm, const _u8 * quality, const _u8 * flag,
+                    size_t count, rplidar_response_measurement_node_hq_t * nodes)
+{
+    for (size_t pos = 0; pos < count; ++pos) {
+        // in double, a float has no room for the half unit of the largest distances
+        double angle = angle_rad[pos] * (double)Q14_PER_RAD + 0.5;
+        double range = range_mm[pos] * 4.0 + 0.5;
+        nodes[pos].angle_z_q14 = (_u16)(_u32)(angle > 0 ? angle : 0);
+        nodes[pos].dist_mm_q2 = range > 0 ? (_u32)range : 0;
+        nodes[pos].quality = quality ? quality[pos] : 0;
+        nodes[pos].flag = flag ? flag[pos] : 0;
+    }
+}
+
+}}}
@@ -0,0 +1,110 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Conversion between the packed HQ nodes and the RplidarScanArrays layout.
+// Angles are q14 * 2 pi / 65536 and ranges q2 / 4 in float. The angles always
+// round back exactly, the ranges only while q2 < 2^24, the float mantissa: below
+// that arrays_to_scan() gives back the original nodes.
+
+enum {
+    SCAN_ARRAYS_ALIGNMENT = 32,
+};
+
+void scan_to_arrays(const rplidar_response_measurement_node_hq_t * nodes, size_t count,
+                    float * angle_rad, float * range_mm, _u8 * quality, _u8 * flag);
+
+void arrays_to_scan(const float * angle_rad, const float * range_mm, const _u8 * quality, const _u8 * flag,
+                    size_t count, rplidar_response_measurement_node_hq_t * nodes);
+
+// Storage of the arrays of one scan, one aligned block.
+class ScanArrayStorage
+{
+public:
+    ScanArrayStorage()
+        : _angle(NULL), _range(NULL), _quality(NULL), _flag(NULL)
+    {
+    }
+
+    void allocate(size_t capacity)
+    {
+        size_t floats = _alignUp(capacity * sizeof(float));
+        size_t bytes = _alignUp(capacity);
+        _block.resize(2 * floats + 2 * bytes + SCAN_ARRAYS_ALIGNMENT);
+
+        _u8 * base = &_block[0];
+        base += (SCAN_ARRAYS_ALIGNMENT - ((size_t)base % SCAN_ARRAYS_ALIGNMENT)) % SCAN_ARRAYS_ALIGNMENT;
+        _angle = reinterpret_cast<float *>(base);
+        _range = reinterpret_cast<float *>(base + floats);
+        _quality = base + 2 * floats;
+        _flag = base + 2 * floats + bytes;
+    }
+
+    bool allocated() const { return _angle != NULL; }
+
+    void fill(const rplidar_response_measurement_node_hq_t * nodes, size_t count)
+    {
+        scan_to_arrays(nodes, count, _angle, _range, _quality, _flag);
+    }
+
+    void describe(RplidarScanArrays & arrays, const _u64 * timestamps, size_t count) const
+    {
+        arrays.angle_rad = _angle;
+        arrays.range_mm = _range;
+        arrays.quality = _quality;
+        arrays.flag = _flag;
+        arrays.timestamp_us = timestamps;
+        arrays.count = count;
+    }
+
+protected:
+    static size_t _alignUp(size_t size)
+    {
+        return (size + SCAN_ARRAYS_ALIGNMENT - 1) / SCAN_ARRAYS_ALIGNMENT * SCAN_ARRAYS_ALIGNMENT;
+    }
+
+    std::vector<_u8> _block;
+    float *          _angle;
+    float *          _range;
+    _u8 *            _quality;
+    _u8 *            _flag;
+};
+
+}}}
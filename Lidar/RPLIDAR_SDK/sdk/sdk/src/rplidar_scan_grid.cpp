@@ -0,0 +1,182 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_scan_grid.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RPLIDAR_GRID_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RPLIDAR_GRID_NEON
+#endif
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+namespace {
+
+enum {
+    FULL_TURN_Q14 = 4 << 14,    // 360 degrees in angle_z_q14 units
+    HALF_BIN      = 1 << 15,    // half a bin, in the 1/65536 bin units of _binPosition()
+};
+
+// Position of the sample on the grid in 1/65536 bin units: the bin index in the
+// upper bits, the offset within the bin in the lower 16 bits.
+inline _u64 _binPosition(const rplidar_response_measurement_node_hq_t & node, size_t bins)
+{
+    _u32 angle = node.angle_z_q14;
+    if (angle >= FULL_TURN_Q14) angle %= FULL_TURN_Q14;
+    return (_u64)angle * bins;
+}
+
+// ranges[i] = count[i] ? range[i] / count[i] / 4 : 0
+void _fillRanges(const float * range, const float * count, size_t bins, float * ranges)
+{
+    size_t pos = 0;
+#if defined(RPLIDAR_GRID_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    for (; pos + 4 <= bins; pos += 4) {
+        __m128 c = _mm_loadu_ps(count + pos);
+        __m128 filled = _mm_cmpgt_ps(c, zero);
+        __m128 r = _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(range + pos), quarter), _mm_max_ps(c, one));
+        _mm_storeu_ps(ranges + pos, _mm_and_ps(r, filled));
+    }
+#elif defined(RPLIDAR_GRID_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t quarter = vdupq_n_f32(0.25f);
+    for (; pos + 4 <= bins; pos += 4) {
+        float32x4_t c = vld1q_f32(count + pos);
+        uint32x4_t filled = vcgtq_f32(c, zero);
+        float32x4_t m = vmaxq_f32(c, one);
+        // reciprocal estimate refined twice, exact enough for mm ranges
+        float32x4_t inv = vrecpeq_f32(m);
+        inv = vmulq_f32(vrecpsq_f32(m, inv), inv);
+        inv = vmulq_f32(vrecpsq_f32(m, inv), inv);
+        float32x4_t r = vmulq_f32(vmulq_f32(vld1q_f32(range + pos), quarter), inv);
+        vst1q_f32(ranges + pos, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(r), filled)));
+    }
+#endif
+    for (; pos < bins; ++pos) {
+        ranges[pos] = count[pos] > 0 ? range[pos] * 0.25f / count[pos] : 0.0f;
+    }
+}
+
+}
+
+void ScanGrid::_resize(size_t bins)
+{
+    if (_range.size() == bins) return;
+    _range.resize(bins);
+    _quality.resize(bins);
+    _count.resize(bins);
+    _offset.resize(bins);
+}
+
+bool ScanGrid::resample(const rplidar_response_measurement_node_hq_t * nodes, size_t count,
+                        size_t bins, _u32 reduction, float * ranges, _u8 * qualities)
+{
+    if (!bins || !ranges) return false;
+    if (reduction != GRID_REDUCE_MIN && reduction != GRID_REDUCE_NEAREST && reduction != GRID_REDUCE_MEAN) return false;
+
+    _resize(bins);
+    float * range = &_range[0];
+    float * quality = &_quality[0];
+    float * binCount = &_count[0];
+    memset(range, 0, bins * sizeof(float));
+    memset(quality, 0, bins * sizeof(float));
+    memset(binCount, 0, bins * sizeof(float));
+
+    // invalid samples (distance 0) fall into no bin
+    switch (reduction) {
+    case GRID_REDUCE_MIN:
+        for (size_t pos = 0; pos < count; ++pos) {
+            const rplidar_response_measurement_node_hq_t & node = nodes[pos];
+            if (!node.dist_mm_q2) continue;
+            size_t bin = (size_t)(_binPosition(node, bins) >> 16);
+            float dist = (float)node.dist_mm_q2;
+            if (!binCount[bin] || dist < range[bin]) {
+                range[bin] = dist;
+                quality[bin] = node.quality;
+                binCount[bin] = 1;
+            }
+        }
+        break;
+    case GRID_REDUCE_NEAREST:
+        {
+            _u32 * offset = &_offset[0];
+            for (size_t pos = 0; pos < count; ++pos) {
+                const rplidar_response_measurement_node_hq_t & node = nodes[pos];
+                if (!node.dist_mm_q2) continue;
+                _u64 position = _binPosition(node, bins);
+                size_t bin = (size_t)(position >> 16);
+                _u32 inBin = (_u32)(position & 0xFFFF);
+                _u32 toCenter = inBin > HALF_BIN ? inBin - HALF_BIN : HALF_BIN - inBin;
+                if (!binCount[bin] || toCenter < offset[bin]) {
+                    range[bin] = (float)node.dist_mm_q2;
+                    quality[bin] = node.quality;
+                    binCount[bin] = 1;
+                    offset[bin] = toCenter;
+                }
+            }
+        }
+        break;
+    default:
+        for (size_t pos = 0; pos < count; ++pos) {
+            const rplidar_response_measurement_node_hq_t & node = nodes[pos];
+            if (!node.dist_mm_q2) continue;
+            size_t bin = (size_t)(_binPosition(node, bins) >> 16);
+            range[bin] += (float)node.dist_mm_q2;
+            quality[bin] += node.quality;
+            binCount[bin] += 1;
+        }
+        break;
+    }
+
+    _fillRanges(range, binCount, bins, ranges);
+    if (qualities) {
+        for (size_t bin = 0; bin < bins; ++bin) {
+            qualities[bin] = binCount[bin] > 0 ? (_u8)(quality[bin] / binCount[bin] + 0.5f) : 0;
+        }
+    }
+    return true;
+}
+
+}}}
@@ -0,0 +1,64 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Resampling of a scan onto a fixed grid of equal angular bins, bin i covering
+// [i, i + 1) * 360 / bins degrees. Each sample goes straight to its bin, the
+// scan needs no sorting. The accumulators are kept between scans so a steady
+// grid size allocates nothing. Not thread safe.
+class ScanGrid
+{
+public:
+    // Resample count nodes. ranges (mm) and qualities (may be NULL) receive bins
+    // entries each, 0 for the bins no valid sample fell into.
+    // reduction is one of the GRID_REDUCE_* values.
+    bool resample(const rplidar_response_measurement_node_hq_t * nodes, size_t count,
+                  size_t bins, _u32 reduction, float * ranges, _u8 * qualities);
+
+protected:
+    void _resize(size_t bins);
+
+    std::vector<float> _range;      // q2 distance sum (mean) or the kept sample's
+    std::vector<float> _quality;    // quality sum (mean) or the kept sample's
+    std::vector<float> _count;      // samples summed (mean), 1 once a sample is kept
+    std::vector<_u32>  _offset;     // distance of the kept sample to the bin center (nearest)
+};
+
+}}}
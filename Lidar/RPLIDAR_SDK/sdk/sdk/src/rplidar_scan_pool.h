@@ -0,0 +1,217 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "rplidar_scan_arrays.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Host and device times of a complete scan, see RplidarScanInfo.
+struct ScanTiming {
+    _u64    firstPacketUs;  // arrival of the packet carrying the first node
+    _u64    lastPacketUs;   // arrival of the packet carrying the last node
+    _u64    firstDeviceTs;  // device timestamp of the first HQ capsule, 0 in other modes
+    _u64    lastDeviceTs;   // device timestamp of the last HQ capsule, 0 in other modes
+};
+
+class ScanPool;
+
+// A scan buffer of the pool. The cache thread fills it in place through
+// writeNodes()/writeTimestamps() while it holds the only reference, then
+// seal()s it and hands out references; it is read-only from then on.
+// Scans with arrays lay the nodes out again as RplidarScanArrays on seal().
+class PooledScan : public RplidarScan
+{
+public:
+    PooledScan(ScanPool * pool, size_t capacity, bool timestamps, bool arrays)
+        : _pool(pool)
+        , _capacity(capacity)
+        , _refs(1)
+        , _nodeStorage(capacity)
+        , _timestampStorage(timestamps ? capacity : 0)
+    {
+        _nodes = &_nodeStorage[0];
+        _timestamps = timestamps ? &_timestampStorage[0] : NULL;
+        if (arrays) _arrayStorage.allocate(capacity);
+        memset(&_info, 0, sizeof(_info));
+    }
+
+    size_t capacity() const { return _capacity; }
+    rplidar_response_measurement_node_hq_t * writeNodes() { return _nodes; }
+    _u64 * writeTimestamps() { return _timestamps; }  // NULL when the pool keeps no timestamps
+
+    // count may exceed the capacity, the nodes beyond it were never written.
+    void seal(_u64 seq, size_t count, const ScanTiming & timing, _u64 truncated)
+    {
+        _count = count < _capacity ? count : _capacity;
+        _info.seq = seq;
+        _info.dropped = 0;
+        _info.truncated = truncated;
+        _info.first_packet_us = timing.firstPacketUs;
+        _info.last_packet_us = timing.lastPacketUs;
+        _info.first_device_ts = timing.firstDeviceTs;
+        _info.last_device_ts = timing.lastDeviceTs;
+        if (_arrayStorage.allocated()) {
+            _arrayStorage.fill(_nodes, _count);
+            _arrayStorage.describe(_arrays, _timestamps, _count);
+        }
+    }
+
+    virtual void addRef() const
+    {
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    virtual void release() const;
+
+protected:
+    friend class ScanPool;
+
+    ScanPool *                                          _pool;
+    size_t                                              _capacity;
+    mutable std::atomic<int>                            _refs;
+    std::vector<rplidar_response_measurement_node_hq_t> _nodeStorage;
+    std::vector<_u64>                                   _timestampStorage;
+    ScanArrayStorage                                    _arrayStorage;
+};
+
+// Recycles the scans once their last reference is released. New scans are
+// only allocated while the number of scans in flight grows, so the steady
+// state runs without allocation.
+class ScanPool
+{
+public:
+    ScanPool(size_t capacity, bool timestamps = true, bool arrays = false)
+        : _capacity(capacity)
+        , _timestamps(timestamps)
+        , _arrays(arrays)
+    {
+    }
+
+    ~ScanPool()
+    {
+        for (size_t pos = 0; pos < _all.size(); ++pos) {
+            delete _all[pos];
+        }
+    }
+
+    size_t capacity() const { return _capacity; }
+    size_t allocatedCount() const { return _all.size(); }
+
+    // Size the scans acquired from now on. Scans of another size still held
+    // by consumers are freed, rather than recycled, when they come back.
+    void setCapacity(size_t capacity)
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (capacity == _capacity) return;
+        _capacity = capacity;
+        _freeIdle();
+    }
+
+    // Free the scans nobody holds, e.g. while the driver is not scanning.
+    void trim()
+    {
+        rp::hal::AutoLocker l(_lock);
+        _freeIdle();
+    }
+
+    // Returns an empty scan the caller holds the only reference on.
+    PooledScan * acquire()
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (_free.empty()) {
+            PooledScan * scan = new PooledScan(this, _capacity, _timestamps, _arrays);
+            _all.push_back(scan);
+            _free.reserve(_all.size());
+            return scan;
+        }
+        PooledScan * scan = _free.back();
+        _free.pop_back();
+        scan->_refs.store(1, std::memory_order_relaxed);
+        return scan;
+    }
+
+protected:
+    friend class PooledScan;
+
+    void _recycle(PooledScan * scan)
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (scan->_capacity != _capacity) {
+            _forget(scan);
+            return;
+        }
+        _free.push_back(scan);
+    }
+
+    void _freeIdle()
+    {
+        while (!_free.empty()) {
+            _forget(_free.back());
+            _free.pop_back();
+        }
+    }
+
+    void _forget(PooledScan * scan)
+    {
+        for (size_t pos = 0; pos < _all.size(); ++pos) {
+            if (_all[pos] == scan) {
+                _all[pos] = _all.back();
+                _all.pop_back();
+                break;
+            }
+        }
+        delete scan;
+    }
+
+    size_t                    _capacity;
+    bool                      _timestamps;
+    bool                      _arrays;
+    std::vector<PooledScan *> _all;
+    std::vector<PooledScan *> _free;
+    rp::hal::Locker           _lock;
+};
+
+inline void PooledScan::release() const
+{
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _pool->_recycle(const_cast<PooledScan *>(this));
+    }
+}
+
+}}}
@@ -0,0 +1,229 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "rplidar_scan_pool.h"
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Lock-free single-producer/single-consumer handoff of complete 360 degree
+// scans.
+//
+// The cache thread is the only producer and the grabScanData* caller is the
+// only consumer; the driver serializes its grabScanData* callers, the ring
+// does not. The ring holds references on pooled scans, so scans are never
+// copied on their way through it; the consumer reads a scan in place until
+// releaseRead().
+//
+// With KEEP_LATEST a single slot holds the newest complete scan: the
+// producer swaps every scan in and releases the one it replaces, the
+// consumer swaps it out. A consumer that falls behind gets the newest scan,
+// never a stale one.
+//
+// With DROP_NEWEST the scans are queued in order, up to depth of them. When
+// the queue is full the newest scan is dropped: the slot the consumer is
+// reading can never be overwritten underneath it.
+//
+// The scan sequence numbers are assigned by the producer, a dropped scan
+// leaves a gap with either policy.
+class ScanRing
+{
+public:
+    enum {
+        DEFAULT_DEPTH = 4,
+        MAX_DEPTH     = 64,
+    };
+
+    enum {
+        KEEP_LATEST = 0,
+        DROP_NEWEST = 1,
+    };
+
+    ScanRing()
+        : _depth(0)
+        , _policy(KEEP_LATEST)
+        , _head(0)
+        , _tail(0)
+        , _latest(NULL)
+        , _reading(NULL)
+        , _waiting(false)
+        , _dropped(0)
+    {
+    }
+
+    ~ScanRing()
+    {
+        clear();
+    }
+
+    // (Re)allocate the ring. Must not be called while a producer or a consumer is active.
+    bool resize(size_t depth)
+    {
+        if (depth == 0 || depth > MAX_DEPTH) return false;
+
+        clear();
+        _slots.assign(depth, NULL);
+        _depth = depth;
+        _head.store(0);
+        _tail.store(0);
+        return true;
+    }
+
+    // Release the queued scans. Must not be called while a producer or a consumer is active.
+    void clear()
+    {
+        size_t head = _head.load();
+        for (size_t pos = _tail.load(); pos != head; ++pos) {
+            _slots[pos % _depth]->release();
+        }
+        _tail.store(head);
+
+        const RplidarScan * latest = _latest.exchange(NULL);
+        if (latest) latest->release();
+        if (_reading) _reading->release();
+        _reading = NULL;
+    }
+
+    // Must not be called while a producer or a consumer is active.
+    void setPolicy(int policy)
+    {
+        clear();
+        _policy = policy;
+    }
+
+    size_t depth() const { return _depth; }
+    int    policy() const { return _policy; }
+    _u64   droppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+    // -- producer side --
+
+    // Queue a reference on a complete scan. Returns false when the scan was dropped,
+    // or replaced a scan the consumer never took.
+    bool publish(const RplidarScan * scan)
+    {
+        if (_policy == KEEP_LATEST) {
+            scan->addRef();
+            const RplidarScan * replaced = _latest.exchange(scan, std::memory_order_seq_cst);
+            if (replaced) {
+                replaced->release();
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (_waiting.load(std::memory_order_seq_cst)) {
+                _evt.set();
+            }
+            return replaced == NULL;
+        }
+
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= _depth) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // the slot is free, the consumer does not touch it until _head moves
+        scan->addRef();
+        _slots[head % _depth] = scan;
+
+        _head.store(head + 1, std::memory_order_seq_cst);
+        if (_waiting.load(std::memory_order_seq_cst)) {
+            _evt.set();
+        }
+        return true;
+    }
+
+    // -- consumer side --
+
+    // Wait up to timeout ms for the newest scan (KEEP_LATEST) or the oldest queued
+    // one (DROP_NEWEST). Returns NULL on timeout. Until releaseRead() is called the
+    // scan is held for the consumer and beginRead() returns it again.
+    const RplidarScan * beginRead(_u32 timeout)
+    {
+        _u32 startTs = getms();
+        _u32 waitTime;
+
+        if (_reading) return _reading;
+
+        while (true) {
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (_policy == KEEP_LATEST) {
+                _reading = _latest.exchange(NULL, std::memory_order_acquire);
+                if (_reading) return _reading;
+            } else if (_head.load(std::memory_order_acquire) != tail) {
+                return _slots[tail % _depth];
+            }
+
+            if ((waitTime = getms() - startTs) >= timeout) return NULL;
+
+            _waiting.store(true, std::memory_order_seq_cst);
+            if (_policy == KEEP_LATEST ? _latest.load(std::memory_order_seq_cst) == NULL
+                                       : _head.load(std::memory_order_seq_cst) == tail) {
+                _evt.wait(timeout == 0xFFFFFFFF ? timeout : timeout - waitTime);
+            }
+            _waiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    void releaseRead()
+    {
+        if (_policy == KEEP_LATEST) {
+            if (_reading) _reading->release();
+            _reading = NULL;
+            return;
+        }
+
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        _slots[tail % _depth]->release();
+        _tail.store(tail + 1, std::memory_order_release);
+    }
+
+protected:
+    std::vector<const RplidarScan *> _slots;
+    size_t               _depth;
+    int                  _policy;
+
+    std::atomic<size_t>  _head;     // written by the producer only
+    std::atomic<size_t>  _tail;     // written by the consumer only
+    std::atomic<const RplidarScan *> _latest;   // KEEP_LATEST: the newest scan not taken yet
+    const RplidarScan *  _reading;  // KEEP_LATEST: the scan taken by the consumer
+    std::atomic<bool>    _waiting;  // consumer is parked on _evt
+    std::atomic<_u64>    _dropped;
+
+    rp::hal::Event       _evt;
+};
+
+}}}
@@ -0,0 +1,160 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// A consumer registered with subscribeScans(): a bounded queue of scan
+// references, fed by the cache thread. When a callback is given, a thread of
+// the subscription drains the queue into it.
+class ScanSubscription
+{
+public:
+    ScanSubscription(_u32 id, size_t backlog, RplidarScanCallback callback, void * userData)
+        : _id(id)
+        , _queue(backlog ? backlog : 1)
+        , _head(0)
+        , _count(0)
+        , _callback(callback)
+        , _userData(userData)
+        , _running(false)
+    {
+    }
+
+    ~ScanSubscription()
+    {
+        stop();
+        const RplidarScan * scan;
+        while ((scan = _tryPop()) != NULL) {
+            scan->release();
+        }
+    }
+
+    _u32 id() const { return _id; }
+    bool hasCallback() const { return _callback != NULL; }
+
+    void start()
+    {
+        if (!_callback || _running) return;
+        _running = true;
+        _thread = CLASS_THREAD(ScanSubscription, _dispatch);
+    }
+
+    void stop()
+    {
+        if (!_running) return;
+        _running = false;
+        _evt.set();
+        _thread.join();
+    }
+
+    // Queue a reference on scan, dropping the oldest queued scan when the backlog is full.
+    void push(const RplidarScan * scan)
+    {
+        const RplidarScan * dropped = NULL;
+        scan->addRef();
+        {
+            rp::hal::AutoLocker l(_lock);
+            if (_count == _queue.size()) {
+                dropped = _queue[_head];
+                _head = (_head + 1) % _queue.size();
+                --_count;
+            }
+            _queue[(_head + _count) % _queue.size()] = scan;
+            ++_count;
+        }
+        if (dropped) dropped->release();
+        _evt.set();
+    }
+
+    // Wait up to timeout ms for the oldest queued scan, the caller takes over its reference.
+    // Returns NULL on timeout.
+    const RplidarScan * pop(_u32 timeout)
+    {
+        _u32 startTs = getms();
+        _u32 waitTime;
+
+        while (true) {
+            const RplidarScan * scan = _tryPop();
+            if (scan) return scan;
+
+            if ((waitTime = getms() - startTs) >= timeout) return NULL;
+            _evt.wait(timeout == 0xFFFFFFFF ? timeout : timeout - waitTime);
+        }
+    }
+
+protected:
+    const RplidarScan * _tryPop()
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (!_count) return NULL;
+
+        const RplidarScan * scan = _queue[_head];
+        _head = (_head + 1) % _queue.size();
+        --_count;
+        return scan;
+    }
+
+    u_result _dispatch()
+    {
+        while (_running) {
+            const RplidarScan * scan = _tryPop();
+            if (!scan) {
+                // stop() sets the event as well
+                _evt.wait();
+                continue;
+            }
+            _callback(*scan, _userData);
+            scan->release();
+        }
+        return RESULT_OK;
+    }
+
+    _u32                              _id;
+    std::vector<const RplidarScan *>  _queue;
+    size_t                            _head;
+    size_t                            _count;
+    RplidarScanCallback               _callback;
+    void *                            _userData;
+    volatile bool                     _running;
+
+    rp::hal::Locker                   _lock;
+    rp::hal::Event                    _evt;
+    rp::hal::Thread                   _thread;
+};
+
+}}}
@@ -0,0 +1,97 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Decides when the motor has spun up from the rotation frequencies measured on the
+// incoming scans. A rotation counts towards stability when it is at least as fast as
+// the criterion minimum and within its tolerance of the rotation before; the motor is
+// stable after criterion.stable_scans such rotations in a row. Not thread safe.
+class SpinMonitor
+{
+public:
+    SpinMonitor()
+    {
+        RplidarSpinCriterion criterion = { 2.0f, 0.05f, 3 };
+        _criterion = criterion;
+        reset();
+    }
+
+    void setCriterion(const RplidarSpinCriterion & criterion)
+    {
+        _criterion = criterion;
+        if (_criterion.stable_scans < 1) _criterion.stable_scans = 1;
+    }
+
+    // Forget the measured rotations, e.g. once the motor was started again.
+    void reset()
+    {
+        _frequency = 0;
+        _steadyRotations = 0;
+    }
+
+    // Account for a rotation measured at frequency (Hz), 0 if it could not be measured
+    // (e.g. too slow to fit the scan buffer).
+    void update(float frequency)
+    {
+        if (frequency <= 0) {
+            reset();
+            return;
+        }
+
+        float deviation = frequency > _frequency ? frequency - _frequency : _frequency - frequency;
+        if (frequency < _criterion.min_frequency) {
+            _steadyRotations = 0;
+        } else if (_steadyRotations && deviation <= _criterion.tolerance * _frequency) {
+            ++_steadyRotations;
+        } else {
+            // the first rotation fast enough, or a speed change: start counting again
+            _steadyRotations = 1;
+        }
+        _frequency = frequency;
+    }
+
+    bool  stable() const    { return _steadyRotations >= _criterion.stable_scans; }
+    float frequency() const { return _frequency; }
+
+protected:
+    RplidarSpinCriterion _criterion;
+    float                _frequency;
+    _u32                 _steadyRotations;
+};
+
+}}}
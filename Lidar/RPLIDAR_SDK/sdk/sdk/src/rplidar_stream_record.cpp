@@ -0,0 +1,111 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "hal/locker.h"
+#include "rplidar_stream_record.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+StreamRecorder::StreamRecorder()
+    : _file(NULL)
+    , _active(false)
+{
+}
+
+StreamRecorder::~StreamRecorder()
+{
+    stop();
+}
+
+bool StreamRecorder::start(const char * path)
+{
+    rp::hal::AutoLocker l(_lock);
+    if (_file) {
+        _active.store(false);
+        fclose(_file);
+        _file = NULL;
+    }
+
+    _file = fopen(path, "wb");
+    if (!_file) return false;
+
+    _u8 header[STREAM_RECORD_FILE_HEADER];
+    _u32 version = STREAM_RECORD_VERSION;
+    memset(header, 0, sizeof(header));
+    memcpy(header, STREAM_RECORD_MAGIC, sizeof(STREAM_RECORD_MAGIC));
+    memcpy(header + sizeof(STREAM_RECORD_MAGIC), &version, sizeof(version));
+    if (fwrite(header, sizeof(header), 1, _file) != 1) {
+        fclose(_file);
+        _file = NULL;
+        return false;
+    }
+
+    _active.store(true);
+    return true;
+}
+
+void StreamRecorder::stop()
+{
+    rp::hal::AutoLocker l(_lock);
+    _active.store(false);
+    if (_file) {
+        fclose(_file);
+        _file = NULL;
+    }
+}
+
+void StreamRecorder::_write(_u8 type, const _u8 * data, size_t size)
+{
+    StreamRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.type = type;
+    header.size = (_u32)size;
+    header.timestamp_us = getus();
+
+    rp::hal::AutoLocker l(_lock);
+    if (!_file) return;
+    // a short write leaves a truncated last record, which the replay ignores
+    if (fwrite(&header, sizeof(header), 1, _file) != 1 || (size && fwrite(data, size, 1, _file) != 1)) {
+        _active.store(false);
+        fclose(_file);
+        _file = NULL;
+    }
+}
+
+}}}
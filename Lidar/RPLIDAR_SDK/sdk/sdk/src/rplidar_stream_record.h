@@ -0,0 +1,105 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <stdio.h>
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Recordings of the byte stream of a device (see RPlidarDriver::startRecording),
+// all fields little endian:
+//
+//  file header   8 bytes  STREAM_RECORD_MAGIC
+//                4 bytes  STREAM_RECORD_VERSION
+//                4 bytes  reserved, 0
+//  records       16 byte StreamRecordHeader then size bytes of data, until the end of the file
+//
+// RX records hold a chunk of bytes as read from the device, TX records one
+// complete command packet sent to it, both stamped with the host monotonic
+// time (us) they were read or sent at.
+
+enum {
+    STREAM_RECORD_VERSION     = 1,
+    STREAM_RECORD_FILE_HEADER = 16,
+
+    STREAM_RECORD_RX          = 0x1,
+    STREAM_RECORD_TX          = 0x2,
+};
+
+static const char STREAM_RECORD_MAGIC[8] = { 'R', 'P', 'L', 'R', 'E', 'C', 'O', 'R' };
+
+#if defined(_WIN32)
+#pragma pack(1)
+#endif
+
+struct StreamRecordHeader {
+    _u8     type;           // STREAM_RECORD_*
+    _u8     reserved[3];
+    _u32    size;           // bytes of data following the header
+    _u64    timestamp_us;
+} __attribute__((packed));
+
+#if defined(_WIN32)
+#pragma pack()
+#endif
+
+// Appends the records to a file. Called from the driver threads, record() is a
+// single flag test while no recording runs.
+class StreamRecorder
+{
+public:
+    StreamRecorder();
+    ~StreamRecorder();
+
+    bool start(const char * path);
+    void stop();
+
+    void record(_u8 type, const _u8 * data, size_t size)
+    {
+        if (!_active.load(std::memory_order_relaxed)) return;
+        _write(type, data, size);
+    }
+
+protected:
+    void _write(_u8 type, const _u8 * data, size_t size);
+
+    rp::hal::Locker     _lock;
+    FILE *              _file;
+    std::atomic<bool>   _active;
+};
+
+}}}
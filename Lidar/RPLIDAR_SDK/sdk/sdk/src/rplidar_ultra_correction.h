@@ -0,0 +1,63 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#pragma once
+
+namespace rp { namespace standalone{ namespace rplidar {
+
+// Angle correction of the ultra capsule samples, the value _ultraCapsuleToNormal()
+// subtracts from the raw sample angle (q16 degrees).
+//
+// The correction only depends on the distance through k2 = 98361 / dist_q2. Ultra
+// capsule distances are whole millimetres (dist_q2 is always a multiple of 4), so a
+// table with one entry per millimetre reproduces the original formula with no error.
+// Entries below 50 mm hold the near-range constant, and from ULTRA_CORRECTION_FAR_MM
+// on k2 is 0 and the correction constant again.
+
+enum {
+    ULTRA_CORRECTION_FAR_MM     = 98361 / 4 + 1,
+    ULTRA_CORRECTION_TABLE_SIZE = ULTRA_CORRECTION_FAR_MM + 1,
+};
+
+// Table indexed by dist_q2 >> 2, clamped to [0, ULTRA_CORRECTION_FAR_MM].
+// Built on first use.
+const _s32 * ultra_angle_correction_table();
+
+static inline _s32 ultra_angle_correction_q16(const _s32 * table, int dist_q2)
+{
+    int mm = dist_q2 < 0 ? 0 : (dist_q2 >> 2);
+    return table[mm < ULTRA_CORRECTION_FAR_MM ? mm : ULTRA_CORRECTION_FAR_MM];
+}
+
+}}}
@@ -0,0 +1,79 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "rplidar_test.h"
+
+#include <vector>
+
+namespace rp { namespace test {
+
+static int _failures;
+
+TestCase *& registry()
+{
+    static TestCase * head = NULL;
+    return head;
+}
+
+void reportFailure(const char * file, int line, const char * expr)
+{
+    fprintf(stderr, "  %s:%d: check failed: %s\n", file, line, expr);
+    ++_failures;
+}
+
+}}
+
+int main()
+{
+    using namespace rp::test;
+
+    // registration order is link order reversed, run in declaration order
+    std::vector<TestCase *> cases;
+    for (TestCase * tc = registry(); tc; tc = tc->next) {
+        cases.insert(cases.begin(), tc);
+    }
+
+    int failed = 0;
+    for (size_t pos = 0; pos < cases.size(); ++pos) {
+        int before = _failures;
+        cases[pos]->fn();
+        bool ok = (_failures == before);
+        if (!ok) ++failed;
+        printf("[%s] %s\n", ok ? "  OK  " : " FAIL ", cases[pos]->name);
+    }
+
+    printf("%d of %d tests failed\n", failed, (int)cases.size());
+    return failed ? 1 : 0;
+}
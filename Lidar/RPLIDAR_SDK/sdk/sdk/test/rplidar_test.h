@@ -0,0 +1,76 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#pragma once
+
+#include <stdio.h>
+
+// A minimal self-registering test runner. Every RP_TEST in the linked
+// objects runs once from main(); a failed RP_CHECK reports the expression
+// and marks the test failed, the test keeps running.
+
+namespace rp { namespace test {
+
+typedef void (*TestFn)();
+
+struct TestCase {
+    const char * name;
+    TestFn       fn;
+    TestCase *   next;
+};
+
+TestCase *& registry();
+void reportFailure(const char * file, int line, const char * expr);
+
+struct TestRegistrar {
+    TestRegistrar(TestCase & tc, const char * name, TestFn fn)
+    {
+        tc.name = name;
+        tc.fn = fn;
+        tc.next = registry();
+        registry() = &tc;
+    }
+};
+
+}}
+
+#define RP_TEST(name) \
+    static void name(); \
+    static rp::test::TestCase name##_case; \
+    static rp::test::TestRegistrar name##_registrar(name##_case, #name, name); \
+    static void name()
+
+#define RP_CHECK(expr) \
+    do { if (!(expr)) rp::test::reportFailure(__FILE__, __LINE__, #expr); } while (0)
@@ -0,0 +1,301 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+typedef std::vector<Node> Scan;
+
+enum {
+    FULL_TURN_Q14 = 4 << 14,
+};
+
+// The implementation ascendScanData had before it worked on raw angles: float
+// degrees, a chain of steps for the invalid nodes and a full sort.
+float refGetAngle(const Node & node)
+{
+    return node.angle_z_q14 * 90.f / 16384.f;
+}
+
+void refSetAngle(Node & node, float v)
+{
+    node.angle_z_q14 = _u32(v * 16384.f / 90.f);
+}
+
+bool refLessThan(const Node & a, const Node & b)
+{
+    return refGetAngle(a) < refGetAngle(b);
+}
+
+u_result refAscend(Node * nodebuffer, size_t count)
+{
+    float inc_origin_angle = 360.f / count;
+    size_t i = 0;
+
+    for (i = 0; i < count; i++) {
+        if (nodebuffer[i].dist_mm_q2 == 0) continue;
+        while (i != 0) {
+            i--;
+            float expect_angle = refGetAngle(nodebuffer[i + 1]) - inc_origin_angle;
+            if (expect_angle < 0.0f) expect_angle = 0.0f;
+            refSetAngle(nodebuffer[i], expect_angle);
+        }
+        break;
+    }
+    if (i == count) return RESULT_OPERATION_FAIL;
+
+    for (i = count - 1; ; i--) {
+        if (nodebuffer[i].dist_mm_q2 == 0) continue;
+        while (i != count - 1) {
+            i++;
+            float expect_angle = refGetAngle(nodebuffer[i - 1]) + inc_origin_angle;
+            if (expect_angle > 360.0f) expect_angle -= 360.0f;
+            refSetAngle(nodebuffer[i], expect_angle);
+        }
+        break;
+    }
+
+    float frontAngle = refGetAngle(nodebuffer[0]);
+    for (i = 1; i < count; i++) {
+        if (nodebuffer[i].dist_mm_q2 == 0) {
+            float expect_angle = frontAngle + i * inc_origin_angle;
+            if (expect_angle > 360.0f) expect_angle -= 360.0f;
+            refSetAngle(nodebuffer[i], expect_angle);
+        }
+    }
+
+    std::sort(nodebuffer, nodebuffer + count, &refLessThan);
+    return RESULT_OK;
+}
+
+struct Random {
+    _u32 state;
+    Random(_u32 seed) : state(seed) {}
+    _u32 next(_u32 range)
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % range;
+    }
+};
+
+// One rotation of count nodes starting at startQ14, each node jittered by less
+// than half a step so all the angles stay distinct. Every distance is unique.
+Scan makeRotation(size_t count, _u32 startQ14, Random & rnd)
+{
+    Scan scan(count);
+    _u32 step = FULL_TURN_Q14 / (_u32)count;
+    for (size_t i = 0; i < count; ++i) {
+        memset(&scan[i], 0, sizeof(Node));
+        _u32 jitter = step / 2 ? rnd.next(step / 2) : 0;
+        scan[i].angle_z_q14 = (startQ14 + (_u32)i * step + jitter) % FULL_TURN_Q14;
+        scan[i].dist_mm_q2 = (_u32)(i + 1) * 4;
+        scan[i].quality = (_u8)i;
+    }
+    return scan;
+}
+
+bool sameNodes(const Scan & a, const Scan & b)
+{
+    return a.size() == b.size() && (a.empty() || !memcmp(&a[0], &b[0], a.size() * sizeof(Node)));
+}
+
+bool ascending(const Scan & scan)
+{
+    for (size_t i = 1; i < scan.size(); ++i) {
+        if (scan[i - 1].angle_z_q14 > scan[i].angle_z_q14) return false;
+    }
+    return true;
+}
+
+Scan validNodes(const Scan & scan)
+{
+    Scan valid;
+    for (size_t i = 0; i < scan.size(); ++i) {
+        if (scan[i].dist_mm_q2) valid.push_back(scan[i]);
+    }
+    return valid;
+}
+
+// Sorts scan both ways. Without invalid nodes the outputs must match node for
+// node; the invalid ones get their patched angles without the old float drift,
+// so for them only the order of the valid nodes and the angles up to maxDrift
+// q14 units are compared.
+bool matchesReference(RPlidarDriver * drv, const Scan & scan, _u32 maxDrift = 0)
+{
+    Scan out = scan, ref = scan;
+    u_result ans = drv->ascendScanData(&out[0], out.size());
+    u_result refAns = refAscend(&ref[0], ref.size());
+    if (ans != refAns) return false;
+    if (IS_FAIL(ans)) return true;
+
+    if (!ascending(out)) return false;
+    if (!maxDrift) return sameNodes(out, ref);
+
+    if (!sameNodes(validNodes(out), validNodes(ref))) return false;
+    for (size_t i = 0; i < out.size(); ++i) {
+        _u32 a = out[i].angle_z_q14, b = ref[i].angle_z_q14;
+        if ((a > b ? a - b : b - a) > maxDrift) return false;
+    }
+    return true;
+}
+
+}
+
+RP_TEST(ascend_scan_no_wrap)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(1);
+
+    Scan scan = makeRotation(720, 0, rnd);
+    RP_CHECK(ascending(scan));
+    RP_CHECK(matchesReference(drv, scan));
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_wrap_positions)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(2);
+    const size_t count = 1000;
+    const _u32 step = FULL_TURN_Q14 / count;
+
+    // the wrap right after the first node, in the middle and before the last node
+    _u32 starts[] = { FULL_TURN_Q14 - step, FULL_TURN_Q14 / 2, FULL_TURN_Q14 - (_u32)(count - 1) * step };
+    for (size_t k = 0; k < _countof(starts); ++k) {
+        Scan scan = makeRotation(count, starts[k], rnd);
+        RP_CHECK(!ascending(scan));
+        RP_CHECK(matchesReference(drv, scan));
+    }
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_local_jitter)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(3);
+
+    // neighbours swapped, as the measurements of a real rotation are
+    Scan scan = makeRotation(1600, 20000, rnd);
+    for (size_t i = 0; i + 1 < scan.size(); i += 3) std::swap(scan[i], scan[i + 1]);
+    RP_CHECK(matchesReference(drv, scan));
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_falls_back_past_the_insertion_bound)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(4);
+
+    // shuffled far beyond 8 moves per node: the stable_sort fallback runs
+    Scan scan = makeRotation(2000, 30000, rnd);
+    for (size_t i = scan.size() - 1; i > 0; --i) std::swap(scan[i], scan[rnd.next((_u32)i + 1)]);
+    RP_CHECK(matchesReference(drv, scan));
+
+    // two interleaved rotations half a step apart, so no angle is taken twice
+    const _u32 step = FULL_TURN_Q14 / 500;
+    Scan first = makeRotation(500, 1000, rnd), second = makeRotation(500, 1000 + step / 2, rnd);
+    Scan both;
+    for (size_t i = 0; i < first.size(); ++i) {
+        both.push_back(first[i]);
+        both.push_back(second[i]);
+        both.back().dist_mm_q2 += 1;
+    }
+    std::reverse(both.begin(), both.end());
+    RP_CHECK(matchesReference(drv, both));
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_invalid_head_and_tail)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(5);
+    const size_t count = 800;
+
+    _u32 starts[] = { 100, 40000, FULL_TURN_Q14 - 300 };
+    for (size_t k = 0; k < _countof(starts); ++k) {
+        Scan scan = makeRotation(count, starts[k], rnd);
+        for (size_t i = 0; i < 12; ++i) scan[i].dist_mm_q2 = 0;
+        for (size_t i = count - 9; i < count; ++i) scan[i].dist_mm_q2 = 0;
+        for (size_t i = 100; i < count - 100; i += 7) scan[i].dist_mm_q2 = 0;
+        // the invalid nodes carry garbage angles, ascendScanData replaces them
+        for (size_t i = 0; i < count; ++i) {
+            if (!scan[i].dist_mm_q2) scan[i].angle_z_q14 = rnd.next(FULL_TURN_Q14);
+        }
+        RP_CHECK(matchesReference(drv, scan, 16));
+    }
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_single_node)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(6);
+
+    Scan scan = makeRotation(1, 12345, rnd);
+    RP_CHECK(matchesReference(drv, scan));
+    Scan out = scan;
+    RP_CHECK(drv->ascendScanData(&out[0], 1) == RESULT_OK);
+    RP_CHECK(sameNodes(out, scan));
+
+    scan[0].dist_mm_q2 = 0;
+    RP_CHECK(drv->ascendScanData(&scan[0], 1) == RESULT_OPERATION_FAIL);
+    RP_CHECK(matchesReference(drv, scan));
+    RPlidarDriver::DisposeDriver(drv);
+}
+
+RP_TEST(ascend_scan_out_of_place_keeps_the_source)
+{
+    RPlidarDriver * drv = RPlidarDriver::CreateDriver(DRIVER_TYPE_SERIALPORT);
+    Random rnd(7);
+
+    const Scan scan = makeRotation(500, 50000, rnd);
+    Scan out(scan.size()), ref = scan;
+    RP_CHECK(drv->ascendScanData(&scan[0], &out[0], scan.size()) == RESULT_OK);
+    RP_CHECK(refAscend(&ref[0], ref.size()) == RESULT_OK);
+    RP_CHECK(sameNodes(out, ref));
+    Random again(7);
+    RP_CHECK(sameNodes(scan, makeRotation(500, 50000, again)));
+    RPlidarDriver::DisposeDriver(drv);
+}
@@ -0,0 +1,279 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/types.h"
+#include "hal/assert.h"
+#include "hal/locker.h"
+#include "hal/socket.h"
+#include "hal/event.h"
+#include "hal/mapped_file.h"
+#include "rplidar_scan_ring.h"
+#include "rplidar_interval_ring.h"
+#include "rplidar_scan_subscription.h"
+#include "rplidar_sample_timestamper.h"
+#include "rplidar_packet_scanner.h"
+#include "rplidar_packet_queue.h"
+#include "rplidar_crc32.h"
+#include "rplidar_profile_cache.h"
+#include "rplidar_spin_monitor.h"
+#include "rplidar_scan_grid.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_stream_record.h"
+#include "rplidar_decode_simd.h"
+#include "rplidar_ultra_correction.h"
+#include "rplidar_driver_impl.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+#include <vector>
+
+// The vectorized capsule decoders must produce exactly the nodes of the scalar
+// decoders. Every capsule stream is decoded once with the scalar code and once
+// with each implementation the running CPU supports, through the driver's own
+// decode entry points, and the outputs are compared byte for byte.
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+struct Rng {
+    _u32 state;
+    explicit Rng(_u32 seed) : state(seed) {}
+
+    _u32 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+class DecodeDriver : public RPlidarDriverImplCommon
+{
+public:
+    virtual u_result connect(const char *, _u32, _u32) { return RESULT_OK; }
+    virtual void disconnect() {}
+
+    void toggleSyncFound() { _syncBit_is_finded = !_syncBit_is_finded; }
+    bool syncFound() const { return _syncBit_is_finded; }
+
+    using RPlidarDriverImplCommon::_capsuleToNormal;
+    using RPlidarDriverImplCommon::_dense_capsuleToNormal;
+    using RPlidarDriverImplCommon::_ultraCapsuleToNormal;
+};
+
+struct DecodeResult {
+    std::vector<rplidar_response_measurement_node_hq_t> nodes;
+    std::vector<_u8>                                    syncFound;  // state after every capsule
+};
+
+}
+
+// Start angles of consecutive capsules: the usual spacing, repeated angles,
+// arbitrary jumps and wraps through 360 degrees, with the sync flag here and there.
+static _u16 nextStartAngle(Rng & rng, int & angle_q6)
+{
+    int step = 1500 + rng.next() % 900;
+    switch (rng.next() % 50) {
+    case 0:
+        step = 0;
+        break;
+    case 1: case 2: case 3: case 4: case 5:
+        step = rng.next() % (360 << 6);
+        break;
+    case 6:
+        angle_q6 = (360 << 6) - 1 - rng.next() % 4;
+        step = 0;
+        break;
+    }
+    angle_q6 = (angle_q6 + step) % (360 << 6);
+    return (_u16)(angle_q6 | (rng.next() % 40 == 0 ? 0x8000 : 0));
+}
+
+template <class Capsule>
+static DecodeResult decodeAll(void (RPlidarDriverImplCommon::*decode)(const Capsule &, rplidar_response_measurement_node_hq_t *, size_t &),
+                              const std::vector<Capsule> & capsules)
+{
+    DecodeDriver driver;
+    DecodeResult result;
+    Rng rng(99);
+    rplidar_response_measurement_node_hq_t buffer[ULTRA_CAPSULE_SAMPLES];
+
+    for (size_t pos = 0; pos < capsules.size(); ++pos) {
+        // decode from both sync detection states
+        if (rng.next() % 500 == 0) driver.toggleSyncFound();
+
+        size_t count = 0;
+        (driver.*decode)(capsules[pos], buffer, count);
+        result.nodes.insert(result.nodes.end(), buffer, buffer + count);
+        result.syncFound.push_back(driver.syncFound());
+    }
+    return result;
+}
+
+template <class Capsule>
+static void checkSimdMatchesScalar(void (RPlidarDriverImplCommon::*decode)(const Capsule &, rplidar_response_measurement_node_hq_t *, size_t &),
+                                   const std::vector<Capsule> & capsules)
+{
+    static const int isas[] = { DECODE_SIMD_SSE41, DECODE_SIMD_AVX2, DECODE_SIMD_NEON };
+
+    RP_CHECK(decode_simd_select(DECODE_SIMD_NONE));
+    DecodeResult scalar = decodeAll(decode, capsules);
+    RP_CHECK(!scalar.nodes.empty());
+
+    for (size_t pos = 0; pos < _countof(isas); ++pos) {
+        if (!decode_simd_select(isas[pos])) continue;
+
+        DecodeResult simd = decodeAll(decode, capsules);
+        RP_CHECK(simd.nodes.size() == scalar.nodes.size());
+        RP_CHECK(simd.syncFound == scalar.syncFound);
+        if (simd.nodes.size() != scalar.nodes.size()) continue;
+
+        bool identical = memcmp(&simd.nodes[0], &scalar.nodes[0], scalar.nodes.size() * sizeof(scalar.nodes[0])) == 0;
+        RP_CHECK(identical);
+        for (size_t node = 0; !identical && node < scalar.nodes.size(); ++node) {
+            if (memcmp(&simd.nodes[node], &scalar.nodes[node], sizeof(scalar.nodes[node])) == 0) continue;
+            fprintf(stderr, "  isa %d, node %d: angle %u dist %u flag %u, scalar angle %u dist %u flag %u\n", isas[pos], (int)node,
+                    simd.nodes[node].angle_z_q14, simd.nodes[node].dist_mm_q2, simd.nodes[node].flag,
+                    scalar.nodes[node].angle_z_q14, scalar.nodes[node].dist_mm_q2, scalar.nodes[node].flag);
+            break;
+        }
+    }
+
+    decode_simd_select(DECODE_SIMD_AUTO);
+}
+
+// | predict2 10bit | predict1 10bit | major 12bit |
+static _u32 ultraCabin(Rng & rng)
+{
+    static const _u32 scaleBases[] = {
+        RPLIDAR_VARBITSCALE_X2_DEST_VAL, RPLIDAR_VARBITSCALE_X4_DEST_VAL,
+        RPLIDAR_VARBITSCALE_X8_DEST_VAL, RPLIDAR_VARBITSCALE_X16_DEST_VAL,
+    };
+
+    _u32 cabin = rng.next();
+    switch (rng.next() % 12) {
+    case 0: // no major distance, the predictions build on the next cabin
+        cabin &= ~0xFFFu;
+        break;
+    case 1: // predict1 sentinels 0x1FF and 0xFFFFFE00
+        cabin = (cabin & ~(0x3FFu << 12)) | (0x1FFu << 12);
+        break;
+    case 2:
+        cabin = (cabin & ~(0x3FFu << 12)) | (0x200u << 12);
+        break;
+    case 3: // predict2 sentinels
+        cabin = (cabin & 0x3FFFFF) | (0x1FFu << 22);
+        break;
+    case 4:
+        cabin = (cabin & 0x3FFFFF) | (0x200u << 22);
+        break;
+    case 5: // short distances, largest angle correction
+        cabin = (cabin & ~0xFFFu) | (rng.next() % 64);
+        break;
+    case 6: // around the var bit scale boundaries
+        cabin = (cabin & ~0xFFFu) | (scaleBases[rng.next() % 4] + rng.next() % 3 - 1);
+        break;
+    }
+    return cabin;
+}
+
+RP_TEST(decode_ultra_simd_matches_scalar)
+{
+    std::vector<rplidar_response_ultra_capsule_measurement_nodes_t> capsules(20000);
+    Rng rng(4);
+    int angle_q6 = 0;
+
+    for (size_t pos = 0; pos < capsules.size(); ++pos) {
+        capsules[pos].start_angle_sync_q6 = nextStartAngle(rng, angle_q6);
+        for (size_t cabin = 0; cabin < ULTRA_CAPSULE_CABINS; ++cabin) {
+            capsules[pos].ultra_cabins[cabin].combined_x3 = ultraCabin(rng);
+        }
+    }
+
+    // every cabin carrying both predict sentinels
+    for (size_t cabin = 0; cabin < ULTRA_CAPSULE_CABINS; ++cabin) {
+        capsules[100].ultra_cabins[cabin].combined_x3 = (0x200u << 22) | (0x1FFu << 12) | (cabin * 97);
+        capsules[101].ultra_cabins[cabin].combined_x3 = (0x1FFu << 22) | (0x200u << 12) | (cabin * 97);
+    }
+
+    checkSimdMatchesScalar(&DecodeDriver::_ultraCapsuleToNormal, capsules);
+}
+
+// Express and dense capsules share a layout up to the start angle; the cabins
+// are random bytes with some zero distances.
+static std::vector<rplidar_response_capsule_measurement_nodes_t> randomCapsules(_u32 seed, bool dense)
+{
+    std::vector<rplidar_response_capsule_measurement_nodes_t> capsules(20000);
+    Rng rng(seed);
+    int angle_q6 = 0;
+
+    for (size_t pos = 0; pos < capsules.size(); ++pos) {
+        _u8 * bytes = reinterpret_cast<_u8 *>(&capsules[pos]);
+        for (size_t offset = 0; offset < sizeof(capsules[pos]); ++offset) {
+            bytes[offset] = (_u8)rng.next();
+        }
+        capsules[pos].start_angle_sync_q6 = nextStartAngle(rng, angle_q6);
+
+        if (dense) {
+            rplidar_response_dense_capsule_measurement_nodes_t * capsule = reinterpret_cast<rplidar_response_dense_capsule_measurement_nodes_t *>(&capsules[pos]);
+            for (size_t cabin = 0; cabin < DENSE_CAPSULE_SAMPLES; ++cabin) {
+                if (rng.next() % 10 == 0) capsule->cabins[cabin].distance = 0;
+            }
+        } else {
+            for (size_t cabin = 0; cabin < EXPRESS_CAPSULE_CABINS; ++cabin) {
+                // keep the angle offset bits, clear the distance
+                if (rng.next() % 10 == 0) capsules[pos].cabins[cabin].distance_angle_1 &= 0x3;
+                if (rng.next() % 10 == 0) capsules[pos].cabins[cabin].distance_angle_2 &= 0x3;
+            }
+        }
+    }
+    return capsules;
+}
+
+RP_TEST(decode_express_simd_matches_scalar)
+{
+    checkSimdMatchesScalar(&DecodeDriver::_capsuleToNormal, randomCapsules(5, false));
+}
+
+RP_TEST(decode_dense_simd_matches_scalar)
+{
+    checkSimdMatchesScalar(&DecodeDriver::_dense_capsuleToNormal, randomCapsules(6, true));
+}
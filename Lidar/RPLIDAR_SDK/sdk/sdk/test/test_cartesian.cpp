@@ -0,0 +1,188 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_test.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+Node makeNode(_u32 angleQ14, _u32 distQ2, _u8 quality)
+{
+    Node node;
+    memset(&node, 0, sizeof(node));
+    node.angle_z_q14 = (_u16)angleQ14;
+    node.dist_mm_q2 = distQ2;
+    node.quality = quality;
+    return node;
+}
+
+bool near(float value, double expected, double distMm)
+{
+    // a float keeps about 7 digits of the range
+    return fabs(value - expected) <= distMm * 2e-6 + 1e-3;
+}
+
+// The point of node in double precision: angles grow clockwise, y points at 270
+// degrees, then the lidar frame is rotated counter-clockwise by yaw and moved.
+bool matchesReference(const Node & node, const RplidarTransform2D * transform, float x, float y)
+{
+    const double pi = 3.14159265358979323846;
+    double theta = node.angle_z_q14 * 2 * pi / 65536;
+    double d = node.dist_mm_q2 / 4.0;
+    double lx = d * cos(theta), ly = -d * sin(theta);
+    if (transform) {
+        double yaw = transform->yaw * pi / 180;
+        double wx = lx * cos(yaw) - ly * sin(yaw) + transform->x;
+        double wy = lx * sin(yaw) + ly * cos(yaw) + transform->y;
+        lx = wx;
+        ly = wy;
+    }
+    return near(x, lx, d) && near(y, ly, d);
+}
+
+}
+
+RP_TEST(cartesian_axis_convention)
+{
+    // 0 degrees on +x, 90 on -y, 180 on -x, 270 on +y; 1000 mm each
+    Node nodes[4] = {
+        makeNode(0, 4000, 1),
+        makeNode(1 << 14, 4000, 2),
+        makeNode(2 << 14, 4000, 3),
+        makeNode(3 << 14, 4000, 4),
+    };
+    float x[4], y[4], quality[4];
+    RP_CHECK(scan_to_cartesian(nodes, 4, NULL, x, y, quality) == 4);
+    RP_CHECK(near(x[0], 1000, 1000) && near(y[0], 0, 1000));
+    RP_CHECK(near(x[1], 0, 1000) && near(y[1], -1000, 1000));
+    RP_CHECK(near(x[2], -1000, 1000) && near(y[2], 0, 1000));
+    RP_CHECK(near(x[3], 0, 1000) && near(y[3], 1000, 1000));
+    RP_CHECK(quality[0] == 1 && quality[3] == 4);
+}
+
+RP_TEST(cartesian_applies_the_transform)
+{
+    // the lidar 100 mm along x, 50 mm back on y, turned 90 degrees counter-clockwise:
+    // its angle 0 points along +y
+    RplidarTransform2D transform = { 100, -50, 90 };
+    Node nodes[2] = {
+        makeNode(0, 8000, 1),
+        makeNode(3 << 14, 8000, 2),
+    };
+    float x[2], y[2];
+    RP_CHECK(scan_to_cartesian(nodes, 2, &transform, x, y, NULL) == 2);
+    RP_CHECK(near(x[0], 100, 2000) && near(y[0], 1950, 2000));
+    RP_CHECK(near(x[1], -1900, 2000) && near(y[1], -50, 2000));
+}
+
+RP_TEST(cartesian_skips_invalid_samples)
+{
+    Node nodes[6] = {
+        makeNode(100, 0, 9),
+        makeNode(200, 400, 1),
+        makeNode(300, 0, 9),
+        makeNode(400, 0, 9),
+        makeNode(500, 800, 2),
+        makeNode(600, 0, 9),
+    };
+    float x[6], y[6], quality[6];
+    RP_CHECK(scan_to_cartesian(nodes, 6, NULL, x, y, quality) == 2);
+    RP_CHECK(matchesReference(nodes[1], NULL, x[0], y[0]) && quality[0] == 1);
+    RP_CHECK(matchesReference(nodes[4], NULL, x[1], y[1]) && quality[1] == 2);
+
+    RP_CHECK(scan_to_cartesian(nodes, 1, NULL, x, y, quality) == 0);
+}
+
+RP_TEST(cartesian_matches_reference_for_any_count)
+{
+    // counts around the vector width and the gather chunk, with and without a
+    // transform and quality, a third of the samples invalid
+    RplidarTransform2D transform = { -1234.5f, 321.25f, -37.5f };
+    _u32 random = 7;
+    for (size_t count = 1; count <= 300; count += (count < 140 ? 1 : 13)) {
+        std::vector<Node> nodes(count);
+        std::vector<size_t> valid;
+        for (size_t pos = 0; pos < count; ++pos) {
+            random = random * 1664525u + 1013904223u;
+            _u32 dist = random % 3 ? (random >> 8) % 100000 + 1 : 0;
+            nodes[pos] = makeNode(random >> 16, dist, (_u8)(random >> 4));
+            if (dist) valid.push_back(pos);
+        }
+
+        for (int withTransform = 0; withTransform < 2; ++withTransform) {
+            const RplidarTransform2D * t = withTransform ? &transform : NULL;
+            std::vector<float> x(count), y(count), quality(count, -1.0f);
+            size_t points = scan_to_cartesian(&nodes[0], count, t, &x[0], &y[0], withTransform ? NULL : &quality[0]);
+            RP_CHECK(points == valid.size());
+
+            bool same = points == valid.size();
+            for (size_t i = 0; same && i < points; ++i) {
+                const Node & node = nodes[valid[i]];
+                same = matchesReference(node, t, x[i], y[i]);
+                if (!withTransform && quality[i] != node.quality) same = false;
+            }
+            if (withTransform && count && quality[0] != -1.0f) same = false;
+            RP_CHECK(same);
+        }
+    }
+}
+
+RP_TEST(cartesian_public_conversion)
+{
+    Node nodes[3] = {
+        makeNode(0, 4000, 1),
+        makeNode(0, 0, 1),
+        makeNode(3 << 14, 4000, 2),
+    };
+    float x[3], y[3];
+    size_t points = 99;
+    RP_CHECK(IS_OK(RPlidarDriver::ConvertScanToCartesian(nodes, 3, x, y, NULL, points)));
+    RP_CHECK(points == 2);
+    RP_CHECK(near(x[1], 0, 1000) && near(y[1], 1000, 1000));
+
+    RP_CHECK(RPlidarDriver::ConvertScanToCartesian(nodes, 3, NULL, y, NULL, points) == RESULT_INVALID_DATA);
+    RP_CHECK(points == 0);
+    RP_CHECK(IS_OK(RPlidarDriver::ConvertScanToCartesian(NULL, 0, NULL, NULL, NULL, points)));
+}
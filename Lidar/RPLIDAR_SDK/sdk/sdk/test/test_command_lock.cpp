@@ -0,0 +1,419 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/types.h"
+#include "hal/assert.h"
+#include "hal/locker.h"
+#include "hal/socket.h"
+#include "hal/event.h"
+#include "hal/mapped_file.h"
+#include "rplidar_scan_ring.h"
+#include "rplidar_interval_ring.h"
+#include "rplidar_scan_subscription.h"
+#include "rplidar_sample_timestamper.h"
+#include "rplidar_packet_scanner.h"
+#include "rplidar_packet_queue.h"
+#include "rplidar_crc32.h"
+#include "rplidar_profile_cache.h"
+#include "rplidar_spin_monitor.h"
+#include "rplidar_scan_grid.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_stream_record.h"
+#include "rplidar_decode_simd.h"
+#include "rplidar_ultra_correction.h"
+#include "rplidar_driver_impl.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+#include <vector>
+
+// The public command entry points take the driver's command lock, which is not
+// recursive. These tests run them against a fake device and fail, instead of
+// hanging, when one of them deadlocks.
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+// Answers the commands of a device without the configuration commands (firmware
+// below 1.24), and never streams any measurement.
+class OldFirmwareDevice : public ChannelDevice
+{
+public:
+    _u16  firmware;
+    bool  mute;         // counts the commands, answers none
+    int   commands[256];
+
+    OldFirmwareDevice(_u16 fw) : firmware(fw), mute(false), _readPos(0)
+    {
+        memset(commands, 0, sizeof(commands));
+    }
+
+    virtual bool bind(const char *, uint32_t) { return true; }
+    virtual void close() {}
+
+    virtual bool waitfordata(size_t data_count, _u32 timeout = -1, size_t * returned_size = NULL)
+    {
+        _u32 startTs = getms();
+        for (;;) {
+            size_t available;
+            {
+                rp::hal::AutoLocker l(_lock);
+                available = _answers.size() - _readPos;
+            }
+            if (returned_size) *returned_size = available;
+            if (available >= data_count) return true;
+            if (getms() - startTs >= timeout) return false;
+            delay(1);
+        }
+    }
+
+    virtual int recvdata(unsigned char * data, size_t size)
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (size > _answers.size() - _readPos) size = _answers.size() - _readPos;
+        if (size) memcpy(data, &_answers[_readPos], size);
+        _readPos += size;
+        return (int)size;
+    }
+
+    // one call carries one complete command packet, see _sendCommand()
+    virtual int senddata(const _u8 * data, size_t size)
+    {
+        rp::hal::AutoLocker l(_lock);
+        if (size < 2) return (int)size;
+        _u8 cmd = data[1];
+        ++commands[cmd];
+        if (mute) return (int)size;
+
+        switch (cmd) {
+        case RPLIDAR_CMD_GET_DEVICE_INFO:
+            {
+                rplidar_response_device_info_t info;
+                memset(&info, 0, sizeof(info));
+                info.model = 0x18;
+                info.firmware_version = firmware;
+                _answer(RPLIDAR_ANS_TYPE_DEVINFO, &info, sizeof(info));
+            }
+            break;
+        case RPLIDAR_CMD_GET_SAMPLERATE:
+            {
+                rplidar_response_sample_rate_t rate;
+                rate.std_sample_duration_us = 508;
+                rate.express_sample_duration_us = 254;
+                _answer(RPLIDAR_ANS_TYPE_SAMPLE_RATE, &rate, sizeof(rate));
+            }
+            break;
+        case RPLIDAR_CMD_GET_DEVICE_HEALTH:
+            {
+                rplidar_response_device_health_t health;
+                memset(&health, 0, sizeof(health));
+                _answer(RPLIDAR_ANS_TYPE_DEVHEALTH, &health, sizeof(health));
+            }
+            break;
+        case RPLIDAR_CMD_GET_ACC_BOARD_FLAG:
+            {
+                rplidar_response_acc_board_flag_t flag;
+                memset(&flag, 0, sizeof(flag));
+                _answer(RPLIDAR_ANS_TYPE_ACC_BOARD_FLAG, &flag, sizeof(flag));
+            }
+            break;
+        case RPLIDAR_CMD_SCAN:
+        case RPLIDAR_CMD_FORCE_SCAN:
+            _answer(RPLIDAR_ANS_TYPE_MEASUREMENT, NULL, sizeof(rplidar_response_measurement_node_t), RPLIDAR_ANS_PKTFLAG_LOOP);
+            break;
+        case RPLIDAR_CMD_EXPRESS_SCAN:
+            _answer(RPLIDAR_ANS_TYPE_MEASUREMENT_CAPSULED, NULL, sizeof(rplidar_response_capsule_measurement_nodes_t), RPLIDAR_ANS_PKTFLAG_LOOP);
+            break;
+        }
+        return (int)size;
+    }
+
+protected:
+    // payload NULL: a streaming answer announcing packets of size bytes
+    void _answer(_u8 type, const void * payload, size_t size, _u32 flags = 0)
+    {
+        _u8 header[7] = { RPLIDAR_ANS_SYNC_BYTE1, RPLIDAR_ANS_SYNC_BYTE2 };
+        _u32 sizeField = (_u32)size | (flags << RPLIDAR_ANS_HEADER_SUBTYPE_SHIFT);
+        memcpy(header + 2, &sizeField, sizeof(sizeField));
+        header[6] = type;
+        _answers.insert(_answers.end(), header, header + sizeof(header));
+        if (payload) _answers.insert(_answers.end(), (const _u8 *)payload, (const _u8 *)payload + size);
+    }
+
+    rp::hal::Locker  _lock;
+    std::vector<_u8> _answers;
+    size_t           _readPos;
+};
+
+class CommandDriver : public RPlidarDriverImplCommon
+{
+public:
+    CommandDriver(_u16 fw)
+    {
+        _device = new OldFirmwareDevice(fw);
+        _chanDev = _device;
+        _isConnected = true;
+    }
+
+    virtual ~CommandDriver()
+    {
+        disconnect();
+        delete _device;
+    }
+
+    virtual u_result connect(const char *, _u32, _u32) { return RESULT_OK; }
+    virtual void disconnect()
+    {
+        _commandthread.join();
+        _commandthread = rp::hal::Thread();
+        if (!_isConnected) return;
+        stop();
+        _isConnected = false;
+    }
+
+    OldFirmwareDevice * device() { return _device; }
+    bool scanning() const { return _isScanning; }
+
+protected:
+    OldFirmwareDevice * _device;
+};
+
+// Runs call on its own thread. Returns false when it has not returned within
+// timeout ms; the thread is then left blocked and the driver must not be destroyed.
+struct TimedCall {
+    CommandDriver *  driver;
+    u_result       (*call)(CommandDriver &);
+    u_result         result;
+    rp::hal::Event   done;
+
+    static _word_size_t THREAD_PROC proc(void * data)
+    {
+        TimedCall * self = static_cast<TimedCall *>(data);
+        self->result = self->call(*self->driver);
+        self->done.set();
+        return 0;
+    }
+
+    bool run(CommandDriver & drv, u_result (*fn)(CommandDriver &), _u32 timeout)
+    {
+        driver = &drv;
+        call = fn;
+        result = RESULT_OPERATION_FAIL;
+        rp::hal::Thread thread = rp::hal::Thread::create(proc, this);
+        if (done.wait(timeout) != rp::hal::Event::EVENT_OK) return false;
+        thread.join();
+        return true;
+    }
+};
+
+u_result startTypicalScan(CommandDriver & drv)
+{
+    RplidarScanMode used;
+    return drv.startScan(false, true, 0, &used);
+}
+
+u_result startNormalScan(CommandDriver & drv)
+{
+    return drv.startScan(false, false);
+}
+
+u_result querySampleDuration(CommandDriver & drv)
+{
+    rplidar_response_sample_rate_t rate;
+    return drv.getSampleDuration_uS(rate);
+}
+
+// every entry point that loads the profile or queries the device, one after the other
+u_result queryEverything(CommandDriver & drv)
+{
+    rplidar_response_device_info_t info;
+    RplidarDeviceProfile profile;
+    std::vector<RplidarScanMode> modes;
+    _u16 typical;
+    bool support;
+    u_result ans;
+
+    if (IS_FAIL(ans = drv.getDeviceInfo(info))) return ans;
+    if (IS_FAIL(ans = drv.checkSupportConfigCommands(support))) return ans;
+    if (IS_FAIL(ans = drv.getDeviceProfile(profile))) return ans;
+    if (IS_FAIL(ans = drv.getAllSupportedScanModes(modes))) return ans;
+    if (IS_FAIL(ans = drv.getTypicalScanMode(typical))) return ans;
+    if (IS_FAIL(ans = drv.checkExpressScanSupported(support))) return ans;
+    if (IS_FAIL(ans = drv.checkMotorCtrlSupport(support))) return ans;
+    return modes.size() == 2 ? RESULT_OK : RESULT_INVALID_DATA;
+}
+
+// Two threads sending commands at the same time. Each call must get its own
+// answer; a call reading the answer of the other one fails.
+struct CommandStress {
+    CommandDriver *  driver;
+    int              failures;
+
+    enum {
+        ROUNDS = 200,
+    };
+
+    static _word_size_t THREAD_PROC motorCtrlProc(void * data)
+    {
+        CommandStress * self = static_cast<CommandStress *>(data);
+        for (int i = 0; i < ROUNDS; ++i) {
+            bool support;
+            if (IS_FAIL(self->driver->checkMotorCtrlSupport(support))) ++self->failures;
+        }
+        return 0;
+    }
+
+    static u_result run(CommandDriver & drv)
+    {
+        CommandStress stress;
+        stress.driver = &drv;
+        stress.failures = 0;
+        rp::hal::Thread thread = rp::hal::Thread::create(motorCtrlProc, &stress);
+
+        int failures = 0;
+        for (int i = 0; i < ROUNDS; ++i) {
+            rplidar_response_device_info_t info;
+            if (IS_FAIL(drv.getDeviceInfo(info))) ++failures;
+        }
+        thread.join();
+        return (failures || stress.failures) ? RESULT_OPERATION_FAIL : RESULT_OK;
+    }
+};
+
+}
+
+RP_TEST(command_lock_start_scan_loads_old_firmware_profile)
+{
+    // 1.18: express scan, no configuration commands
+    CommandDriver * drv = new CommandDriver((1 << 8) | 18);
+    TimedCall call;
+
+    bool returned = call.run(*drv, startTypicalScan, 5000);
+    RP_CHECK(returned);
+    if (!returned) return;  // deadlocked, leak the driver with its blocked thread
+
+    RP_CHECK(IS_OK(call.result));
+    RP_CHECK(drv->scanning());
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_SAMPLERATE] == 1);
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_EXPRESS_SCAN] == 1);
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_LIDAR_CONF] == 0);
+    delete drv;
+}
+
+RP_TEST(command_lock_start_normal_scan_on_old_firmware)
+{
+    // 1.15: neither express scan nor the sample rate query
+    CommandDriver * drv = new CommandDriver((1 << 8) | 15);
+    TimedCall call;
+
+    bool returned = call.run(*drv, startNormalScan, 5000);
+    RP_CHECK(returned);
+    if (!returned) return;
+
+    RP_CHECK(IS_OK(call.result));
+    RP_CHECK(drv->scanning());
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_SCAN] == 1);
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_SAMPLERATE] == 0);
+    delete drv;
+}
+
+RP_TEST(command_lock_sample_duration_pauses_the_scan)
+{
+    CommandDriver * drv = new CommandDriver((1 << 8) | 18);
+    TimedCall call;
+
+    bool returned = call.run(*drv, startTypicalScan, 5000);
+    RP_CHECK(returned);
+    if (!returned) return;
+
+    returned = call.run(*drv, querySampleDuration, 5000);
+    RP_CHECK(returned);
+    if (!returned) return;
+
+    RP_CHECK(IS_OK(call.result));
+    RP_CHECK(drv->scanning());
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_EXPRESS_SCAN] == 2);
+    delete drv;
+}
+
+RP_TEST(command_lock_queries_load_old_firmware_profile)
+{
+    CommandDriver * drv = new CommandDriver((1 << 8) | 18);
+    TimedCall call;
+
+    bool returned = call.run(*drv, queryEverything, 5000);
+    RP_CHECK(returned);
+    if (!returned) return;
+
+    RP_CHECK(IS_OK(call.result));
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_SAMPLERATE] == 2);
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_ACC_BOARD_FLAG] == 1);
+    delete drv;
+}
+
+RP_TEST(command_lock_concurrent_queries)
+{
+    CommandDriver * drv = new CommandDriver((1 << 8) | 18);
+    TimedCall call;
+
+    bool returned = call.run(*drv, CommandStress::run, 10000);
+    RP_CHECK(returned);
+    if (!returned) return;
+
+    RP_CHECK(IS_OK(call.result));
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_DEVICE_INFO] == CommandStress::ROUNDS);
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_ACC_BOARD_FLAG] == CommandStress::ROUNDS);
+    delete drv;
+}
+
+RP_TEST(command_lock_profile_getters_pass_the_failure_on)
+{
+    CommandDriver * drv = new CommandDriver((1 << 8) | 18);
+    drv->device()->mute = true;
+
+    _u16 typical;
+    std::vector<RplidarScanMode> modes;
+    RP_CHECK(drv->getTypicalScanMode(typical, 50) == RESULT_OPERATION_TIMEOUT);
+    RP_CHECK(drv->getAllSupportedScanModes(modes, 50) == RESULT_OPERATION_TIMEOUT);
+    RP_CHECK(modes.empty());
+    RP_CHECK(drv->device()->commands[RPLIDAR_CMD_GET_DEVICE_INFO] == 2);
+    delete drv;
+}
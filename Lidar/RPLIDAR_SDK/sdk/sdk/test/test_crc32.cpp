@@ -0,0 +1,120 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_crc32.h"
+#include "rplidar_test.h"
+
+#include <stdlib.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+// Bit at a time, straight from the definition.
+static _u32 crc32_reference(_u32 crc, const _u8 * data, size_t len)
+{
+    while (len--) {
+        crc ^= *data++;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static std::vector<_u8> randomBytes(size_t len, unsigned seed)
+{
+    std::vector<_u8> bytes(len);
+    srand(seed);
+    for (size_t pos = 0; pos < len; ++pos) {
+        bytes[pos] = (_u8)(rand() >> 4);
+    }
+    return bytes;
+}
+
+// Every length up to a few fold blocks, at every alignment, against the reference.
+static bool matchesReference(int impl)
+{
+    std::vector<_u8> bytes = randomBytes(3000 + 16, 0x5A17EC);
+    for (size_t len = 0; len <= 3000; len += (len < 300 ? 1 : 7)) {
+        for (size_t offset = 0; offset < 16; ++offset) {
+            const _u8 * data = &bytes[offset];
+            _u32 crc = 0xFFFFFFFF;
+            if (!crc32_update_with(impl, crc, data, len)) return true; // not on this CPU
+            if (crc != crc32_reference(0xFFFFFFFF, data, len)) {
+                fprintf(stderr, "  impl %d differs at length %d offset %d\n", impl, (int)len, (int)offset);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+RP_TEST(crc32_table_matches_reference)
+{
+    RP_CHECK(matchesReference(CRC32_IMPL_TABLE));
+}
+
+RP_TEST(crc32_clmul_matches_reference)
+{
+    RP_CHECK(matchesReference(CRC32_IMPL_CLMUL));
+}
+
+RP_TEST(crc32_armv8_matches_reference)
+{
+    RP_CHECK(matchesReference(CRC32_IMPL_ARMV8));
+}
+
+RP_TEST(crc32_dispatched_matches_table)
+{
+    std::vector<_u8> bytes = randomBytes(4096, 0xC0FFEE);
+    for (size_t len = 0; len <= bytes.size(); len += 61) {
+        _u32 table = 0xFFFFFFFF;
+        crc32_update_with(CRC32_IMPL_TABLE, table, &bytes[0], len);
+        RP_CHECK(crc32_update(0xFFFFFFFF, &bytes[0], len) == table);
+    }
+}
+
+RP_TEST(crc32_hq_known_values)
+{
+    // the standard CRC-32 check value, the input is already a multiple of 4 bytes
+    const _u8 digits[] = { '1', '2', '3', '4', '5', '6', '7', '8' };
+    RP_CHECK(crc32_hq(digits, sizeof(digits)) == 0x9AE0DAAF);
+
+    // shorter inputs are zero padded
+    const _u8 padded[] = { '1', '2', '3', '4', '5', 0, 0, 0 };
+    RP_CHECK(crc32_hq(digits, 5) == crc32_hq(padded, sizeof(padded)));
+    RP_CHECK(crc32_hq(NULL, 0) == 0);
+}
@@ -0,0 +1,214 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "hal/thread.h"
+#include "rplidar_interval_ring.h"
+#include "rplidar_test.h"
+
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+// Nodes numbered from first on, the number is kept in dist_mm_q2.
+static std::vector<rplidar_response_measurement_node_hq_t> numberedNodes(_u32 first, size_t count)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes(count);
+    for (size_t pos = 0; pos < count; ++pos) {
+        memset(&nodes[pos], 0, sizeof(nodes[pos]));
+        nodes[pos].dist_mm_q2 = first + (_u32)pos;
+    }
+    return nodes;
+}
+
+static void pushNumbered(IntervalRing & ring, _u32 first, size_t count)
+{
+    std::vector<rplidar_response_measurement_node_hq_t> nodes = numberedNodes(first, count);
+    ring.push(count ? &nodes[0] : NULL, count);
+}
+
+static bool isNumbered(const rplidar_response_measurement_node_hq_t * nodes, size_t count, _u32 first)
+{
+    for (size_t pos = 0; pos < count; ++pos) {
+        if (nodes[pos].dist_mm_q2 != first + pos) return false;
+    }
+    return true;
+}
+
+RP_TEST(interval_ring_drop_newest_keeps_oldest)
+{
+    IntervalRing ring;
+    ring.resize(8);
+
+    pushNumbered(ring, 0, 5);
+    pushNumbered(ring, 5, 5);
+    RP_CHECK(ring.pending() == 8);
+    RP_CHECK(ring.droppedCount() == 2);
+
+    rplidar_response_measurement_node_hq_t out[16];
+    RP_CHECK(ring.pop(out, 16) == 8);
+    RP_CHECK(isNumbered(out, 8, 0));
+    RP_CHECK(ring.pop(out, 16) == 0);
+}
+
+RP_TEST(interval_ring_drop_oldest_keeps_newest)
+{
+    IntervalRing ring;
+    ring.resize(8);
+    ring.setPolicy(IntervalRing::DROP_OLDEST);
+
+    pushNumbered(ring, 0, 5);
+    pushNumbered(ring, 5, 7);
+
+    rplidar_response_measurement_node_hq_t out[16];
+    RP_CHECK(ring.pop(out, 16) == 8);
+    RP_CHECK(isNumbered(out, 8, 4));
+    RP_CHECK(ring.droppedCount() == 4);
+
+    // a batch larger than the ring keeps its tail
+    pushNumbered(ring, 100, 20);
+    RP_CHECK(ring.pop(out, 16) == 8);
+    RP_CHECK(isNumbered(out, 8, 112));
+    RP_CHECK(ring.droppedCount() == 16);
+}
+
+RP_TEST(interval_ring_wraps_in_two_segments)
+{
+    IntervalRing ring;
+    ring.resize(7);
+
+    // odd batch sizes move the wrap point through every index
+    _u32 pushed = 0, popped = 0;
+    bool ordered = true;
+    for (int round = 0; round < 1000; ++round) {
+        size_t batch = 1 + round % 5;
+        pushNumbered(ring, pushed, batch);
+        pushed += (_u32)batch;
+
+        rplidar_response_measurement_node_hq_t out[7];
+        size_t taken = ring.pop(out, 1 + round % 4);
+        if (!isNumbered(out, taken, popped)) ordered = false;
+        popped += (_u32)taken;
+
+        // DROP_NEWEST drops the batch that does not fit, keep the numbering
+        pushed = popped + (_u32)ring.pending();
+    }
+    RP_CHECK(ordered);
+}
+
+RP_TEST(interval_ring_resize_keeps_pending)
+{
+    IntervalRing ring;
+    ring.resize(8);
+    pushNumbered(ring, 0, 6);
+
+    rplidar_response_measurement_node_hq_t out[16];
+    ring.pop(out, 3);
+    ring.resize(4);
+    RP_CHECK(ring.pending() == 3);
+    RP_CHECK(ring.pop(out, 16) == 3);
+    RP_CHECK(isNumbered(out, 3, 3));
+}
+
+namespace {
+
+struct IntervalStress {
+    IntervalRing ring;
+    _u32         total;
+
+    IntervalStress() : total(2000000) {}
+
+    static _word_size_t THREAD_PROC producer(void * data)
+    {
+        IntervalStress * self = static_cast<IntervalStress *>(data);
+        std::vector<rplidar_response_measurement_node_hq_t> batch;
+        for (_u32 next = 0; next < self->total; ) {
+            size_t count = 1 + next % 97;
+            if (count > self->total - next) count = self->total - next;
+            batch = numberedNodes(next, count);
+            self->ring.push(&batch[0], count);
+            next += (_u32)count;
+        }
+        return 0;
+    }
+
+    // Pops until the producer is done and the ring is drained. Returns false
+    // when nodes came out of order or torn.
+    bool consume(_u64 & received)
+    {
+        rplidar_response_measurement_node_hq_t out[300];
+        bool ordered = true;
+        _u64 next = 0;
+        received = 0;
+
+        rp::hal::Thread thread = rp::hal::Thread::create(producer, this);
+        _u32 idleTs = getms();
+        while (getms() - idleTs < 200) {
+            size_t taken = ring.pop(out, 1 + received % 300);
+            if (!taken) continue;
+            idleTs = getms();
+
+            // nodes of one pop are consecutive, later ones may have been dropped
+            if (out[0].dist_mm_q2 < next || !isNumbered(out, taken, out[0].dist_mm_q2)) ordered = false;
+            next = out[taken - 1].dist_mm_q2 + 1;
+            received += taken;
+        }
+        thread.join();
+        return ordered;
+    }
+};
+
+}
+
+RP_TEST(interval_ring_concurrent_drop_newest)
+{
+    IntervalStress stress;
+    stress.ring.resize(512);
+
+    _u64 received;
+    RP_CHECK(stress.consume(received));
+    RP_CHECK(received + stress.ring.droppedCount() == stress.total);
+}
+
+RP_TEST(interval_ring_concurrent_drop_oldest)
+{
+    IntervalStress stress;
+    stress.ring.resize(512);
+    stress.ring.setPolicy(IntervalRing::DROP_OLDEST);
+
+    _u64 received;
+    RP_CHECK(stress.consume(received));
+    RP_CHECK(received + stress.ring.droppedCount() == stress.total);
+}
@@ -0,0 +1,218 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "rplidar_packet_queue.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+enum {
+    PACKET_SIZE = 84,   // an ultra capsule
+};
+
+// A packet whose every byte derives from seq.
+bool pushPacket(PacketQueue & queue, _u32 seq, size_t size = PACKET_SIZE)
+{
+    _u8 packet[RawPacket::MAX_PACKET_SIZE + 1];
+    for (size_t pos = 0; pos < size && pos < sizeof(packet); ++pos) packet[pos] = (_u8)(seq + pos);
+    memcpy(packet, &seq, sizeof(seq));
+    return queue.push(packet, size, seq, (seq & 1) != 0);
+}
+
+bool isPacket(const RawPacket * packet, _u32 seq)
+{
+    if (!packet || packet->rxUs != seq || packet->resynced != ((seq & 1) != 0)) return false;
+    _u32 stored;
+    memcpy(&stored, packet->data, sizeof(stored));
+    if (stored != seq) return false;
+    for (size_t pos = sizeof(stored); pos < PACKET_SIZE; ++pos) {
+        if (packet->data[pos] != (_u8)(seq + pos)) return false;
+    }
+    return true;
+}
+
+}
+
+RP_TEST(packet_queue_empty_times_out)
+{
+    PacketQueue queue;
+    queue.reset();
+    RP_CHECK(queue.next(0) == NULL);
+
+    _u32 startTs = getms();
+    RP_CHECK(queue.next(30) == NULL);
+    RP_CHECK(getms() - startTs >= 25);
+}
+
+RP_TEST(packet_queue_full_drops_the_newest)
+{
+    PacketQueue queue;
+    queue.reset();
+    for (_u32 seq = 0; seq < PacketQueue::DEPTH; ++seq) {
+        RP_CHECK(pushPacket(queue, seq));
+    }
+    RP_CHECK(!pushPacket(queue, PacketQueue::DEPTH));
+    RP_CHECK(queue.droppedCount() == 1);
+
+    // the packet being read still takes its slot
+    RP_CHECK(isPacket(queue.next(0), 0));
+    RP_CHECK(!pushPacket(queue, PacketQueue::DEPTH));
+    RP_CHECK(isPacket(queue.next(0), 1));
+    RP_CHECK(pushPacket(queue, PacketQueue::DEPTH));
+    RP_CHECK(queue.droppedCount() == 2);
+
+    // the queued packets kept their order, the dropped one never shows up
+    bool ordered = true;
+    for (_u32 seq = 2; seq <= PacketQueue::DEPTH; ++seq) {
+        if (!isPacket(queue.next(0), seq)) ordered = false;
+    }
+    RP_CHECK(ordered);
+    RP_CHECK(queue.next(0) == NULL);
+}
+
+RP_TEST(packet_queue_rejects_oversized_packets)
+{
+    PacketQueue queue;
+    queue.reset();
+    RP_CHECK(pushPacket(queue, 1, RawPacket::MAX_PACKET_SIZE));
+    RP_CHECK(!pushPacket(queue, 2, RawPacket::MAX_PACKET_SIZE + 1));
+    RP_CHECK(queue.droppedCount() == 1);
+    RP_CHECK(queue.next(0) != NULL);
+    RP_CHECK(queue.next(0) == NULL);
+}
+
+RP_TEST(packet_queue_wraps_around)
+{
+    PacketQueue queue;
+    queue.reset();
+
+    // batches not dividing the depth, so both indices cross the end of the slots often
+    _u32 pushed = 0, popped = 0;
+    bool ordered = true;
+    while (popped < 5 * PacketQueue::DEPTH + 7) {
+        for (int batch = 0; batch < 187; ++batch) {
+            if (!pushPacket(queue, pushed)) ordered = false;
+            ++pushed;
+        }
+        for (int batch = 0; batch < 187; ++batch) {
+            if (!isPacket(queue.next(0), popped)) ordered = false;
+            ++popped;
+        }
+    }
+    RP_CHECK(ordered);
+    RP_CHECK(queue.next(0) == NULL);
+    RP_CHECK(queue.droppedCount() == 0);
+}
+
+RP_TEST(packet_queue_close_drains_then_returns)
+{
+    PacketQueue queue;
+    queue.reset();
+    pushPacket(queue, 1);
+    pushPacket(queue, 2);
+    queue.close();
+
+    _u32 startTs = getms();
+    RP_CHECK(isPacket(queue.next(1000), 1));
+    RP_CHECK(isPacket(queue.next(1000), 2));
+    RP_CHECK(queue.next(1000) == NULL);
+    RP_CHECK(getms() - startTs < 500);
+
+    // reset empties and reopens it
+    pushPacket(queue, 3);
+    queue.reset();
+    RP_CHECK(queue.next(0) == NULL);
+    RP_CHECK(pushPacket(queue, 4));
+    RP_CHECK(isPacket(queue.next(0), 4));
+}
+
+namespace {
+
+struct QueueStress {
+    PacketQueue queue;
+    _u32        published;
+
+    QueueStress() : published(200000) { queue.reset(); }
+
+    static _word_size_t THREAD_PROC producer(void * data)
+    {
+        QueueStress * self = static_cast<QueueStress *>(data);
+        for (_u32 seq = 1; seq <= self->published; ++seq) {
+            pushPacket(self->queue, seq);
+            // let the queue fill up now and then
+            if ((seq & 0xFFF) == 0) delay(1);
+        }
+        self->queue.close();
+        return 0;
+    }
+
+    // Reads until the queue is closed and drained. Returns false when a packet
+    // came out of order or with the content of another one.
+    bool consume(_u32 & received)
+    {
+        bool ordered = true;
+        _u32 last = 0;
+        received = 0;
+        rp::hal::Thread thread = rp::hal::Thread::create(producer, this);
+        while (const RawPacket * packet = queue.next(1000)) {
+            _u32 seq = (_u32)packet->rxUs;
+            if (seq <= last || !isPacket(packet, seq)) ordered = false;
+            last = seq;
+            ++received;
+        }
+        thread.join();
+        return ordered;
+    }
+};
+
+}
+
+RP_TEST(packet_queue_concurrent_producer_consumer)
+{
+    QueueStress stress;
+    _u32 received;
+    RP_CHECK(stress.consume(received));
+    RP_CHECK(received > 0);
+    RP_CHECK(received + stress.queue.droppedCount() == stress.published);
+}
@@ -0,0 +1,254 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_packet_scanner.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+typedef std::vector<_u8> Bytes;
+
+// Hands out scripted reads, one per recvdata() call, with no delay.
+class ScriptedChannel : public ChannelDevice
+{
+public:
+    std::vector<Bytes> reads;
+    size_t             next;
+
+    ScriptedChannel() : next(0) {}
+
+    virtual bool bind(const char *, uint32_t) { return true; }
+    virtual void close() {}
+    virtual int senddata(const _u8 *, size_t size) { return (int)size; }
+
+    virtual bool waitfordata(size_t, _u32, size_t * returned_size)
+    {
+        if (next == reads.size()) return false;
+        if (returned_size) *returned_size = reads[next].size();
+        return true;
+    }
+
+    virtual int recvdata(unsigned char * data, size_t size)
+    {
+        if (next == reads.size()) return 0;
+        Bytes & read = reads[next];
+        size_t taken = size < read.size() ? size : read.size();
+        memcpy(data, &read[0], taken);
+        read.erase(read.begin(), read.begin() + taken);
+        if (read.empty()) ++next;
+        return (int)taken;
+    }
+};
+
+// 8 byte packets: 0xA? 0x5? sync nibbles, the payload, then the xor of bytes 2-6.
+bool validateXor(const _u8 * packet)
+{
+    _u8 sum = 0;
+    for (int pos = 2; pos < 7; ++pos) sum ^= packet[pos];
+    return sum == packet[7];
+}
+
+const PacketFormat TEST_FORMAT = { 8, { 0xF0, 0xF0 }, { 0xA0, 0x50 }, validateXor };
+
+Bytes makePacket(_u8 seq)
+{
+    Bytes packet(8);
+    packet[0] = 0xA0 | (seq & 0xF);
+    packet[1] = 0x50 | (seq >> 4);
+    for (int pos = 2; pos < 7; ++pos) packet[pos] = (_u8)(seq * 31 + pos);
+    packet[7] = 0;
+    for (int pos = 2; pos < 7; ++pos) packet[7] ^= packet[pos];
+    return packet;
+}
+
+// bytes that never start a sync pair
+Bytes makeGarbage(size_t size, _u32 seed)
+{
+    Bytes garbage(size);
+    for (size_t pos = 0; pos < size; ++pos) {
+        seed = seed * 1664525u + 1013904223u;
+        garbage[pos] = (_u8)((seed >> 24) & 0x7F);
+    }
+    return garbage;
+}
+
+void append(Bytes & to, const Bytes & bytes)
+{
+    to.insert(to.end(), bytes.begin(), bytes.end());
+}
+
+bool isPacket(const _u8 * packet, _u8 seq)
+{
+    Bytes expected = makePacket(seq);
+    return memcmp(packet, &expected[0], expected.size()) == 0;
+}
+
+}
+
+RP_TEST(packet_scanner_in_sync)
+{
+    ScriptedChannel chan;
+    Bytes stream;
+    for (_u8 seq = 0; seq < 20; ++seq) append(stream, makePacket(seq));
+    chan.reads.push_back(stream);
+
+    PacketScanner scanner;
+    const _u8 * packet;
+    bool all = true;
+    for (_u8 seq = 0; seq < 20; ++seq) {
+        if (scanner.next(&chan, TEST_FORMAT, packet, 100) != RESULT_OK || !isPacket(packet, seq) || scanner.skippedBytes()) {
+            all = false;
+        }
+    }
+    RP_CHECK(all);
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, packet, 10) == RESULT_OPERATION_TIMEOUT);
+}
+
+RP_TEST(packet_scanner_skips_garbage_before_a_header)
+{
+    // every garbage length up to past two vector widths, so the sync lands in
+    // each lane of the vectorized search and in its scalar tail
+    bool all = true;
+    for (size_t garbage = 1; garbage <= 40; ++garbage) {
+        ScriptedChannel chan;
+        Bytes stream = makeGarbage(garbage, (_u32)garbage);
+        append(stream, makePacket(7));
+        append(stream, makePacket(8));
+        chan.reads.push_back(stream);
+
+        PacketScanner scanner;
+        const _u8 * packet;
+        if (scanner.next(&chan, TEST_FORMAT, packet, 100) != RESULT_OK || !isPacket(packet, 7)
+            || scanner.skippedBytes() != garbage) {
+            all = false;
+        }
+        if (scanner.next(&chan, TEST_FORMAT, packet, 100) != RESULT_OK || !isPacket(packet, 8)
+            || scanner.skippedBytes() != 0) {
+            all = false;
+        }
+    }
+    RP_CHECK(all);
+}
+
+RP_TEST(packet_scanner_joins_a_split_header)
+{
+    // the reads split the packet after its first sync byte, then within its payload
+    ScriptedChannel chan;
+    Bytes first = makeGarbage(21, 5), second, third;
+    Bytes packet = makePacket(0x3C);
+    first.push_back(packet[0]);
+    second.assign(packet.begin() + 1, packet.begin() + 4);
+    third.assign(packet.begin() + 4, packet.end());
+    append(third, makePacket(0x3D));
+    chan.reads.push_back(first);
+    chan.reads.push_back(second);
+    chan.reads.push_back(third);
+
+    PacketScanner scanner;
+    const _u8 * found;
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, found, 100) == RESULT_OK);
+    RP_CHECK(isPacket(found, 0x3C));
+    RP_CHECK(scanner.skippedBytes() == 21);
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, found, 100) == RESULT_OK);
+    RP_CHECK(isPacket(found, 0x3D));
+}
+
+RP_TEST(packet_scanner_resyncs_after_a_bad_checksum)
+{
+    ScriptedChannel chan;
+    Bytes stream = makePacket(1);
+    Bytes corrupt = makePacket(2);
+    corrupt[4] ^= 0x10;
+    append(stream, corrupt);
+    // a false sync pair inside garbage, and a packet cut short by a new header
+    Bytes garbage = makeGarbage(30, 9);
+    garbage[12] = 0xA4;
+    garbage[13] = 0x51;
+    append(stream, garbage);
+    Bytes cut = makePacket(3);
+    stream.insert(stream.end(), cut.begin(), cut.begin() + 5);
+    append(stream, makePacket(4));
+    chan.reads.push_back(stream);
+
+    PacketScanner scanner;
+    const _u8 * packet;
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, packet, 100) == RESULT_OK);
+    RP_CHECK(isPacket(packet, 1));
+
+    // the corrupt packet, the garbage and the cut packet are all skipped
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, packet, 100) == RESULT_OK);
+    RP_CHECK(isPacket(packet, 4));
+    RP_CHECK(scanner.skippedBytes() == 8 + 30 + 5);
+}
+
+RP_TEST(packet_scanner_times_out_on_garbage)
+{
+    ScriptedChannel chan;
+    Bytes garbage = makeGarbage(100, 11);
+    garbage.push_back(0xA0);     // may still start a sync pair
+    chan.reads.push_back(garbage);
+
+    PacketScanner scanner;
+    const _u8 * packet;
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, packet, 20) == RESULT_OPERATION_TIMEOUT);
+
+    // the kept byte and the rest of the packet arriving later
+    Bytes rest = makePacket(0x50);
+    rest.erase(rest.begin());
+    chan.reads.push_back(rest);
+    RP_CHECK(scanner.next(&chan, TEST_FORMAT, packet, 100) == RESULT_OK);
+    RP_CHECK(isPacket(packet, 0x50));
+    RP_CHECK(scanner.skippedBytes() == 0);
+}
+
+RP_TEST(packet_scanner_rejects_bad_sizes)
+{
+    ScriptedChannel chan;
+    PacketScanner scanner;
+    const _u8 * packet;
+    PacketFormat tiny = TEST_FORMAT;
+    tiny.size = 1;
+    RP_CHECK(scanner.next(&chan, tiny, packet, 10) == RESULT_INVALID_DATA);
+    PacketFormat huge = TEST_FORMAT;
+    huge.size = ChannelDevice::READ_AHEAD_SIZE + 1;
+    RP_CHECK(scanner.next(&chan, huge, packet, 10) == RESULT_INVALID_DATA);
+}
@@ -0,0 +1,242 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_profile_cache.h"
+#include "rplidar_test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+enum {
+    FILE_HEADER_SIZE = 13,  // magic, version, conf_supported, typical_mode, mode count
+    FILE_MODE_SIZE   = 75,  // id, us_per_sample, max_distance, ans_type, scan_mode
+};
+
+RplidarDeviceProfile makeProfile(_u8 serialSeed, _u16 firmware)
+{
+    RplidarDeviceProfile profile;
+    memset(&profile.info, 0, sizeof(profile.info));
+    profile.info.model = 0x61;
+    profile.info.firmware_version = firmware;
+    for (size_t pos = 0; pos < sizeof(profile.info.serialnum); ++pos) {
+        profile.info.serialnum[pos] = (_u8)(serialSeed + pos * 17);
+    }
+    profile.conf_supported = true;
+    profile.typical_mode = 3;
+
+    const char * names[] = { "Standard", "Express", "Boost", "Sensitivity", "Stability" };
+    for (_u16 id = 0; id < _countof(names); ++id) {
+        RplidarScanMode mode;
+        memset(&mode, 0, sizeof(mode));
+        mode.id = id;
+        mode.us_per_sample = 500.0f / (id + 1);
+        mode.max_distance = 12.0f + id;
+        mode.ans_type = (_u8)(RPLIDAR_ANS_TYPE_MEASUREMENT + id);
+        strcpy(mode.scan_mode, names[id]);
+        profile.modes.push_back(mode);
+    }
+    return profile;
+}
+
+// the cache file of profile, in the current directory
+std::string cachePath(const RplidarDeviceProfile & profile)
+{
+    char name[64];
+    int len = sprintf(name, "./rplidar_");
+    for (size_t pos = 0; pos < sizeof(profile.info.serialnum); ++pos) {
+        len += sprintf(name + len, "%02X", profile.info.serialnum[pos]);
+    }
+    sprintf(name + len, "_%04X.profile", profile.info.firmware_version);
+    return name;
+}
+
+std::vector<_u8> readFile(const std::string & path)
+{
+    std::vector<_u8> content;
+    FILE * file = fopen(path.c_str(), "rb");
+    if (!file) return content;
+    _u8 buffer[256];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) != 0) content.insert(content.end(), buffer, buffer + got);
+    fclose(file);
+    return content;
+}
+
+void writeFile(const std::string & path, const std::vector<_u8> & content)
+{
+    FILE * file = fopen(path.c_str(), "wb");
+    if (!file) return;
+    if (!content.empty()) fwrite(&content[0], content.size(), 1, file);
+    fclose(file);
+}
+
+bool sameModes(const std::vector<RplidarScanMode> & a, const std::vector<RplidarScanMode> & b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t pos = 0; pos < a.size(); ++pos) {
+        if (a[pos].id != b[pos].id || a[pos].us_per_sample != b[pos].us_per_sample
+            || a[pos].max_distance != b[pos].max_distance || a[pos].ans_type != b[pos].ans_type
+            || strcmp(a[pos].scan_mode, b[pos].scan_mode) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// a profile holding only the device info of profile, as the driver has it before loading
+RplidarDeviceProfile lookup(const RplidarDeviceProfile & profile)
+{
+    RplidarDeviceProfile query;
+    query.info = profile.info;
+    query.conf_supported = false;
+    query.typical_mode = 0;
+    return query;
+}
+
+}
+
+RP_TEST(profile_cache_round_trip)
+{
+    RplidarDeviceProfile saved = makeProfile(1, (1 << 8) | 29);
+    RP_CHECK(saveDeviceProfile(".", saved));
+    RP_CHECK(readFile(cachePath(saved)).size() == FILE_HEADER_SIZE + saved.modes.size() * FILE_MODE_SIZE);
+
+    RplidarDeviceProfile loaded = lookup(saved);
+    RP_CHECK(loadDeviceProfile(".", loaded));
+    RP_CHECK(loaded.conf_supported == saved.conf_supported);
+    RP_CHECK(loaded.typical_mode == saved.typical_mode);
+    RP_CHECK(sameModes(loaded.modes, saved.modes));
+
+    // a directory given with its separator names the same file
+    loaded = lookup(saved);
+    RP_CHECK(loadDeviceProfile("./", loaded));
+    RP_CHECK(sameModes(loaded.modes, saved.modes));
+
+    // no modes at all, e.g. a device not answering the configuration commands
+    RplidarDeviceProfile empty = makeProfile(2, (1 << 8) | 15);
+    empty.modes.clear();
+    empty.conf_supported = false;
+    RP_CHECK(saveDeviceProfile(".", empty));
+    loaded = lookup(empty);
+    loaded.modes.push_back(saved.modes[0]);
+    RP_CHECK(loadDeviceProfile(".", loaded));
+    RP_CHECK(loaded.modes.empty() && !loaded.conf_supported);
+
+    remove(cachePath(saved).c_str());
+    remove(cachePath(empty).c_str());
+}
+
+RP_TEST(profile_cache_is_per_device_and_firmware)
+{
+    RplidarDeviceProfile saved = makeProfile(3, (1 << 8) | 29);
+    RP_CHECK(saveDeviceProfile(".", saved));
+
+    // a firmware update leaves the entry of the old firmware stale
+    RplidarDeviceProfile updated = lookup(saved);
+    updated.info.firmware_version = (1 << 8) | 30;
+    RP_CHECK(!loadDeviceProfile(".", updated));
+    RP_CHECK(updated.modes.empty());
+
+    RplidarDeviceProfile other = lookup(makeProfile(4, (1 << 8) | 29));
+    RP_CHECK(!loadDeviceProfile(".", other));
+
+    RplidarDeviceProfile missingDir = lookup(saved);
+    RP_CHECK(!loadDeviceProfile("./no_such_directory", missingDir));
+    RP_CHECK(!saveDeviceProfile("./no_such_directory", saved));
+
+    remove(cachePath(saved).c_str());
+}
+
+RP_TEST(profile_cache_rejects_corrupt_files)
+{
+    RplidarDeviceProfile saved = makeProfile(5, (1 << 8) | 29);
+    RP_CHECK(saveDeviceProfile(".", saved));
+    const std::string path = cachePath(saved);
+    const std::vector<_u8> good = readFile(path);
+    RP_CHECK(good.size() == FILE_HEADER_SIZE + saved.modes.size() * FILE_MODE_SIZE);
+    if (good.size() != FILE_HEADER_SIZE + saved.modes.size() * FILE_MODE_SIZE) return;
+
+    std::vector<std::vector<_u8> > corrupt;
+    std::vector<_u8> file;
+
+    file = good;
+    file[0] ^= 0xFF;                    // magic
+    corrupt.push_back(file);
+
+    file = good;
+    file[4] = 2;                        // a version this build does not know
+    corrupt.push_back(file);
+
+    file = good;
+    file[11] = 0x01;                    // 257 modes, past the limit
+    file[12] = 0x01;
+    corrupt.push_back(file);
+
+    file = good;
+    file[11] = (_u8)(saved.modes.size() + 1);   // more modes than the file holds
+    corrupt.push_back(file);
+
+    // cut in the last mode, in the header, and empty
+    corrupt.push_back(std::vector<_u8>(good.begin(), good.end() - 1));
+    corrupt.push_back(std::vector<_u8>(good.begin(), good.begin() + FILE_HEADER_SIZE - 1));
+    corrupt.push_back(std::vector<_u8>());
+
+    for (size_t k = 0; k < corrupt.size(); ++k) {
+        writeFile(path, corrupt[k]);
+        RplidarDeviceProfile loaded = lookup(saved);
+        bool rejected = !loadDeviceProfile(".", loaded);
+        RP_CHECK(rejected);
+        // a rejected file leaves the profile alone
+        RP_CHECK(loaded.modes.empty() && !loaded.conf_supported && loaded.typical_mode == 0);
+    }
+
+    // an unterminated mode name is cut, not overrun
+    file = good;
+    memset(&file[FILE_HEADER_SIZE + 11], 'x', 64);
+    writeFile(path, file);
+    RplidarDeviceProfile loaded = lookup(saved);
+    RP_CHECK(loadDeviceProfile(".", loaded));
+    RP_CHECK(!loaded.modes.empty() && strlen(loaded.modes[0].scan_mode) == 63);
+
+    remove(path.c_str());
+}
@@ -0,0 +1,277 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "rplidar_sample_timestamper.h"
+#include "rplidar_test.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+// Hands out scripted reads, one per recvdata() call.
+class ScriptedChannel : public ChannelDevice
+{
+public:
+    std::vector<std::vector<_u8> > reads;
+    size_t                         next;
+
+    ScriptedChannel() : next(0) {}
+
+    virtual bool bind(const char *, uint32_t) { return true; }
+    virtual void close() {}
+    virtual int senddata(const _u8 *, size_t size) { return (int)size; }
+
+    virtual bool waitfordata(size_t, _u32, size_t * returned_size)
+    {
+        if (next == reads.size()) return false;
+        if (returned_size) *returned_size = reads[next].size();
+        return true;
+    }
+
+    virtual int recvdata(unsigned char * data, size_t size)
+    {
+        if (next == reads.size()) return 0;
+        std::vector<_u8> & read = reads[next];
+        size_t taken = size < read.size() ? size : read.size();
+        memcpy(data, &read[0], taken);
+        read.erase(read.begin(), read.begin() + taken);
+        if (read.empty()) ++next;
+        delay(2);   // the next read arrives later
+        return (int)taken;
+    }
+};
+
+}
+
+// Packets framed from the read-ahead buffer carry the receive time of the read
+// that delivered their last byte, not the time they were parsed.
+RP_TEST(channel_stamps_bytes_with_their_read)
+{
+    ScriptedChannel chan;
+    chan.reads.push_back(std::vector<_u8>(25, 1));  // packets 0, 1 and half of 2
+    chan.reads.push_back(std::vector<_u8>(15, 2));  // the rest of packet 2, packet 3
+
+    const _u8 * data;
+    size_t available;
+    _u64 stamps[4];
+    for (int packet = 0; packet < 4; ++packet) {
+        RP_CHECK(chan.peek(10, data, available, 100));
+        chan.consume(10);
+        stamps[packet] = chan.consumedRxUs();
+    }
+
+    RP_CHECK(stamps[0] != 0);
+    RP_CHECK(stamps[1] == stamps[0]);
+    RP_CHECK(stamps[2] > stamps[1]);
+    RP_CHECK(stamps[3] == stamps[2]);
+}
+
+RP_TEST(channel_stamps_survive_compaction)
+{
+    ScriptedChannel chan;
+    for (int read = 0; read < 200; ++read) {
+        chan.reads.push_back(std::vector<_u8>(100, (_u8)read));
+    }
+
+    // 60 byte packets straddle the reads and move the buffer front past its middle
+    const _u8 * data;
+    size_t available;
+    _u64 last = 0;
+    bool monotonic = true;
+    for (int packet = 0; packet < 200 * 100 / 60; ++packet) {
+        if (!chan.peek(60, data, available, 100)) break;
+        chan.consume(60);
+        if (chan.consumedRxUs() < last) monotonic = false;
+        last = chan.consumedRxUs();
+    }
+    RP_CHECK(monotonic);
+    RP_CHECK(last != 0);
+}
+
+// Three packets of 32 samples per read, one read every 9.6 ms: 100 us per sample.
+static float stampReads(float nominalUs, size_t reads)
+{
+    SampleTimestamper timestamper;
+    _u64 timestamps[32];
+    timestamper.reset(nominalUs);
+    for (size_t read = 1; read <= reads; ++read) {
+        for (int packet = 0; packet < 3; ++packet) {
+            timestamper.stamp(1000000 + read * 9600, 32, timestamps);
+        }
+    }
+    return timestamper.usPerSample();
+}
+
+RP_TEST(timestamper_counts_packets_sharing_a_read)
+{
+    // packets sharing an arrival time must not drag the rate towards 0
+    RP_CHECK(fabs(stampReads(100, 1000) - 100) < 0.5f);
+    RP_CHECK(fabs(stampReads(0, 1000) - 100) < 0.5f);
+    RP_CHECK(fabs(stampReads(150, 1000) - 100) < 1.0f);
+}
+
+RP_TEST(timestamper_spreads_samples_backwards)
+{
+    SampleTimestamper timestamper;
+    _u64 timestamps[4];
+    timestamper.reset(100);
+    timestamper.stamp(10000, 4, timestamps);
+    RP_CHECK(timestamps[3] == 10000);
+    RP_CHECK(timestamps[0] == 10000 - 300);
+}
+
+namespace {
+
+// A device clock running drift ppm fast, sending a capsule every periodUs device
+// microseconds. Each arrival is the true host time of the capsule plus a constant
+// minimum latency and an exponential jitter of jitterUs mean.
+struct SimulatedDevice {
+    _u64   deviceTs;
+    _u64   hostBaseUs;
+    double ppm;
+    _u32   periodUs;
+    double minLatencyUs;
+    double jitterUs;
+    _u32   random;
+
+    SimulatedDevice(double driftPpm)
+        : deviceTs(7000000)
+        , hostBaseUs(123456789)
+        , ppm(driftPpm)
+        , periodUs(1000)
+        , minLatencyUs(800)
+        , jitterUs(2000)
+        , random(12345)
+    {
+    }
+
+    // host time the capsule carrying deviceTs was measured at
+    double trueHost(_u64 ts) const
+    {
+        return hostBaseUs + (double)(ts - 7000000) * (1 + ppm * 1e-6);
+    }
+
+    double uniform()
+    {
+        random = random * 1664525u + 1013904223u;
+        return ((random >> 8) + 0.5) / 16777216.0;
+    }
+
+    _u64 nextArrival()
+    {
+        deviceTs += periodUs;
+        return (_u64)(trueHost(deviceTs) + minLatencyUs - jitterUs * log(uniform()));
+    }
+};
+
+// Runs seconds of simulated traffic and returns the largest error of the converted
+// times against the true host time plus the minimum latency over the last tailSeconds.
+double runClockSync(DeviceClockSync & sync, SimulatedDevice & dev, int seconds, int tailSeconds)
+{
+    double worst = 0;
+    size_t packets = (size_t)seconds * 1000000 / dev.periodUs;
+    size_t tail = (size_t)tailSeconds * 1000000 / dev.periodUs;
+    for (size_t packet = 0; packet < packets; ++packet) {
+        _u64 arrival = dev.nextArrival();
+        _u64 host = sync.update(dev.deviceTs, arrival);
+        if (packet + tail >= packets) {
+            double error = fabs((double)host - (dev.trueHost(dev.deviceTs) + dev.minLatencyUs));
+            if (error > worst) worst = error;
+        }
+    }
+    return worst;
+}
+
+}
+
+RP_TEST(clock_sync_converges_on_drift_and_offset)
+{
+    DeviceClockSync sync;
+    SimulatedDevice dev(50);
+
+    // the first windows only fit the drift, then the converted times hold the lower envelope
+    double worst = runClockSync(sync, dev, 40, 20);
+    RP_CHECK(fabs(sync.drift() - (1 + 50e-6)) < 1e-6);
+    RP_CHECK(worst < 20);
+
+    SimulatedDevice slow(-120);
+    sync.reset();
+    worst = runClockSync(sync, slow, 40, 20);
+    RP_CHECK(fabs(sync.drift() - (1 - 120e-6)) < 1e-6);
+    RP_CHECK(worst < 20);
+}
+
+RP_TEST(clock_sync_resets_when_the_device_clock_goes_back)
+{
+    DeviceClockSync sync;
+    SimulatedDevice dev(50);
+    runClockSync(sync, dev, 20, 1);
+    RP_CHECK(sync.drift() != 1);
+
+    // a device reset restarts its counter, the model starts over from this arrival
+    _u64 arrival = dev.nextArrival();
+    RP_CHECK(sync.update(1000, arrival) == arrival);
+    RP_CHECK(sync.drift() == 1);
+    RP_CHECK(sync.update(2000, arrival + 1000) == arrival + 1000);
+}
+
+RP_TEST(clock_sync_resets_on_a_step_past_max_error)
+{
+    DeviceClockSync sync;
+    SimulatedDevice dev(50);
+    runClockSync(sync, dev, 20, 1);
+
+    // a late arrival within MAX_ERROR_US is latency, it keeps the model
+    _u64 arrival = dev.nextArrival() + DeviceClockSync::MAX_ERROR_US / 2;
+    _u64 host = sync.update(dev.deviceTs, arrival);
+    RP_CHECK(fabs(sync.drift() - (1 + 50e-6)) < 1e-6);
+    RP_CHECK(fabs((double)host - (dev.trueHost(dev.deviceTs) + dev.minLatencyUs)) < 20);
+
+    // a stream stalled for longer than MAX_ERROR_US restarts it from this arrival
+    dev.hostBaseUs += DeviceClockSync::MAX_ERROR_US + 100000;
+    arrival = dev.nextArrival();
+    RP_CHECK(sync.update(dev.deviceTs, arrival) == arrival);
+    RP_CHECK(sync.drift() == 1);
+
+    // and it converges again
+    double worst = runClockSync(sync, dev, 40, 20);
+    RP_CHECK(fabs(sync.drift() - (1 + 50e-6)) < 1e-6);
+    RP_CHECK(worst < 20);
+}
@@ -0,0 +1,172 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_scan_arrays.h"
+#include "rplidar_test.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+enum {
+    CHUNK_NODES = 65536,         // every q14 angle once
+    RANGE_EXACT_Q2 = 1 << 24,    // the float mantissa, see rplidar_scan_arrays.h
+};
+
+// Chunk c holds every angle, paired with the distances c * 65536 ... c * 65536 + 65535.
+void fillChunk(std::vector<Node> & nodes, _u32 chunk)
+{
+    for (_u32 i = 0; i < CHUNK_NODES; ++i) {
+        nodes[i].angle_z_q14 = (_u16)i;
+        nodes[i].dist_mm_q2 = chunk * CHUNK_NODES + (i * 40503u & 0xFFFF);
+        nodes[i].quality = (_u8)(i * 7);
+        nodes[i].flag = (_u8)(i >> 8);
+    }
+}
+
+bool sameNodes(const std::vector<Node> & a, const std::vector<Node> & b)
+{
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].angle_z_q14 != b[i].angle_z_q14 || a[i].dist_mm_q2 != b[i].dist_mm_q2
+            || a[i].quality != b[i].quality || a[i].flag != b[i].flag) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+RP_TEST(scan_arrays_round_trip_below_2_24)
+{
+    std::vector<Node> nodes(CHUNK_NODES), back(CHUNK_NODES);
+    std::vector<float> angle(CHUNK_NODES), range(CHUNK_NODES), scalarAngle(CHUNK_NODES), scalarRange(CHUNK_NODES);
+    std::vector<_u8> quality(CHUNK_NODES), flag(CHUNK_NODES), scalarQuality(CHUNK_NODES), scalarFlag(CHUNK_NODES);
+
+    bool exact = true, sameAsScalar = true;
+    // 256 chunks: every distance below 2^24 once, every angle in each chunk
+    for (_u32 chunk = 0; chunk < RANGE_EXACT_Q2 / CHUNK_NODES; ++chunk) {
+        fillChunk(nodes, chunk);
+
+        // the whole chunk takes the SIMD path, one node at a time only the scalar tail
+        scan_to_arrays(&nodes[0], CHUNK_NODES, &angle[0], &range[0], &quality[0], &flag[0]);
+        for (size_t i = 0; i < CHUNK_NODES; ++i) {
+            scan_to_arrays(&nodes[i], 1, &scalarAngle[i], &scalarRange[i], &scalarQuality[i], &scalarFlag[i]);
+        }
+        if (memcmp(&angle[0], &scalarAngle[0], CHUNK_NODES * sizeof(float))
+            || memcmp(&range[0], &scalarRange[0], CHUNK_NODES * sizeof(float))
+            || quality != scalarQuality || flag != scalarFlag) {
+            sameAsScalar = false;
+        }
+
+        arrays_to_scan(&angle[0], &range[0], &quality[0], &flag[0], CHUNK_NODES, &back[0]);
+        if (!sameNodes(nodes, back)) exact = false;
+    }
+    RP_CHECK(sameAsScalar);
+    RP_CHECK(exact);
+}
+
+RP_TEST(scan_arrays_tail_lengths)
+{
+    // counts around the SIMD width leave 0 to 7 nodes to the scalar tail
+    std::vector<Node> nodes(CHUNK_NODES);
+    fillChunk(nodes, 255);
+
+    for (size_t count = 1; count <= 19; ++count) {
+        std::vector<float> angle(count + 1, -1.0f), range(count + 1, -1.0f);
+        std::vector<_u8> quality(count + 1, 0xAA), flag(count + 1, 0xAA);
+        const Node * src = &nodes[CHUNK_NODES - 1 - count * 97];
+
+        scan_to_arrays(src, count, &angle[0], &range[0], &quality[0], &flag[0]);
+        bool exact = true;
+        for (size_t i = 0; i < count; ++i) {
+            if (angle[i] != src[i].angle_z_q14 * (float)(2 * 3.14159265358979323846 / 65536)
+                || range[i] != src[i].dist_mm_q2 * 0.25f
+                || quality[i] != src[i].quality || flag[i] != src[i].flag) {
+                exact = false;
+            }
+        }
+        RP_CHECK(exact);
+        // nothing written past count
+        RP_CHECK(angle[count] == -1.0f && range[count] == -1.0f);
+        RP_CHECK(quality[count] == 0xAA && flag[count] == 0xAA);
+    }
+}
+
+RP_TEST(scan_arrays_without_quality_and_flag)
+{
+    std::vector<Node> nodes(CHUNK_NODES), back(37);
+    fillChunk(nodes, 3);
+    std::vector<float> angle(37), range(37);
+
+    scan_to_arrays(&nodes[100], 37, &angle[0], &range[0], NULL, NULL);
+    arrays_to_scan(&angle[0], &range[0], NULL, NULL, 37, &back[0]);
+    bool exact = true;
+    for (size_t i = 0; i < 37; ++i) {
+        const Node & src = nodes[100 + i];
+        if (back[i].angle_z_q14 != src.angle_z_q14 || back[i].dist_mm_q2 != src.dist_mm_q2
+            || back[i].quality != 0 || back[i].flag != 0) {
+            exact = false;
+        }
+    }
+    RP_CHECK(exact);
+}
+
+RP_TEST(scan_arrays_public_round_trip)
+{
+    std::vector<Node> nodes(CHUNK_NODES), back(CHUNK_NODES);
+    fillChunk(nodes, 17);
+    std::vector<float> angle(CHUNK_NODES), range(CHUNK_NODES);
+    std::vector<_u8> quality(CHUNK_NODES), flag(CHUNK_NODES);
+
+    RP_CHECK(IS_OK(RPlidarDriver::ConvertScanToArrays(&nodes[0], CHUNK_NODES, &angle[0], &range[0], &quality[0], &flag[0])));
+
+    RplidarScanArrays arrays;
+    memset(&arrays, 0, sizeof(arrays));
+    arrays.angle_rad = &angle[0];
+    arrays.range_mm = &range[0];
+    arrays.quality = &quality[0];
+    arrays.flag = &flag[0];
+    arrays.count = CHUNK_NODES;
+    RP_CHECK(IS_OK(RPlidarDriver::ConvertArraysToScan(arrays, &back[0])));
+    RP_CHECK(sameNodes(nodes, back));
+}
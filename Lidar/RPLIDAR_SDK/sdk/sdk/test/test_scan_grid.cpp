@@ -0,0 +1,213 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_scan_grid.h"
+#include "rplidar_test.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+typedef rplidar_response_measurement_node_hq_t Node;
+
+Node makeNode(_u32 angleQ14, _u32 distQ2, _u8 quality)
+{
+    Node node;
+    memset(&node, 0, sizeof(node));
+    node.angle_z_q14 = (_u16)angleQ14;
+    node.dist_mm_q2 = distQ2;
+    node.quality = quality;
+    return node;
+}
+
+// angle of the given fraction (in 1/1000) of the way through bin, in q14 units
+_u32 angleInBin(size_t bin, size_t bins, _u32 permille)
+{
+    return (_u32)(((_u64)bin * 1000 + permille) * 65536 / (bins * 1000));
+}
+
+bool onlyBinsSet(const std::vector<float> & ranges, const size_t * set, size_t setCount)
+{
+    for (size_t bin = 0; bin < ranges.size(); ++bin) {
+        bool expected = false;
+        for (size_t k = 0; k < setCount; ++k) expected = expected || set[k] == bin;
+        if (!expected && ranges[bin] != 0) return false;
+    }
+    return true;
+}
+
+}
+
+RP_TEST(scan_grid_reduce_min)
+{
+    const size_t bins = 360;
+    std::vector<Node> nodes;
+    nodes.push_back(makeNode(angleInBin(10, bins, 100), 4000, 10));
+    nodes.push_back(makeNode(angleInBin(10, bins, 500), 2000, 20));
+    nodes.push_back(makeNode(angleInBin(10, bins, 900), 3000, 30));
+    nodes.push_back(makeNode(angleInBin(10, bins, 700), 0, 99));    // invalid, closer than all
+    nodes.push_back(makeNode(angleInBin(200, bins, 300), 4444, 44));
+
+    ScanGrid grid;
+    std::vector<float> ranges(bins, -1.0f);
+    std::vector<_u8> qualities(bins, 0xAA);
+    RP_CHECK(grid.resample(&nodes[0], nodes.size(), bins, GRID_REDUCE_MIN, &ranges[0], &qualities[0]));
+
+    RP_CHECK(ranges[10] == 500.0f && qualities[10] == 20);
+    RP_CHECK(ranges[200] == 1111.0f && qualities[200] == 44);
+    size_t set[] = { 10, 200 };
+    RP_CHECK(onlyBinsSet(ranges, set, _countof(set)));
+    RP_CHECK(qualities[0] == 0 && qualities[359] == 0);
+}
+
+RP_TEST(scan_grid_reduce_nearest)
+{
+    const size_t bins = 720;
+    std::vector<Node> nodes;
+    nodes.push_back(makeNode(angleInBin(33, bins, 50), 4000, 10));
+    nodes.push_back(makeNode(angleInBin(33, bins, 580), 8000, 20));  // nearest to the center
+    nodes.push_back(makeNode(angleInBin(33, bins, 300), 1000, 30));
+    nodes.push_back(makeNode(angleInBin(33, bins, 500), 0, 99));     // invalid, right on the center
+    nodes.push_back(makeNode(angleInBin(34, bins, 990), 1200, 40));
+
+    ScanGrid grid;
+    std::vector<float> ranges(bins);
+    std::vector<_u8> qualities(bins);
+    RP_CHECK(grid.resample(&nodes[0], nodes.size(), bins, GRID_REDUCE_NEAREST, &ranges[0], &qualities[0]));
+
+    RP_CHECK(ranges[33] == 2000.0f && qualities[33] == 20);
+    RP_CHECK(ranges[34] == 300.0f && qualities[34] == 40);
+    size_t set[] = { 33, 34 };
+    RP_CHECK(onlyBinsSet(ranges, set, _countof(set)));
+}
+
+RP_TEST(scan_grid_reduce_mean)
+{
+    const size_t bins = 90;
+    std::vector<Node> nodes;
+    nodes.push_back(makeNode(angleInBin(5, bins, 100), 4000, 10));
+    nodes.push_back(makeNode(angleInBin(5, bins, 500), 2000, 21));
+    nodes.push_back(makeNode(angleInBin(5, bins, 900), 6000, 30));
+    nodes.push_back(makeNode(angleInBin(5, bins, 700), 0, 99));     // invalid, not averaged in
+
+    ScanGrid grid;
+    std::vector<float> ranges(bins);
+    std::vector<_u8> qualities(bins);
+    RP_CHECK(grid.resample(&nodes[0], nodes.size(), bins, GRID_REDUCE_MEAN, &ranges[0], &qualities[0]));
+
+    RP_CHECK(ranges[5] == 1000.0f);
+    RP_CHECK(qualities[5] == 20);   // 61 / 3 rounded
+    size_t set[] = { 5 };
+    RP_CHECK(onlyBinsSet(ranges, set, _countof(set)));
+
+    // the accumulators of the previous scan are cleared, and NULL qualities are accepted
+    RP_CHECK(grid.resample(&nodes[3], 1, bins, GRID_REDUCE_MEAN, &ranges[0], NULL));
+    RP_CHECK(onlyBinsSet(ranges, NULL, 0));
+}
+
+RP_TEST(scan_grid_wraps_into_the_last_bin)
+{
+    const size_t binCounts[] = { 1, 7, 360, 1000, 4096 };
+    for (size_t k = 0; k < _countof(binCounts); ++k) {
+        size_t bins = binCounts[k];
+        std::vector<Node> nodes;
+        nodes.push_back(makeNode(65535, 400, 1));   // just below 360 degrees
+        nodes.push_back(makeNode(0, 800, 2));
+
+        ScanGrid grid;
+        std::vector<float> ranges(bins);
+        RP_CHECK(grid.resample(&nodes[0], nodes.size(), bins, GRID_REDUCE_MEAN, &ranges[0], NULL));
+        if (bins == 1) {
+            RP_CHECK(ranges[0] == 150.0f);
+        } else {
+            RP_CHECK(ranges[bins - 1] == 100.0f);
+            RP_CHECK(ranges[0] == 200.0f);
+        }
+    }
+}
+
+RP_TEST(scan_grid_rejects_bad_arguments)
+{
+    Node node = makeNode(100, 400, 1);
+    float range;
+    ScanGrid grid;
+    RP_CHECK(!grid.resample(&node, 1, 0, GRID_REDUCE_MIN, &range, NULL));
+    RP_CHECK(!grid.resample(&node, 1, 1, GRID_REDUCE_MIN, NULL, NULL));
+    RP_CHECK(!grid.resample(&node, 1, 1, 0x7, &range, NULL));
+}
+
+RP_TEST(scan_grid_mean_matches_scalar)
+{
+    // the vectorized range division against the scalar loop, for bin counts
+    // leaving every tail length
+    _u32 random = 99;
+    for (size_t bins = 1; bins <= 1447; bins += (bins < 40 ? 1 : 101)) {
+        std::vector<Node> nodes(3 * bins);
+        std::vector<float> sum(bins), qsum(bins), count(bins);
+        for (size_t pos = 0; pos < nodes.size(); ++pos) {
+            random = random * 1664525u + 1013904223u;
+            _u32 angle = random >> 16;
+            random = random * 1664525u + 1013904223u;
+            _u32 dist = (random >> 8) % 40000;
+            nodes[pos] = makeNode(angle, dist, (_u8)(random >> 24));
+
+            size_t bin = (size_t)(((_u64)angle * bins) >> 16);
+            if (!dist) continue;
+            sum[bin] += (float)dist;
+            qsum[bin] += nodes[pos].quality;
+            count[bin] += 1;
+        }
+
+        ScanGrid grid;
+        std::vector<float> ranges(bins);
+        std::vector<_u8> qualities(bins);
+        RP_CHECK(grid.resample(&nodes[0], nodes.size(), bins, GRID_REDUCE_MEAN, &ranges[0], &qualities[0]));
+
+        bool same = true;
+        for (size_t bin = 0; bin < bins; ++bin) {
+            float expected = count[bin] > 0 ? sum[bin] * 0.25f / count[bin] : 0.0f;
+            _u8 expectedQuality = count[bin] > 0 ? (_u8)(qsum[bin] / count[bin] + 0.5f) : 0;
+            // NEON divides by a refined reciprocal estimate, SSE2 and the scalar loop exactly
+            if (fabs(ranges[bin] - expected) > expected * 1e-6f || qualities[bin] != expectedQuality) same = false;
+        }
+        RP_CHECK(same);
+    }
+}
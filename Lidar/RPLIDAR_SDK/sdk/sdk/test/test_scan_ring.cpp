@@ -0,0 +1,212 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "rplidar_scan_ring.h"
+#include "rplidar_test.h"
+
+using namespace rp::standalone::rplidar;
+
+static const RplidarScan * makeScan(ScanPool & pool, _u64 seq)
+{
+    PooledScan * scan = pool.acquire();
+    ScanTiming timing = {};
+    scan->writeNodes()[0].dist_mm_q2 = (_u32)seq;
+    scan->seal(seq, 1, timing, 0);
+    return scan;
+}
+
+// publish() takes its own reference, the producer drops the one from acquire()
+static bool publishScan(ScanRing & ring, ScanPool & pool, _u64 seq)
+{
+    const RplidarScan * scan = makeScan(pool, seq);
+    bool queued = ring.publish(scan);
+    scan->release();
+    return queued;
+}
+
+RP_TEST(scan_ring_keep_latest_hands_out_newest)
+{
+    ScanPool pool(16);
+    ScanRing ring;
+    ring.resize(ScanRing::DEFAULT_DEPTH);
+
+    RP_CHECK(publishScan(ring, pool, 1));
+    RP_CHECK(!publishScan(ring, pool, 2));
+    RP_CHECK(!publishScan(ring, pool, 3));
+    RP_CHECK(ring.droppedCount() == 2);
+
+    const RplidarScan * scan = ring.beginRead(0);
+    RP_CHECK(scan && scan->info().seq == 3);
+    RP_CHECK(scan && scan->nodes()[0].dist_mm_q2 == 3);
+    ring.releaseRead();
+
+    RP_CHECK(ring.beginRead(0) == NULL);
+
+    // the replaced scans went back to the pool
+    RP_CHECK(pool.allocatedCount() <= 2);
+}
+
+RP_TEST(scan_ring_keep_latest_reader_keeps_its_scan)
+{
+    ScanPool pool(16);
+    ScanRing ring;
+    ring.resize(ScanRing::DEFAULT_DEPTH);
+
+    publishScan(ring, pool, 1);
+    const RplidarScan * scan = ring.beginRead(0);
+    RP_CHECK(scan && scan->info().seq == 1);
+
+    // a scan published while the consumer reads does not replace its scan
+    publishScan(ring, pool, 2);
+    RP_CHECK(ring.beginRead(0) == scan);
+    RP_CHECK(scan->nodes()[0].dist_mm_q2 == 1);
+    ring.releaseRead();
+
+    scan = ring.beginRead(0);
+    RP_CHECK(scan && scan->info().seq == 2);
+    ring.releaseRead();
+    RP_CHECK(ring.droppedCount() == 0);
+}
+
+RP_TEST(scan_ring_drop_newest_keeps_order)
+{
+    ScanPool pool(16);
+    ScanRing ring;
+    ring.resize(4);
+    ring.setPolicy(ScanRing::DROP_NEWEST);
+
+    for (_u64 seq = 1; seq <= 4; ++seq) {
+        RP_CHECK(publishScan(ring, pool, seq));
+    }
+    RP_CHECK(!publishScan(ring, pool, 5));
+    RP_CHECK(!publishScan(ring, pool, 6));
+    RP_CHECK(ring.droppedCount() == 2);
+
+    // the slot being read still counts as queued, it is never overwritten
+    const RplidarScan * scan = ring.beginRead(0);
+    RP_CHECK(!publishScan(ring, pool, 7));
+    RP_CHECK(scan && scan->info().seq == 1 && scan->nodes()[0].dist_mm_q2 == 1);
+    ring.releaseRead();
+
+    for (_u64 seq = 2; seq <= 4; ++seq) {
+        scan = ring.beginRead(0);
+        RP_CHECK(scan && scan->info().seq == seq);
+        ring.releaseRead();
+    }
+    RP_CHECK(ring.beginRead(0) == NULL);
+}
+
+RP_TEST(scan_ring_clear_releases_scans)
+{
+    ScanPool pool(16);
+    {
+        ScanRing ring;
+        ring.resize(4);
+        ring.setPolicy(ScanRing::DROP_NEWEST);
+        publishScan(ring, pool, 1);
+        publishScan(ring, pool, 2);
+        ring.beginRead(0);
+    }
+    // every scan came back, the pool frees them all
+    pool.trim();
+    RP_CHECK(pool.allocatedCount() == 0);
+}
+
+namespace {
+
+struct RingStress {
+    ScanPool  pool;
+    ScanRing  ring;
+    _u64      published;
+
+    RingStress() : pool(16), published(20000) {}
+
+    static _word_size_t THREAD_PROC producer(void * data)
+    {
+        RingStress * self = static_cast<RingStress *>(data);
+        for (_u64 seq = 1; seq <= self->published; ++seq) {
+            publishScan(self->ring, self->pool, seq);
+        }
+        return 0;
+    }
+
+    // Reads until the ring stays empty. Returns false when a scan came out of
+    // order or with the content of another scan.
+    bool consume(_u64 & received, _u64 & last)
+    {
+        bool ordered = true;
+        received = 0;
+        last = 0;
+        rp::hal::Thread thread = rp::hal::Thread::create(producer, this);
+        while (const RplidarScan * scan = ring.beginRead(200)) {
+            _u64 seq = scan->info().seq;
+            if (seq <= last || scan->nodes()[0].dist_mm_q2 != (_u32)seq) ordered = false;
+            ring.releaseRead();
+            last = seq;
+            ++received;
+        }
+        thread.join();
+        return ordered;
+    }
+};
+
+}
+
+RP_TEST(scan_ring_concurrent_keep_latest)
+{
+    RingStress stress;
+    stress.ring.resize(ScanRing::DEFAULT_DEPTH);
+
+    _u64 received, last;
+    RP_CHECK(stress.consume(received, last));
+    RP_CHECK(last == stress.published);
+    RP_CHECK(received + stress.ring.droppedCount() == stress.published);
+}
+
+RP_TEST(scan_ring_concurrent_drop_newest)
+{
+    RingStress stress;
+    stress.ring.resize(ScanRing::DEFAULT_DEPTH);
+    stress.ring.setPolicy(ScanRing::DROP_NEWEST);
+
+    _u64 received, last;
+    RP_CHECK(stress.consume(received, last));
+    RP_CHECK(received > 0);
+    RP_CHECK(received + stress.ring.droppedCount() == stress.published);
+}
@@ -0,0 +1,224 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+#include "sdkcommon.h"
+#include "hal/thread.h"
+#include "hal/locker.h"
+#include "hal/event.h"
+#include "rplidar_scan_pool.h"
+#include "rplidar_scan_subscription.h"
+#include "rplidar_test.h"
+
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+static PooledScan * sealedScan(ScanPool & pool, _u64 seq)
+{
+    PooledScan * scan = pool.acquire();
+    ScanTiming timing = {};
+    scan->writeNodes()[0].dist_mm_q2 = (_u32)seq;
+    scan->seal(seq, 1, timing, 0);
+    return scan;
+}
+
+RP_TEST(scan_pool_recycles_released_scans)
+{
+    ScanPool pool(8);
+
+    PooledScan * first = sealedScan(pool, 1);
+    first->addRef();
+    first->release();
+    RP_CHECK(pool.acquire() != first);  // still referenced once
+    RP_CHECK(pool.allocatedCount() == 2);
+
+    first->release();
+    RP_CHECK(pool.acquire() == first);
+    RP_CHECK(pool.allocatedCount() == 2);
+}
+
+RP_TEST(scan_pool_seal_keeps_truncated_scans_in_bounds)
+{
+    ScanPool pool(8);
+    PooledScan * scan = pool.acquire();
+    ScanTiming timing = {};
+
+    scan->seal(1, 12, timing, 3);
+    RP_CHECK(scan->count() == 8);
+    RP_CHECK(scan->info().truncated == 3);
+    scan->release();
+}
+
+RP_TEST(scan_pool_steady_state_does_not_allocate)
+{
+    ScanPool pool(8);
+    ScanSubscription a(1, 2, NULL, NULL);
+    ScanSubscription b(2, 3, NULL, NULL);
+
+    for (_u64 seq = 1; seq <= 1000; ++seq) {
+        PooledScan * scan = sealedScan(pool, seq);
+        a.push(scan);
+        b.push(scan);
+        scan->release();
+        if (seq % 2 == 0) {
+            const RplidarScan * taken = a.pop(0);
+            if (taken) taken->release();
+        }
+    }
+    // in flight at most: both backlogs and the scan being filled
+    RP_CHECK(pool.allocatedCount() <= 2 + 3 + 1);
+}
+
+RP_TEST(scan_pool_resize_frees_old_scans)
+{
+    ScanPool pool(8);
+    PooledScan * held = sealedScan(pool, 1);
+    PooledScan * idle = sealedScan(pool, 2);
+    idle->release();
+
+    pool.setCapacity(16);
+    RP_CHECK(pool.allocatedCount() == 1);
+
+    // a scan of the old size is freed when it comes back, not recycled
+    held->release();
+    RP_CHECK(pool.allocatedCount() == 0);
+
+    PooledScan * scan = pool.acquire();
+    RP_CHECK(scan->capacity() == 16);
+    scan->release();
+}
+
+RP_TEST(scan_subscription_drops_oldest)
+{
+    ScanPool pool(8);
+    ScanSubscription sub(1, 3, NULL, NULL);
+
+    for (_u64 seq = 1; seq <= 5; ++seq) {
+        PooledScan * scan = sealedScan(pool, seq);
+        sub.push(scan);
+        scan->release();
+    }
+
+    for (_u64 seq = 3; seq <= 5; ++seq) {
+        const RplidarScan * scan = sub.pop(0);
+        RP_CHECK(scan && scan->info().seq == seq);
+        if (scan) scan->release();
+    }
+    RP_CHECK(sub.pop(0) == NULL);
+
+    // the dropped scans went back to the pool
+    pool.trim();
+    RP_CHECK(pool.allocatedCount() == 0);
+}
+
+RP_TEST(scan_subscription_shares_scans)
+{
+    ScanPool pool(8);
+    ScanSubscription a(1, 4, NULL, NULL);
+    ScanSubscription b(2, 4, NULL, NULL);
+
+    PooledScan * scan = sealedScan(pool, 7);
+    a.push(scan);
+    b.push(scan);
+    scan->release();
+
+    const RplidarScan * fromA = a.pop(0);
+    const RplidarScan * fromB = b.pop(0);
+    RP_CHECK(fromA == scan && fromB == scan);
+
+    fromA->release();
+    RP_CHECK(pool.acquire() != scan);   // b still holds it
+    fromB->release();
+    RP_CHECK(pool.acquire() == scan);
+}
+
+namespace {
+
+struct CallbackLog {
+    rp::hal::Locker     lock;
+    std::vector<_u64>   seqs;
+    bool                intact;
+
+    CallbackLog() : intact(true) {}
+
+    static void onScan(const RplidarScan & scan, void * userData)
+    {
+        CallbackLog * self = static_cast<CallbackLog *>(userData);
+        rp::hal::AutoLocker l(self->lock);
+        if (scan.nodes()[0].dist_mm_q2 != (_u32)scan.info().seq) self->intact = false;
+        self->seqs.push_back(scan.info().seq);
+    }
+
+    size_t count()
+    {
+        rp::hal::AutoLocker l(lock);
+        return seqs.size();
+    }
+};
+
+}
+
+RP_TEST(scan_subscription_callback_delivery)
+{
+    ScanPool pool(8);
+    CallbackLog log;
+    {
+        ScanSubscription sub(1, 2000, CallbackLog::onScan, &log);
+        sub.start();
+
+        for (_u64 seq = 1; seq <= 1000; ++seq) {
+            PooledScan * scan = sealedScan(pool, seq);
+            sub.push(scan);
+            scan->release();
+        }
+
+        _u32 startTs = getms();
+        while (log.count() < 1000 && getms() - startTs < 5000) {
+            delay(1);
+        }
+        sub.stop();
+    }
+
+    RP_CHECK(log.seqs.size() == 1000);
+    RP_CHECK(log.intact);
+    for (size_t pos = 0; pos < log.seqs.size(); ++pos) {
+        RP_CHECK(log.seqs[pos] == pos + 1);
+        if (log.seqs[pos] != pos + 1) break;
+    }
+
+    // every reference was given back, also by the destroyed subscription
+    pool.trim();
+    RP_CHECK(pool.allocatedCount() == 0);
+}
@@ -0,0 +1,151 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_spin_monitor.h"
+#include "rplidar_test.h"
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+// frequencies 1/8 apart from 8 Hz are exact in float, the tolerance boundary is exact too
+RplidarSpinCriterion makeCriterion(float minFrequency, float tolerance, _u32 stableScans)
+{
+    RplidarSpinCriterion criterion = { minFrequency, tolerance, stableScans };
+    return criterion;
+}
+
+}
+
+RP_TEST(spin_monitor_default_criterion)
+{
+    // 2 Hz, 5%, 3 rotations
+    SpinMonitor monitor;
+    RP_CHECK(!monitor.stable() && monitor.frequency() == 0);
+
+    const float ramp[] = { 0.5f, 1.0f, 1.5f, 1.99f };
+    for (size_t pos = 0; pos < _countof(ramp); ++pos) {
+        monitor.update(ramp[pos]);
+        RP_CHECK(!monitor.stable());
+    }
+    RP_CHECK(monitor.frequency() == 1.99f);
+
+    monitor.update(2.0f);
+    monitor.update(2.05f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(2.06f);
+    RP_CHECK(monitor.stable());
+}
+
+RP_TEST(spin_monitor_speed_threshold)
+{
+    SpinMonitor monitor;
+    monitor.setCriterion(makeCriterion(8.0f, 0.125f, 3));
+
+    // steady, but too slow
+    for (int pos = 0; pos < 10; ++pos) monitor.update(7.875f);
+    RP_CHECK(!monitor.stable());
+
+    // the minimum itself is fast enough
+    monitor.update(8.0f);
+    monitor.update(8.0f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(8.0f);
+    RP_CHECK(monitor.stable());
+
+    // one slow rotation starts the count over
+    monitor.update(7.875f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(8.0f);
+    monitor.update(8.0f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(8.0f);
+    RP_CHECK(monitor.stable());
+}
+
+RP_TEST(spin_monitor_tolerance_threshold)
+{
+    SpinMonitor monitor;
+    monitor.setCriterion(makeCriterion(1.0f, 0.125f, 3));
+
+    // 1/8 of 8 Hz is exactly 1 Hz: a change of 1 Hz still counts
+    monitor.update(8.0f);
+    monitor.update(9.0f);
+    monitor.update(8.0f);
+    RP_CHECK(monitor.stable());
+
+    // a change past the tolerance is a new speed, counted from 1
+    monitor.update(9.125f);
+    RP_CHECK(!monitor.stable());
+    RP_CHECK(monitor.frequency() == 9.125f);
+    monitor.update(9.125f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(9.0f);
+    RP_CHECK(monitor.stable());
+}
+
+RP_TEST(spin_monitor_stall_resets)
+{
+    SpinMonitor monitor;
+    monitor.setCriterion(makeCriterion(1.0f, 0.125f, 2));
+    monitor.update(8.0f);
+    monitor.update(8.0f);
+    RP_CHECK(monitor.stable());
+
+    // a rotation that could not be measured is a stall
+    monitor.update(0);
+    RP_CHECK(!monitor.stable() && monitor.frequency() == 0);
+    monitor.update(8.0f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(8.0f);
+    RP_CHECK(monitor.stable());
+
+    monitor.reset();
+    RP_CHECK(!monitor.stable() && monitor.frequency() == 0);
+}
+
+RP_TEST(spin_monitor_single_rotation_criterion)
+{
+    // 0 rotations is taken as 1: the first rotation fast enough is stable
+    SpinMonitor monitor;
+    monitor.setCriterion(makeCriterion(5.0f, 0.05f, 0));
+    RP_CHECK(!monitor.stable());
+    monitor.update(4.0f);
+    RP_CHECK(!monitor.stable());
+    monitor.update(6.0f);
+    RP_CHECK(monitor.stable());
+}
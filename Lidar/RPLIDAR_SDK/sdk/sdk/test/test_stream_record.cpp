@@ -0,0 +1,322 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+
+#include "hal/abs_rxtx.h"
+#include "hal/thread.h"
+#include "hal/types.h"
+#include "hal/assert.h"
+#include "hal/locker.h"
+#include "hal/socket.h"
+#include "hal/event.h"
+#include "hal/mapped_file.h"
+#include "rplidar_scan_ring.h"
+#include "rplidar_interval_ring.h"
+#include "rplidar_scan_subscription.h"
+#include "rplidar_sample_timestamper.h"
+#include "rplidar_packet_scanner.h"
+#include "rplidar_packet_queue.h"
+#include "rplidar_crc32.h"
+#include "rplidar_profile_cache.h"
+#include "rplidar_spin_monitor.h"
+#include "rplidar_scan_grid.h"
+#include "rplidar_cartesian.h"
+#include "rplidar_stream_record.h"
+#include "rplidar_decode_simd.h"
+#include "rplidar_ultra_correction.h"
+#include "rplidar_driver_impl.h"
+#include "rplidar_driver_replay.h"
+#include "rplidar_test.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+const char RECORDING[] = "test_stream_record.rec";
+const char TRUNCATED[] = "test_stream_record_truncated.rec";
+
+enum {
+    PACE_GAP_MS = 150,      // recorded between the two answer chunks of command B
+};
+
+typedef std::vector<_u8> Bytes;
+
+Bytes bytes(const char * text)
+{
+    return Bytes(text, text + strlen(text));
+}
+
+struct Record {
+    _u8   type;
+    Bytes data;
+};
+
+// Three commands and their answers, command B answered in two chunks
+// PACE_GAP_MS apart, command C followed by a stream of two reads.
+std::vector<Record> script()
+{
+    const char * steps[][2] = {
+        { "T", "cmd-A" },
+        { "R", "answer-A-1" },
+        { "R", "answer-A-2" },
+        { "T", "cmd-B" },
+        { "R", "answer-B-1" },
+        { "R", "answer-B-2" },
+        { "T", "cmd-C" },
+        { "R", "stream-C-1" },
+        { "R", "stream-C-2" },
+    };
+    std::vector<Record> records;
+    for (size_t i = 0; i < _countof(steps); ++i) {
+        Record record;
+        record.type = steps[i][0][0] == 'T' ? STREAM_RECORD_TX : STREAM_RECORD_RX;
+        record.data = bytes(steps[i][1]);
+        records.push_back(record);
+    }
+    return records;
+}
+
+bool recordScript(const char * path)
+{
+    StreamRecorder recorder;
+    if (!recorder.start(path)) return false;
+    std::vector<Record> records = script();
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (records[i].data == bytes("answer-B-2")) delay(PACE_GAP_MS);
+        recorder.record(records[i].type, &records[i].data[0], records[i].data.size());
+    }
+    recorder.stop();
+    // nothing is written once stopped
+    recorder.record(STREAM_RECORD_RX, &records[0].data[0], records[0].data.size());
+    return true;
+}
+
+Bytes readFile(const char * path)
+{
+    Bytes content;
+    FILE * file = fopen(path, "rb");
+    if (!file) return content;
+    _u8 buffer[256];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) != 0) content.insert(content.end(), buffer, buffer + got);
+    fclose(file);
+    return content;
+}
+
+bool writeFile(const char * path, const Bytes & content)
+{
+    FILE * file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = content.empty() || fwrite(&content[0], content.size(), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+void send(ReplayChannelDevice & dev, const char * command)
+{
+    Bytes data = bytes(command);
+    dev.senddata(&data[0], data.size());
+}
+
+// everything released within timeout ms, as text
+std::string receive(ReplayChannelDevice & dev, size_t expected, _u32 timeout)
+{
+    size_t available = 0;
+    dev.waitfordata(expected, timeout, &available);
+    std::string text(available, '\0');
+    if (available) text.resize(dev.recvdata((unsigned char *)&text[0], available));
+    return text;
+}
+
+}
+
+RP_TEST(stream_record_file_format)
+{
+    RP_CHECK(recordScript(RECORDING));
+    Bytes file = readFile(RECORDING);
+    RP_CHECK(file.size() > STREAM_RECORD_FILE_HEADER);
+    if (file.size() <= STREAM_RECORD_FILE_HEADER) return;
+
+    _u32 version, reserved;
+    memcpy(&version, &file[8], 4);
+    memcpy(&reserved, &file[12], 4);
+    RP_CHECK(memcmp(&file[0], STREAM_RECORD_MAGIC, sizeof(STREAM_RECORD_MAGIC)) == 0);
+    RP_CHECK(version == STREAM_RECORD_VERSION);
+    RP_CHECK(reserved == 0);
+
+    std::vector<Record> records = script();
+    size_t pos = STREAM_RECORD_FILE_HEADER;
+    _u64 lastUs = 0;
+    bool same = true;
+    for (size_t i = 0; i < records.size(); ++i) {
+        StreamRecordHeader header;
+        if (pos + sizeof(header) > file.size()) {
+            same = false;
+            break;
+        }
+        memcpy(&header, &file[pos], sizeof(header));
+        pos += sizeof(header);
+        if (header.type != records[i].type || header.size != records[i].data.size()
+            || header.reserved[0] || header.reserved[1] || header.reserved[2]
+            || header.timestamp_us < lastUs || pos + header.size > file.size()
+            || memcmp(&file[pos], &records[i].data[0], header.size) != 0) {
+            same = false;
+            break;
+        }
+        lastUs = header.timestamp_us;
+        pos += header.size;
+    }
+    RP_CHECK(same);
+    RP_CHECK(pos == file.size());
+    remove(RECORDING);
+}
+
+RP_TEST(stream_record_rejects_other_files)
+{
+    Bytes file = bytes("RPLRECOX and then some bytes");
+    RP_CHECK(writeFile(RECORDING, file));
+    ReplayChannelDevice dev;
+    RP_CHECK(!dev.bind(RECORDING, REPLAY_FAST));
+
+    RP_CHECK(writeFile(RECORDING, Bytes(STREAM_RECORD_MAGIC, STREAM_RECORD_MAGIC + sizeof(STREAM_RECORD_MAGIC))));
+    RP_CHECK(!dev.bind(RECORDING, REPLAY_FAST));
+    RP_CHECK(!dev.bind("test_stream_record_missing.rec", REPLAY_FAST));
+    remove(RECORDING);
+}
+
+RP_TEST(stream_record_answers_follow_their_command)
+{
+    RP_CHECK(recordScript(RECORDING));
+    ReplayChannelDevice dev;
+    RP_CHECK(dev.bind(RECORDING, REPLAY_FAST));
+
+    // nothing comes before the first command, nor for a command never recorded
+    RP_CHECK(receive(dev, 1, 50).empty());
+    send(dev, "cmd-X");
+    RP_CHECK(receive(dev, 1, 50).empty());
+
+    send(dev, "cmd-A");
+    RP_CHECK(receive(dev, 20, 1000) == "answer-A-1answer-A-2");
+    RP_CHECK(receive(dev, 1, 50).empty());
+
+    // answers may be read in pieces across the record boundaries
+    send(dev, "cmd-B");
+    RP_CHECK(dev.waitfordata(20, 1000));
+    char piece[7];
+    RP_CHECK(dev.recvdata((unsigned char *)piece, 7) == 7 && memcmp(piece, "answer-", 7) == 0);
+    RP_CHECK(dev.recvdata((unsigned char *)piece, 7) == 7 && memcmp(piece, "B-1answ", 7) == 0);
+    RP_CHECK(receive(dev, 6, 1000) == "er-B-2");
+
+    send(dev, "cmd-C");
+    RP_CHECK(receive(dev, 20, 1000) == "stream-C-1stream-C-2");
+    dev.close();
+    remove(RECORDING);
+}
+
+RP_TEST(stream_record_skips_ahead_to_a_later_command)
+{
+    RP_CHECK(recordScript(RECORDING));
+    ReplayChannelDevice dev;
+    RP_CHECK(dev.bind(RECORDING, REPLAY_FAST));
+
+    // the unread answer of A and the whole exchange of B are skipped
+    send(dev, "cmd-A");
+    RP_CHECK(dev.waitfordata(20, 1000));
+    send(dev, "cmd-C");
+    RP_CHECK(receive(dev, 20, 1000) == "stream-C-1stream-C-2");
+
+    // and there is no way back
+    send(dev, "cmd-A");
+    RP_CHECK(receive(dev, 1, 50).empty());
+    dev.close();
+    remove(RECORDING);
+}
+
+RP_TEST(stream_record_ignores_a_truncated_last_record)
+{
+    RP_CHECK(recordScript(RECORDING));
+    Bytes file = readFile(RECORDING);
+    // cut in the data of the last record, then in its header
+    size_t cuts[] = { 3, 10 + 5 };
+    for (size_t k = 0; k < _countof(cuts); ++k) {
+        RP_CHECK(writeFile(TRUNCATED, Bytes(file.begin(), file.end() - cuts[k])));
+        ReplayChannelDevice dev;
+        RP_CHECK(dev.bind(TRUNCATED, REPLAY_FAST));
+        send(dev, "cmd-C");
+        RP_CHECK(receive(dev, 20, 100) == "stream-C-1");
+        dev.close();
+    }
+    remove(TRUNCATED);
+    remove(RECORDING);
+}
+
+RP_TEST(stream_record_real_time_and_fast_pacing)
+{
+    RP_CHECK(recordScript(RECORDING));
+
+    // real time: the second chunk comes PACE_GAP_MS after the first
+    {
+        ReplayChannelDevice dev;
+        RP_CHECK(dev.bind(RECORDING, REPLAY_REAL_TIME));
+        _u32 startMs = getms();
+        send(dev, "cmd-B");
+        RP_CHECK(receive(dev, 10, 1000) == "answer-B-1");
+        RP_CHECK(!dev.waitfordata(10, PACE_GAP_MS / 3));
+        RP_CHECK(receive(dev, 10, 1000) == "answer-B-2");
+        _u32 elapsed = getms() - startMs;
+        RP_CHECK(elapsed >= PACE_GAP_MS - 10);
+        RP_CHECK(elapsed < PACE_GAP_MS + 500);
+        dev.close();
+    }
+
+    // fast: both at once
+    {
+        ReplayChannelDevice dev;
+        RP_CHECK(dev.bind(RECORDING, REPLAY_FAST));
+        _u32 startMs = getms();
+        send(dev, "cmd-B");
+        RP_CHECK(receive(dev, 20, 1000) == "answer-B-1answer-B-2");
+        RP_CHECK(getms() - startMs < PACE_GAP_MS / 3);
+        dev.close();
+    }
+    remove(RECORDING);
+}
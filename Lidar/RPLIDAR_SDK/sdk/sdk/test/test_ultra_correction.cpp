@@ -0,0 +1,99 @@
+/*
+ *  RPLIDAR SDK
+ *
+ *  Copyright (c) 2009 - 2014 RoboPeak Team
+ *  http://www.robopeak.com
+ *  Copyright (c) 2014 - 2019 Shanghai Slamtec Co., Ltd.
+ *  http://www.slamtec.com
+ *
+ */
+/*
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ *    this list of conditions and the following disclaimer in the documentation 
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, 
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR 
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, 
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, 
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; 
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR 
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, 
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+
+
+#include "sdkcommon.h"
+#include "rplidar_ultra_correction.h"
+#include "rplidar_test.h"
+
+using namespace rp::standalone::rplidar;
+
+namespace {
+
+// The correction _ultraCapsuleToNormal() evaluated for every sample before the
+// table: a series in k2 = 98361 / dist_q2 in q16 radians, converted to q16 degrees.
+_s32 formulaCorrection(int dist_q2)
+{
+    int offsetAngleMean_q16 = (int)(7.5 * 3.1415926535 * (1 << 16) / 180.0);
+    if (dist_q2 >= (50 * 4)) {
+        const int k1 = 98361;
+        const int k2 = int(k1 / dist_q2);
+        offsetAngleMean_q16 = (int)(8 * 3.1415926535 * (1 << 16) / 180) - (k2 << 6) - (k2 * k2 * k2) / 98304;
+    }
+    return int(offsetAngleMean_q16 * 180 / 3.14159265);
+}
+
+}
+
+RP_TEST(ultra_correction_table_matches_formula)
+{
+    // every table entry, at the whole millimetre it stands for
+    const _s32 * table = ultra_angle_correction_table();
+    int mismatches = 0;
+    for (int mm = 0; mm < ULTRA_CORRECTION_TABLE_SIZE; ++mm) {
+        if (table[mm] != formulaCorrection(mm << 2)) ++mismatches;
+    }
+    RP_CHECK(mismatches == 0);
+    RP_CHECK(table == ultra_angle_correction_table());
+}
+
+RP_TEST(ultra_correction_exact_for_whole_millimetres)
+{
+    // the documented bound: no error for any dist_q2 that is a multiple of 4,
+    // the only values the ultra capsule decoder produces, clamping included
+    const _s32 * table = ultra_angle_correction_table();
+    int mismatches = 0;
+    for (int dist_q2 = -(1 << 26); dist_q2 < (1 << 26); dist_q2 += 4) {
+        if (ultra_angle_correction_q16(table, dist_q2) != formulaCorrection(dist_q2)) ++mismatches;
+    }
+    RP_CHECK(mismatches == 0);
+}
+
+RP_TEST(ultra_correction_range_ends)
+{
+    const _s32 * table = ultra_angle_correction_table();
+
+    // near range below 50 mm, one constant
+    RP_CHECK(ultra_angle_correction_q16(table, 0) == formulaCorrection(0));
+    RP_CHECK(ultra_angle_correction_q16(table, 49 * 4) == formulaCorrection(0));
+    RP_CHECK(ultra_angle_correction_q16(table, 50 * 4) != formulaCorrection(0));
+
+    // k2 reaches 0 at ULTRA_CORRECTION_FAR_MM, the correction stays put after it
+    RP_CHECK(98361 / ((ULTRA_CORRECTION_FAR_MM - 1) * 4) == 1);
+    RP_CHECK(98361 / (ULTRA_CORRECTION_FAR_MM * 4) == 0);
+    const _s32 far = formulaCorrection(ULTRA_CORRECTION_FAR_MM * 4);
+    RP_CHECK(ultra_angle_correction_q16(table, (ULTRA_CORRECTION_FAR_MM - 1) * 4) != far);
+    RP_CHECK(ultra_angle_correction_q16(table, 0x7FFFFFFC) == far);
+}
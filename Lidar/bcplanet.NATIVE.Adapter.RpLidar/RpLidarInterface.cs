@@ -63,6 +63,19 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
         [return: MarshalAs(UnmanagedType.I4)]
         public static extern int LidarInitializeDriver();
 
+        /// <summary>
+        /// Initialize driver with a scan capacity and driver options.
+        /// </summary>
+        /// <param name="maxScanNodes">The most samples a scan can hold.</param>
+        /// <param name="options">The driver options, 1 for compact memory.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+            NativeModuleNames.NativeRpLidar,
+            EntryPoint = "LidarInitializeDriverEx",
+            CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarInitializeDriverEx(ulong maxScanNodes = 8192, uint options = 0);
+
         /// <summary>
         /// Dispose driver.
         /// </summary>
@@ -79,7 +92,7 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
         /// </summary>
         /// <param name="comPort">The COM port.</param>
         /// <param name="baudRate">The baud rate.</param>
-        /// <param name="flag">The flag.</param>
+        /// <param name="flag">The flag, 1 to keep the motor spinning.</param>
         /// <returns>System.Int32.</returns>
         [DllImport(
             NativeModuleNames.NativeRpLidar,
@@ -91,6 +104,19 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
             uint baudRate = 115200,
             uint flag = 0);
 
+        /// <summary>
+        /// Set the directory the device profile is cached in across connections.
+        /// </summary>
+        /// <param name="path">The directory, empty or null to disable the disk cache.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+            NativeModuleNames.NativeRpLidar,
+            EntryPoint = "LidarSetProfileCacheDir",
+            CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarSetProfileCacheDir(
+            [In][MarshalAs(UnmanagedType.LPStr)] string path);
+
         /// <summary>
         /// Disconnect from device.
         /// </summary>
@@ -151,6 +177,18 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
             ref rplidar_response_device_health_t health,
             uint timeout = 2000);
 
+        /// <summary>
+        /// Get how long the last health query kept a running scan stopped.
+        /// </summary>
+        /// <param name="gapUs">The gap in microseconds, 0 if no scan was interrupted.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+            NativeModuleNames.NativeRpLidar,
+            EntryPoint = "LidarGetLastScanGap",
+            CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarGetLastScanGap(out ulong gapUs);
+
         /// <summary>
         /// Get device information.
         /// </summary>
@@ -205,6 +243,32 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
         [return: MarshalAs(UnmanagedType.I4)]
         public static extern int LidarStartMotor();
 
+        /// <summary>
+        /// Start motor without waiting for it to spin up.
+        /// </summary>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+            NativeModuleNames.NativeRpLidar,
+            EntryPoint = "LidarStartMotorAsync",
+            CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarStartMotorAsync();
+
+        /// <summary>
+        /// Wait until the rotation measured on the scans has settled.
+        /// </summary>
+        /// <param name="frequency">The rotation frequency reached.</param>
+        /// <param name="timeout">The timeout.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+            NativeModuleNames.NativeRpLidar,
+            EntryPoint = "LidarWaitSpinStable",
+            CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarWaitSpinStable(
+            out float frequency,
+            uint timeout = 2000);
+
         /// <summary>
         /// Stop motor.
         /// </summary>
@@ -359,6 +423,80 @@ namespace bcplanet.NATIVE.Adapter.RpLidar
             out UInt64 resultCount,
             uint timeout = 2000);
 
+        /// <summary>
+        /// Grab current scan data resampled onto a fixed grid of equal angular bins.
+        /// </summary>
+        /// <param name="ranges">The range of each bin in mm, 0 for empty bins.</param>
+        /// <param name="qualities">The quality of each bin, may be null.</param>
+        /// <param name="bins">The number of bins.</param>
+        /// <param name="reduction">The reduction of the samples of one bin (0 min, 1 nearest, 2 mean).</param>
+        /// <param name="timeout">The timeout.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+             NativeModuleNames.NativeRpLidar,
+             EntryPoint = "LidarGrabScanDataGrid",
+             CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarGrabScanDataGrid(
+            [Out][MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 2)] float[] ranges,
+            [Out][MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 2)] byte[] qualities,
+            ulong bins,
+            uint reduction,
+            uint timeout = 2000);
+
+        /// <summary>
+        /// Grab current scan data as cartesian points, in mm, x towards angle 0 and y towards angle 270.
+        /// </summary>
+        /// <param name="x">The x coordinates.</param>
+        /// <param name="y">The y coordinates.</param>
+        /// <param name="quality">The qualities, may be null.</param>
+        /// <param name="count">The size of the buffers.</param>
+        /// <param name="resultCount">The point count.</param>
+        /// <param name="poseX">The x position of the lidar in mm.</param>
+        /// <param name="poseY">The y position of the lidar in mm.</param>
+        /// <param name="poseYaw">The rotation of the lidar in degrees, counter-clockwise.</param>
+        /// <param name="timeout">The timeout.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+             NativeModuleNames.NativeRpLidar,
+             EntryPoint = "LidarGrabScanDataCartesian",
+             CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarGrabScanDataCartesian(
+            [Out][MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] float[] x,
+            [Out][MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] float[] y,
+            [Out][MarshalAs(UnmanagedType.LPArray, SizeParamIndex = 3)] float[] quality,
+            ulong count,
+            out UInt64 resultCount,
+            float poseX = 0,
+            float poseY = 0,
+            float poseYaw = 0,
+            uint timeout = 2000);
+
+        /// <summary>
+        /// Record the raw byte stream of the lidar to a file, for a later replay.
+        /// </summary>
+        /// <param name="path">The file to write.</param>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+             NativeModuleNames.NativeRpLidar,
+             EntryPoint = "LidarStartRecording",
+             CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarStartRecording(
+            [In][MarshalAs(UnmanagedType.LPStr)] string path);
+
+        /// <summary>
+        /// Stop recording the raw byte stream.
+        /// </summary>
+        /// <returns>System.Int32.</returns>
+        [DllImport(
+             NativeModuleNames.NativeRpLidar,
+             EntryPoint = "LidarStopRecording",
+             CallingConvention = CallingConvention.Cdecl)]
+        [return: MarshalAs(UnmanagedType.I4)]
+        public static extern int LidarStopRecording();
+
         /// <summary>
         /// Grab the current scan data in style NMEA string format.
         /// (LIDAR sentence with bcplanet AIMB format extension)
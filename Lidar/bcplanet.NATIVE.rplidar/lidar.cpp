@@ -39,6 +39,7 @@
 
 #include <cstdio>
 #include <iostream>
+#include <vector>
 
 
 #include "../RPLIDAR_SDK/sdk/sdk/include/rplidar.h"
@@ -73,6 +74,38 @@ extern "C"
 		return result;
 	}
 
+	/// <summary>
+	/// Initialize driver with a scan capacity and driver options.
+	/// </summary>
+	/// <param name="maxScanNodes">The most samples a scan can hold.</param>
+	/// <param name="options">The DRIVER_OPTION_* flags, e.g. DRIVER_OPTION_COMPACT_MEMORY.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarInitializeDriverEx(uint64_t maxScanNodes, uint32_t options)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver == nullptr)
+			{
+				lidar_driver = rp::standalone::rplidar::RPlidarDriver::CreateDriver(
+					rp::standalone::rplidar::DRIVER_TYPE_SERIALPORT,
+					static_cast<size_t>(maxScanNodes),
+					options);
+
+				if (lidar_driver == nullptr)
+					result = -1;
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
 	/// <summary>
 	/// Dispose driver.
 	/// </summary>
@@ -118,7 +151,7 @@ extern "C"
 	/// </summary>
 	/// <param name="comPort">The COM port.</param>
 	/// <param name="baudRate">The baud rate.</param>
-	/// <param name="flag">The flag.</param>
+	/// <param name="flag">The flag, 1 to keep the motor spinning.</param>
 	/// <returns>int.</returns>
 	__declspec(dllexport) int LidarConnect(const char* comPort, uint32_t baudRate = 115200, uint32_t flag = 0)
 	{
@@ -141,6 +174,31 @@ extern "C"
 		return result;
 	}
 
+	/// <summary>
+	/// Set the directory the device profile is cached in across connections.
+	/// </summary>
+	/// <param name="path">The directory, empty or null to disable the disk cache.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarSetProfileCacheDir(const char* path)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr)
+			{
+				result = lidar_driver->setDeviceProfileCacheDir(path);
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
 	/// <summary>
 	/// Disconnect from lidar.
 	/// </summary>
@@ -269,6 +327,33 @@ extern "C"
 		return result;
 	}
 
+	/// <summary>
+	/// Get how long the last health query kept a running scan stopped.
+	/// </summary>
+	/// <param name="gapUs">The gap in microseconds, 0 if no scan was interrupted.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarGetLastScanGap(uint64_t& gapUs)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr)
+			{
+				_u64 gap = 0;
+				result = lidar_driver->getLastScanGap(gap);
+				gapUs = gap;
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
 	/// <summary>
 	/// Get lidar device information.
 	/// </summary>
@@ -374,6 +459,58 @@ extern "C"
 		return result;
 	}
 
+	/// <summary>
+	/// Start motor without waiting for it to spin up, see LidarWaitSpinStable.
+	/// </summary>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarStartMotorAsync(void)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr
+				&& lidar_driver->isConnected())
+			{
+				result = lidar_driver->startMotorAsync();
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
+	/// <summary>
+	/// Wait until the rotation measured on the scans has settled.
+	/// </summary>
+	/// <param name="frequency">The rotation frequency reached.</param>
+	/// <param name="timeout">The timeout.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarWaitSpinStable(float& frequency, uint32_t timeout = 2000)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr
+				&& lidar_driver->isConnected())
+			{
+				result = lidar_driver->waitSpinStable(frequency, timeout);
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
 	/// <summary>
 	/// Stop motor.
 	/// </summary>
@@ -517,12 +654,13 @@ extern "C"
 			if (lidar_driver != nullptr
 				&& lidar_driver->isConnected())
 			{
-				std::vector<rp::standalone::rplidar::RplidarScanMode> modeVec;
+				// served from the cached device profile after the first start
+				rp::standalone::rplidar::RplidarDeviceProfile profile;
 
-				lidar_driver->getAllSupportedScanModes(modeVec);
+				lidar_driver->getDeviceProfile(profile);
 
-				auto modeIter = modeVec.begin();
-				for (; modeIter != modeVec.end(); ++modeIter)
+				auto modeIter = profile.modes.begin();
+				for (; modeIter != profile.modes.end(); ++modeIter)
 				{
 					printf(
 						"Mode: %s\nDistance: %f\nsScam Mode %i\nId: %i\nSample time:  %fµs\n\n", 
@@ -732,6 +870,124 @@ extern "C"
 		return result;
 	}
 
+	/// <summary>
+	/// Grab the current scan resampled onto a fixed grid of equal angular bins.
+	/// </summary>
+	/// <param name="ranges">The range of each bin in mm, 0 for empty bins.</param>
+	/// <param name="qualities">The quality of each bin, may be null.</param>
+	/// <param name="bins">The number of bins.</param>
+	/// <param name="reduction">The reduction of the samples of one bin (0 min, 1 nearest, 2 mean).</param>
+	/// <param name="timeout">The timeout.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int _stdcall LidarGrabScanDataGrid(float* ranges, uint8_t* qualities, uint64_t bins, uint32_t reduction, uint32_t timeout = 2000)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr
+				&& lidar_driver->isConnected())
+			{
+				rp::standalone::rplidar::RplidarScanInfo info;
+				result = lidar_driver->grabScanDataGrid(ranges, qualities, static_cast<size_t>(bins), reduction, info, timeout);
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
+	/// <summary>
+	/// Grab the current scan as cartesian points, in mm, x towards angle 0 and y towards angle 270.
+	/// </summary>
+	/// <param name="x">The x coordinates.</param>
+	/// <param name="y">The y coordinates.</param>
+	/// <param name="quality">The qualities, may be null.</param>
+	/// <param name="count">The size of the buffers.</param>
+	/// <param name="resultCount">The point count.</param>
+	/// <param name="poseX">The x position of the lidar in mm.</param>
+	/// <param name="poseY">The y position of the lidar in mm.</param>
+	/// <param name="poseYaw">The rotation of the lidar in degrees, counter-clockwise.</param>
+	/// <param name="timeout">The timeout.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int _stdcall LidarGrabScanDataCartesian(float* x, float* y, float* quality, uint64_t count, uint64_t* resultCount, float poseX = 0, float poseY = 0, float poseYaw = 0, uint32_t timeout = 2000)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr
+				&& lidar_driver->isConnected())
+			{
+				rp::standalone::rplidar::RplidarScanInfo info;
+				rp::standalone::rplidar::RplidarTransform2D pose = { poseX, poseY, poseYaw };
+				size_t count_size = count;
+				result = lidar_driver->grabScanDataCartesian(x, y, quality, count_size, info, &pose, timeout);
+				*resultCount = static_cast<uint64_t>(count_size);
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
+	/// <summary>
+	/// Record the raw byte stream of the lidar to a file, for a later replay.
+	/// </summary>
+	/// <param name="path">The file to write.</param>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarStartRecording(const char* path)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr)
+			{
+				result = lidar_driver->startRecording(path);
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
+	/// <summary>
+	/// Stop recording the raw byte stream.
+	/// </summary>
+	/// <returns>int.</returns>
+	__declspec(dllexport) int LidarStopRecording(void)
+	{
+		auto result = 0;
+		try
+		{
+			if (lidar_driver != nullptr)
+			{
+				result = lidar_driver->stopRecording();
+			}
+		}
+		catch (std::exception& oe)
+		{
+			printf(oe.what());  // NOLINT(clang-diagnostic-format-security)
+
+			result = -1;
+		}
+
+		return result;
+	}
+
 	int CreateCheckSum(char* pNMEA)
 	{
 		int i;
@@ -747,6 +1003,9 @@ extern "C"
 		return iXOR;
 	}
 
+	// Scan buffer of the string exports, sized to the sentences requested by the caller
+	std::vector<rplidar_response_measurement_node_hq_t> nodeBuffer;
+
 	/// <summary>
 	/// Lidars the get nmea.
 	/// </summary>
@@ -764,9 +1023,12 @@ extern "C"
 			if (lidar_driver != nullptr
 				&& lidar_driver->isConnected())
 			{
-				rplidar_response_measurement_node_hq_t nodeBuffer[8192];
+				if (inputSize == 0)
+					return RESULT_INVALID_DATA;
+
+				nodeBuffer.resize(static_cast<size_t>(inputSize));
 				rplidar_response_measurement_node_hq_t *nodes = &nodeBuffer[0];
-				size_t count = _countof(nodeBuffer);
+				size_t count = nodeBuffer.size();
 
 				printf("LidarGrabScanDataHq: Struct size: %llu\n", sizeof(rplidar_response_measurement_node_hq_t));
 				printf("LidarGrabScanDataHq: Array input size: %llu\n", count);
@@ -818,9 +1080,6 @@ extern "C"
 		return result;
 	}
 
-	rplidar_response_measurement_node_hq_t nodeBuffer[8192];
-	rplidar_response_measurement_node_hq_t* nodes = &nodeBuffer[0];
-
 	__declspec(dllexport) int _stdcall LidarGetStringData(
 		char* sentences[], 
 		uint64_t inputSize, 
@@ -833,7 +1092,12 @@ extern "C"
 			if (lidar_driver != nullptr
 				&& lidar_driver->isConnected())
 			{
-				size_t count = _countof(nodeBuffer);
+				if (inputSize == 0)
+					return RESULT_INVALID_DATA;
+
+				nodeBuffer.resize(static_cast<size_t>(inputSize));
+				rplidar_response_measurement_node_hq_t* nodes = &nodeBuffer[0];
+				size_t count = nodeBuffer.size();
 
 				/*printf("LidarGrabScanDataHq: Struct size: %llu\n", sizeof(rplidar_response_measurement_node_hq_t));
 				printf("LidarGrabScanDataHq: Array input size: %llu\n", count);*/